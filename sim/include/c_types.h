@@ -0,0 +1,66 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+//
+// host replacement of the NON-OS SDK c_types.h
+//
+
+#ifndef _C_TYPES_H_
+#define _C_TYPES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+typedef unsigned char uint8;
+typedef unsigned char u8;
+typedef signed char sint8;
+typedef signed char int8;
+typedef signed char s8;
+typedef unsigned short uint16;
+typedef unsigned short u16;
+typedef signed short sint16;
+typedef signed short s16;
+typedef unsigned int uint32;
+typedef unsigned int u_int;
+typedef unsigned int u32;
+typedef signed int sint32;
+typedef signed int s32;
+typedef int int32;
+typedef signed long long sint64;
+typedef unsigned long long uint64;
+typedef unsigned long long u64;
+typedef float real32;
+typedef double real64;
+
+#define __le16 u16
+
+#define LOCAL static
+
+#ifndef NULL
+#define NULL (void *)0
+#endif
+
+#define BIT(nr) (1UL << (nr))
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define IRAM_ATTR
+#define STORE_ATTR __attribute__((aligned(4)))
+
+#define SHMEM_ATTR
+
+#define TRUE true
+#define FALSE false
+
+#define BOOL bool
+
+#endif
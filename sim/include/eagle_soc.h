@@ -0,0 +1,108 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+//
+// host replacement of the NON-OS SDK eagle_soc.h
+// (only the definitions used by the drivers)
+//
+
+#ifndef _EAGLE_SOC_H_
+#define _EAGLE_SOC_H_
+
+#define BIT31 0x80000000
+#define BIT30 0x40000000
+#define BIT29 0x20000000
+#define BIT28 0x10000000
+#define BIT27 0x08000000
+#define BIT26 0x04000000
+#define BIT25 0x02000000
+#define BIT24 0x01000000
+#define BIT23 0x00800000
+#define BIT22 0x00400000
+#define BIT21 0x00200000
+#define BIT20 0x00100000
+#define BIT19 0x00080000
+#define BIT18 0x00040000
+#define BIT17 0x00020000
+#define BIT16 0x00010000
+#define BIT15 0x00008000
+#define BIT14 0x00004000
+#define BIT13 0x00002000
+#define BIT12 0x00001000
+#define BIT11 0x00000800
+#define BIT10 0x00000400
+#define BIT9 0x00000200
+#define BIT8 0x00000100
+#define BIT7 0x00000080
+#define BIT6 0x00000040
+#define BIT5 0x00000020
+#define BIT4 0x00000010
+#define BIT3 0x00000008
+#define BIT2 0x00000004
+#define BIT1 0x00000002
+#define BIT0 0x00000001
+
+#define APB_CLK_FREQ 80 * 1000000
+#define UART_CLK_FREQ APB_CLK_FREQ
+#define TIMER_CLK_FREQ (APB_CLK_FREQ >> 8) // divided by 256
+
+// the peripheral registers are not memory mapped on the host
+// GPIO registers are routed to the simulated GPIO block
+#define PERIPHS_GPIO_BASEADDR 0x60000300
+
+#define PERIPHS_IO_MUX 0x60000800
+
+// FRC1 load register is routed to the simulated hw timer
+#define PERIPHS_TIMER_BASEDDR 0x60000600
+#define FRC1_LOAD_ADDRESS (PERIPHS_TIMER_BASEDDR + 0x0)
+#ifdef __cplusplus
+extern "C"
+#endif
+void sim_rtc_reg_write(unsigned int addr, unsigned int val);
+#define RTC_REG_WRITE(addr, val) sim_rtc_reg_write((addr), (val))
+
+// HSPI and IO_MUX registers are routed to the simulated HSPI block (see sim_hal.h)
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+unsigned int sim_peri_reg_read(unsigned int addr);
+void sim_peri_reg_write(unsigned int addr, unsigned int val);
+void sim_pin_func_select(unsigned int addr, unsigned int func);
+#ifdef __cplusplus
+}
+#endif
+#define READ_PERI_REG(addr) sim_peri_reg_read(addr)
+#define WRITE_PERI_REG(addr, val) sim_peri_reg_write((addr), (val))
+#define SET_PERI_REG_MASK(addr, mask) WRITE_PERI_REG((addr), (READ_PERI_REG(addr) | (mask)))
+#define CLEAR_PERI_REG_MASK(addr, mask) WRITE_PERI_REG((addr), (READ_PERI_REG(addr) & (~(mask))))
+
+#define PERIPHS_IO_MUX_MTDI_U (PERIPHS_IO_MUX + 0x04)
+#define FUNC_GPIO12 3
+#define PERIPHS_IO_MUX_MTCK_U (PERIPHS_IO_MUX + 0x08)
+#define FUNC_GPIO13 3
+#define PERIPHS_IO_MUX_MTMS_U (PERIPHS_IO_MUX + 0x0C)
+#define FUNC_GPIO14 3
+#define PERIPHS_IO_MUX_MTDO_U (PERIPHS_IO_MUX + 0x10)
+#define FUNC_GPIO15 3
+#define PERIPHS_IO_MUX_GPIO0_U (PERIPHS_IO_MUX + 0x34)
+#define FUNC_GPIO0 0
+#define PERIPHS_IO_MUX_GPIO2_U (PERIPHS_IO_MUX + 0x38)
+#define FUNC_GPIO2 0
+#define PERIPHS_IO_MUX_GPIO4_U (PERIPHS_IO_MUX + 0x3C)
+#define FUNC_GPIO4 0
+#define PERIPHS_IO_MUX_GPIO5_U (PERIPHS_IO_MUX + 0x40)
+#define FUNC_GPIO5 0
+
+// pull-ups have no effect on the simulated pins, the pin mux only matters to HSPI
+#define PIN_PULLUP_DIS(PIN_NAME) ((void)(PIN_NAME))
+#define PIN_PULLUP_EN(PIN_NAME) ((void)(PIN_NAME))
+#define PIN_FUNC_SELECT(PIN_NAME, FUNC) sim_pin_func_select((PIN_NAME), (FUNC))
+
+#endif
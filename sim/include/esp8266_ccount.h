@@ -0,0 +1,35 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __ESP8266_CCOUNT_H__
+#define __ESP8266_CCOUNT_H__
+
+//
+// host replacement of src/include/esp8266_ccount.h
+// the cycle counter follows the virtual clock at system_get_cpu_freq() MHz
+//
+
+#include "c_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+uint32 sim_get_ccount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline uint32 get_ccount(void)
+{
+    return sim_get_ccount();
+}
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __ESP8266_INTR_H__
+#define __ESP8266_INTR_H__
+
+//
+// host replacement of src/include/esp8266_intr.h
+// handlers never preempt each other on the virtual clock, nothing to mask
+//
+
+#include "c_types.h"
+
+static inline uint32 intr_lock(void)
+{
+    return 0;
+}
+
+static inline void intr_unlock(uint32 ps)
+{
+    (void)ps;
+}
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __ESPBOT_SPIFFS_HPP__
+#define __ESPBOT_SPIFFS_HPP__
+
+//
+// host replacement of src/include/espbot_spiffs.hpp
+// Espfile on top of an in-memory file system (see sim_espbot.cpp)
+// files survive sim_reset, as flash does across a reboot
+//
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+typedef int32_t s32_t;
+
+#define LOG_PAGE_SIZE (256)
+#define SPIFFS_OK 0
+#define SPIFFS_ERR_FULL -10001
+#define SPIFFS_ERR_NOT_FOUND -10002
+
+class Espfile
+{
+public:
+  Espfile(char *filename);
+  ~Espfile();
+  s32_t n_read(char *buffer, int len);
+  s32_t n_read(char *buffer, int offset, int len);
+  s32_t n_append(char *buffer, int len);
+  s32_t clear();
+  s32_t remove();
+  static bool exists(char *filename);
+  static int size(char *filename);
+
+private:
+  int _handler;
+  int _offset;
+};
+
+// in-memory file system
+void sim_spiffs_format(void);
+int sim_spiffs_appends(void); // n_append calls since format
+int sim_spiffs_lookups(void); // file name lookups (open, exists, size) since format
+
+#endif
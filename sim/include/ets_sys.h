@@ -0,0 +1,83 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+//
+// host replacement of the NON-OS SDK ets_sys.h
+//
+
+#ifndef _ETS_SYS_H
+#define _ETS_SYS_H
+
+#include "c_types.h"
+#include "eagle_soc.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef uint32 ETSSignal;
+// on the host a pointer does not fit into 32 bits
+typedef uintptr_t ETSParam;
+
+typedef struct ETSEventTag ETSEvent;
+
+struct ETSEventTag
+{
+    ETSSignal sig;
+    ETSParam par;
+};
+
+typedef void (*ETSTask)(ETSEvent *e);
+
+typedef void ETSTimerFunc(void *timer_arg);
+
+typedef struct _ETSTIMER_
+{
+    struct _ETSTIMER_ *timer_next;
+    uint32 timer_expire;
+    uint32 timer_period;
+    ETSTimerFunc *timer_func;
+    void *timer_arg;
+    // simulation bookkeeping
+    uint64 sim_expire;
+    uint64 sim_period;
+    uint32 sim_order;
+    bool sim_armed;
+} ETSTimer;
+
+typedef void (*ets_isr_t)(void *);
+
+#define ETS_SLC_INUM 1
+#define ETS_SPI_INUM 2
+#define ETS_GPIO_INUM 4
+#define ETS_UART_INUM 5
+#define ETS_UART1_INUM 5
+#define ETS_FRC_TIMER1_INUM 9
+
+void ets_isr_attach(int i, ets_isr_t func, void *arg);
+void ets_isr_mask(uint32 mask);
+void ets_isr_unmask(uint32 mask);
+
+#define ETS_INTR_ENABLE(inum) ets_isr_unmask((1 << inum))
+#define ETS_INTR_DISABLE(inum) ets_isr_mask((1 << inum))
+
+#define ETS_GPIO_INTR_ATTACH(func, arg) ets_isr_attach(ETS_GPIO_INUM, (ets_isr_t)(func), (void *)(arg))
+#define ETS_GPIO_INTR_ENABLE() ETS_INTR_ENABLE(ETS_GPIO_INUM)
+#define ETS_GPIO_INTR_DISABLE() ETS_INTR_DISABLE(ETS_GPIO_INUM)
+
+#define ETS_FRC_TIMER1_INTR_ATTACH(func, arg) ets_isr_attach(ETS_FRC_TIMER1_INUM, (ets_isr_t)(func), (void *)(arg))
+#define ETS_FRC1_INTR_ENABLE() ETS_INTR_ENABLE(ETS_FRC_TIMER1_INUM)
+#define ETS_FRC1_INTR_DISABLE() ETS_INTR_DISABLE(ETS_FRC_TIMER1_INUM)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+//
+// host replacement of the NON-OS SDK mem.h
+//
+
+#ifndef __MEM_H__
+#define __MEM_H__
+
+#include <stdlib.h>
+
+#define os_free(s) free(s)
+#define os_malloc(s) malloc(s)
+#define os_calloc(l, s) calloc(l, s)
+#define os_realloc(p, s) realloc(p, s)
+#define os_zalloc(s) calloc(1, s)
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+//
+// host replacement of the NON-OS SDK osapi.h
+//
+
+#ifndef _OSAPI_H_
+#define _OSAPI_H_
+
+#include <string.h>
+#include <stdio.h>
+#include "os_type.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define os_bzero(s, n) memset(s, 0, n)
+#define os_memcmp memcmp
+#define os_memcpy memcpy
+#define os_memmove memmove
+#define os_memset memset
+#define os_strcat strcat
+#define os_strchr strchr
+#define os_strcmp strcmp
+#define os_strcpy strcpy
+#define os_strlen strlen
+#define os_strncmp strncmp
+#define os_strncpy strncpy
+#define os_strstr strstr
+#define os_sprintf sprintf
+#define os_snprintf snprintf
+
+#define os_printf os_printf_plus
+
+int os_printf_plus(const char *format, ...) __attribute__((format(printf, 1, 2)));
+int os_sprintf_plus(char *str, const char *format, ...) __attribute__((format(printf, 2, 3)));
+int os_snprintf_plus(char *str, unsigned int size, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+void ets_delay_us(uint32 us);
+#define os_delay_us ets_delay_us
+
+void ets_timer_arm_new(os_timer_t *ptimer, uint32 time, bool repeat_flag, bool ms_flag);
+void ets_timer_disarm(os_timer_t *ptimer);
+void ets_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction, void *parg);
+
+#define os_timer_arm(a, b, c) ets_timer_arm_new(a, b, c, 1)
+#define os_timer_arm_us(a, b, c) ets_timer_arm_new(a, b, c, 0)
+#define os_timer_disarm ets_timer_disarm
+#define os_timer_setfn ets_timer_setfn
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SIM_HAL_H__
+#define __SIM_HAL_H__
+
+#include "c_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+//
+// host simulation HAL
+//
+// stands in for the SDK GPIO macros, os_timer_*, hw_timer_*, system_get_time,
+// ETS_GPIO_INTR_ATTACH and system_os_post so that the drivers build and run on linux
+//
+// the simulation is driven by a discrete-event virtual clock (1 us resolution):
+// nothing happens until sim_run_for/sim_run_until_idle are called, then pin waveforms,
+// hw timer, os timers and posted task events are executed in virtual time order
+// (ties: pin edges, hw timer, os timers, in arming order)
+// handlers take no virtual time, use sim_delay to model execution cost
+//
+
+#define SIM_GPIO_COUNT 16
+#define SIM_CPU_FREQ 80 // MHz, CCOUNT ticks per virtual microsecond
+#define SIM_CCOUNT_READ_CYCLES 4 // each CCOUNT read costs these cycles (busy waiting on CCOUNT ends)
+#define SIM_PIN_SCRIPT_LEN 256 // max pending transitions per pin
+
+void sim_reset(void);   // call before anything else: back to time 0, pins released HIGH (pull-up),
+                        // no timers, no tasks
+uint64 sim_now(void);   // virtual time in microseconds
+
+void sim_run_for(uint32 us);             // run every event due within the next us
+bool sim_run_until_idle(uint32 max_us);  // run until no timer or waveform is pending
+                                         // return false when max_us elapsed first
+void sim_delay(uint32 us);               // advance the clock from inside a handler (busy wait)
+void sim_hold_tasks(bool hold);          // while held posted task events wait (e.g. a busy CPU),
+                                         // timers and isr go on
+
+//
+// scriptable pin waveforms
+//
+// the level read on a pin is the driven level when the pin is an output
+// otherwise it is the external level set by the waveform scripts (default HIGH)
+//
+
+struct sim_pulse
+{
+    char level;
+    uint32 duration; // microseconds
+};
+
+// queue a waveform on gpio starting delay us from now
+// when the last pulse ends the pin goes back to the level it had when the script was loaded
+// return false when the pin script queue is full
+bool sim_pin_script(int gpio, const struct sim_pulse *pulses, int count, uint32 delay);
+void sim_pin_clear_script(int gpio);
+void sim_pin_drive(int gpio, int level); // set the external level now
+int sim_pin_level(int gpio);             // the level currently seen on the pin
+
+// a device model can watch the outputs (e.g. reacting to a start pulse)
+// the callback is called on every level change of an output enabled pin
+void sim_set_output_cb(void (*cb)(int gpio, int level, void *param), void *param);
+
+//
+// statistics
+//
+
+struct sim_stats
+{
+    uint32 gpio_isr_calls;
+    uint32 hw_timer_calls;
+    uint32 hw_timer_loads; // FRC1 loaded with precomputed ticks (hw_timer_load)
+    uint32 os_timer_calls;
+    uint32 task_events;
+    uint32 task_posts_dropped;
+    uint32 task_queue_max; // high water mark of posted events waiting for the task
+};
+
+void sim_get_stats(struct sim_stats *stats);
+
+//
+// HSPI block
+//
+// src/include/esp8266_hspi.h runs on the simulated registers: a transfer started
+// with the pins on HSPI clocks SCK (D5) and samples MISO (D6) on the rising edges
+// (device models see SCK like an output) and takes the time the dividers set
+//
+
+struct sim_hspi
+{
+    uint32 transfers;
+    uint32 clock_hz;  // from the HSPI_CLOCK dividers
+    uint32 bits;      // last transfer length
+    bool pins_muxed;  // D5 and D6 on HSPI, clocked from the divider
+    bool lsb_first;
+    bool miso_only;   // read phase only
+    bool cs_disabled; // HW CS off
+};
+
+void sim_get_hspi(struct sim_hspi *hspi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+//
+// host replacement of the espbot_2.0 services used by the drivers
+// https://github.com/quackmore/espbot_2.0
+//
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+#include "mem.h"
+#include "drivers.h"
+#include "sim_hal.h"
+}
+
+#include "espbot_diagnostic.hpp"
+#include "espbot_timedate.hpp"
+#include "espbot_spiffs.hpp"
+
+void *call_espbot_zalloc(size_t size)
+{
+    return os_zalloc(size);
+}
+
+void call_espbot_free(void *addr)
+{
+    os_free(addr);
+}
+
+// diagnostic events are just counted, serial log shows errors and warnings
+
+static int dia_events_count;
+
+void dia_fatal_evnt(int code, uint32 value)
+{
+    dia_events_count++;
+}
+
+void dia_error_evnt(int code, uint32 value)
+{
+    dia_events_count++;
+}
+
+void dia_warn_evnt(int code, uint32 value)
+{
+    dia_events_count++;
+}
+
+void dia_info_evnt(int code, uint32 value)
+{
+    dia_events_count++;
+}
+
+void dia_debug_evnt(int code, uint32 value)
+{
+    dia_events_count++;
+}
+
+void dia_trace_evnt(int code, uint32 value)
+{
+    dia_events_count++;
+}
+
+bool diag_log_err_type(int type)
+{
+    return (type & (EVNT_FATAL | EVNT_ERROR | EVNT_WARN));
+}
+
+// timestamps follow the virtual clock
+
+uint32 timedate_get_timestamp()
+{
+    return (uint32)(sim_now() / 1000000);
+}
+
+// in-memory SPIFFS
+
+#define SIM_SPIFFS_FILES 8
+#define SIM_SPIFFS_FILE_SIZE (64 * 1024)
+
+struct sim_file
+{
+    bool used;
+    char name[32];
+    char *data;
+    int len;
+};
+
+static struct sim_file sim_files[SIM_SPIFFS_FILES];
+static int sim_appends;
+static int sim_lookups;
+
+static int sim_file_find(char *filename)
+{
+    int idx;
+    sim_lookups++;
+    for (idx = 0; idx < SIM_SPIFFS_FILES; idx++)
+        if (sim_files[idx].used && (os_strncmp(sim_files[idx].name, filename, 31) == 0))
+            return idx;
+    return -1;
+}
+
+void sim_spiffs_format(void)
+{
+    int idx;
+    for (idx = 0; idx < SIM_SPIFFS_FILES; idx++)
+    {
+        if (sim_files[idx].data)
+            os_free(sim_files[idx].data);
+        os_memset(&sim_files[idx], 0, sizeof(struct sim_file));
+    }
+    sim_appends = 0;
+    sim_lookups = 0;
+}
+
+int sim_spiffs_appends(void)
+{
+    return sim_appends;
+}
+
+int sim_spiffs_lookups(void)
+{
+    return sim_lookups;
+}
+
+Espfile::Espfile(char *filename)
+{
+    int idx;
+    _offset = 0;
+    _handler = sim_file_find(filename);
+    if (_handler >= 0)
+        return;
+    for (idx = 0; idx < SIM_SPIFFS_FILES; idx++)
+        if (!sim_files[idx].used)
+            break;
+    if (idx >= SIM_SPIFFS_FILES)
+        return;
+    sim_files[idx].used = true;
+    os_strncpy(sim_files[idx].name, filename, 31);
+    sim_files[idx].data = (char *)os_zalloc(SIM_SPIFFS_FILE_SIZE);
+    sim_files[idx].len = 0;
+    _handler = idx;
+}
+
+Espfile::~Espfile()
+{
+}
+
+s32_t Espfile::n_read(char *buffer, int len)
+{
+    s32_t res = n_read(buffer, _offset, len);
+    if (res > 0)
+        _offset += res;
+    return res;
+}
+
+s32_t Espfile::n_read(char *buffer, int offset, int len)
+{
+    struct sim_file *file;
+    if (_handler < 0)
+        return SPIFFS_ERR_NOT_FOUND;
+    file = &sim_files[_handler];
+    if (offset >= file->len)
+        return 0;
+    if (len > (file->len - offset))
+        len = file->len - offset;
+    os_memcpy(buffer, file->data + offset, len);
+    return len;
+}
+
+s32_t Espfile::n_append(char *buffer, int len)
+{
+    struct sim_file *file;
+    if (_handler < 0)
+        return SPIFFS_ERR_NOT_FOUND;
+    file = &sim_files[_handler];
+    if ((file->len + len) > SIM_SPIFFS_FILE_SIZE)
+        return SPIFFS_ERR_FULL;
+    os_memcpy(file->data + file->len, buffer, len);
+    file->len += len;
+    sim_appends++;
+    return len;
+}
+
+s32_t Espfile::clear()
+{
+    if (_handler < 0)
+        return SPIFFS_ERR_NOT_FOUND;
+    sim_files[_handler].len = 0;
+    return SPIFFS_OK;
+}
+
+s32_t Espfile::remove()
+{
+    if (_handler < 0)
+        return SPIFFS_ERR_NOT_FOUND;
+    os_free(sim_files[_handler].data);
+    os_memset(&sim_files[_handler], 0, sizeof(struct sim_file));
+    _handler = -1;
+    return SPIFFS_OK;
+}
+
+bool Espfile::exists(char *filename)
+{
+    return (sim_file_find(filename) >= 0);
+}
+
+int Espfile::size(char *filename)
+{
+    int idx = sim_file_find(filename);
+    if (idx < 0)
+        return -1;
+    return sim_files[idx].len;
+}
@@ -0,0 +1,835 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+#include <stdarg.h>
+#include "c_types.h"
+#include "ets_sys.h"
+#include "gpio.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "driver_hw_timer.h"
+#include "sim_hal.h"
+#include "esp8266_ccount.h"
+#include "esp8266_io.h"
+#include "esp8266_hspi.h"
+
+//
+// virtual clock
+//
+
+static uint64 sim_time;
+static int isr_depth; // > 0 while running gpio isr or hw timer callback
+static bool tasks_held;
+
+//
+// GPIO block
+//
+
+struct sim_transition
+{
+    uint64 time;
+    char level;
+};
+
+struct sim_pin
+{
+    int ext_level;
+    GPIO_INT_TYPE intr_state;
+    struct sim_transition script[SIM_PIN_SCRIPT_LEN];
+    int script_head;
+    int script_count;
+};
+
+static struct sim_pin pins[SIM_GPIO_COUNT];
+static uint32 gpio_out;
+static uint32 gpio_enable;
+static uint32 gpio_status;
+static ets_isr_t gpio_isr;
+static void *gpio_isr_arg;
+static uint32 isr_mask; // bit set => interrupt unmasked
+
+static void (*output_cb)(int gpio, int level, void *param);
+static void *output_cb_param;
+
+static struct sim_stats stats;
+
+static uint32 pin_levels(void)
+{
+    uint32 levels = 0;
+    int idx;
+    for (idx = 0; idx < SIM_GPIO_COUNT; idx++)
+        if (pins[idx].ext_level)
+            levels |= (1 << idx);
+    return ((gpio_out & gpio_enable) | (levels & ~gpio_enable));
+}
+
+static void dispatch_gpio_isr(void)
+{
+    if (isr_depth > 0)
+        return;
+    if ((gpio_status == 0) || (gpio_isr == NULL) || !(isr_mask & (1 << ETS_GPIO_INUM)))
+        return;
+    isr_depth++;
+    stats.gpio_isr_calls++;
+    gpio_isr(gpio_isr_arg);
+    isr_depth--;
+}
+
+// compare levels before and after a change and raise the interrupt status
+static void pins_changed(uint32 before)
+{
+    uint32 after = pin_levels();
+    uint32 changed = before ^ after;
+    int idx;
+    if (changed == 0)
+        return;
+    for (idx = 0; idx < SIM_GPIO_COUNT; idx++)
+    {
+        if (!(changed & (1 << idx)))
+            continue;
+        int level = (after >> idx) & 0x01;
+        if (output_cb && (gpio_enable & (1 << idx)))
+            output_cb(idx, level, output_cb_param);
+        switch (pins[idx].intr_state)
+        {
+        case GPIO_PIN_INTR_POSEDGE:
+        case GPIO_PIN_INTR_HILEVEL:
+            if (level)
+                gpio_status |= (1 << idx);
+            break;
+        case GPIO_PIN_INTR_NEGEDGE:
+        case GPIO_PIN_INTR_LOLEVEL:
+            if (!level)
+                gpio_status |= (1 << idx);
+            break;
+        case GPIO_PIN_INTR_ANYEDGE:
+            gpio_status |= (1 << idx);
+            break;
+        default:
+            break;
+        }
+    }
+    dispatch_gpio_isr();
+}
+
+void gpio_init(void)
+{
+}
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask, uint32 disable_mask)
+{
+    uint32 before = pin_levels();
+    gpio_out |= set_mask;
+    gpio_out &= ~clear_mask;
+    gpio_enable |= enable_mask;
+    gpio_enable &= ~disable_mask;
+    pins_changed(before);
+}
+
+uint32 gpio_input_get(void)
+{
+    return pin_levels();
+}
+
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state)
+{
+    if (i < SIM_GPIO_COUNT)
+        pins[i].intr_state = intr_state;
+}
+
+uint32 sim_gpio_reg_read(uint32 reg)
+{
+    switch (reg)
+    {
+    case GPIO_OUT_ADDRESS:
+        return gpio_out;
+    case GPIO_ENABLE_ADDRESS:
+        return gpio_enable;
+    case GPIO_IN_ADDRESS:
+        return pin_levels();
+    case GPIO_STATUS_ADDRESS:
+        return gpio_status;
+    default:
+        return 0;
+    }
+}
+
+void sim_gpio_reg_write(uint32 reg, uint32 val)
+{
+    uint32 before = pin_levels();
+    switch (reg)
+    {
+    case GPIO_OUT_ADDRESS:
+        gpio_out = val;
+        break;
+    case GPIO_OUT_W1TS_ADDRESS:
+        gpio_out |= val;
+        break;
+    case GPIO_OUT_W1TC_ADDRESS:
+        gpio_out &= ~val;
+        break;
+    case GPIO_ENABLE_ADDRESS:
+        gpio_enable = val;
+        break;
+    case GPIO_ENABLE_W1TS_ADDRESS:
+        gpio_enable |= val;
+        break;
+    case GPIO_ENABLE_W1TC_ADDRESS:
+        gpio_enable &= ~val;
+        break;
+    case GPIO_STATUS_W1TS_ADDRESS:
+        gpio_status |= val;
+        break;
+    case GPIO_STATUS_W1TC_ADDRESS:
+        gpio_status &= ~val;
+        return;
+    default:
+        return;
+    }
+    pins_changed(before);
+}
+
+//
+// HSPI block and pin mux
+//
+
+#define HSPI_REGS 32  // HSPI_BASE .. HSPI_BASE + 0x7C
+#define IO_MUX_REGS 32 // PERIPHS_IO_MUX .. PERIPHS_IO_MUX + 0x7C
+
+static uint32 hspi_regs[HSPI_REGS];
+static uint32 io_mux_regs[IO_MUX_REGS];
+static uint32 pin_funcs[IO_MUX_REGS];
+static struct sim_hspi hspi;
+
+static bool hspi_pins_muxed(void)
+{
+    return ((pin_funcs[(ESPBOT_D5_MUX - PERIPHS_IO_MUX) / 4] == HSPI_FUNC) &&
+            (pin_funcs[(ESPBOT_D6_MUX - PERIPHS_IO_MUX) / 4] == HSPI_FUNC) &&
+            !(io_mux_regs[0] & BIT9));
+}
+
+static uint32 hspi_clock_hz(void)
+{
+    uint32 clock = hspi_regs[(HSPI_CLOCK - HSPI_BASE) / 4];
+    if (clock & BIT31)
+        return APB_CLK_FREQ;
+    return APB_CLK_FREQ / ((((clock >> 18) & 0x1FFF) + 1) * (((clock >> 12) & 0x3F) + 1));
+}
+
+// SPI mode 0: MISO sampled on SCK rising edges, the slave shifts on falling edges
+static void hspi_transfer(void)
+{
+    uint32 bits = ((hspi_regs[(HSPI_USER1 - HSPI_BASE) / 4] >> HSPI_MISO_BITLEN_S) & 0x1FF) + 1;
+    uint32 *w = &hspi_regs[(HSPI_W0 - HSPI_BASE) / 4];
+    uint32 idx;
+    int bit;
+    hspi.transfers++;
+    hspi.bits = bits;
+    hspi.clock_hz = hspi_clock_hz();
+    hspi.pins_muxed = hspi_pins_muxed();
+    hspi.lsb_first = ((hspi_regs[(HSPI_CTRL - HSPI_BASE) / 4] & HSPI_BIT_ORDER) != 0);
+    hspi.miso_only = (hspi_regs[(HSPI_USER - HSPI_BASE) / 4] == HSPI_USR_MISO);
+    hspi.cs_disabled = ((hspi_regs[(HSPI_PIN - HSPI_BASE) / 4] & HSPI_CS_DIS) == HSPI_CS_DIS);
+    if (hspi.pins_muxed && (hspi_regs[(HSPI_USER - HSPI_BASE) / 4] & HSPI_USR_MISO))
+    {
+        for (idx = 0; idx < ((bits + 31) / 32); idx++)
+            w[idx] = 0;
+        for (idx = 0; idx < bits; idx++)
+        {
+            gpio_output_set(BIT(ESPBOT_D5_NUM), 0, 0, 0);
+            bit = (hspi.lsb_first) ? (idx % 8) : (7 - (idx % 8));
+            if (pin_levels() & BIT(ESPBOT_D6_NUM))
+                w[idx / 32] |= (1 << (((idx / 8) % 4) * 8 + bit));
+            gpio_output_set(0, BIT(ESPBOT_D5_NUM), 0, 0);
+        }
+    }
+    if (hspi.clock_hz)
+        sim_delay(((uint64)bits * 1000000 + hspi.clock_hz - 1) / hspi.clock_hz);
+    hspi_regs[(HSPI_CMD - HSPI_BASE) / 4] &= ~HSPI_USR;
+}
+
+unsigned int sim_peri_reg_read(unsigned int addr)
+{
+    if ((addr >= HSPI_BASE) && (addr < (HSPI_BASE + HSPI_REGS * 4)))
+        return hspi_regs[(addr - HSPI_BASE) / 4];
+    if ((addr >= PERIPHS_IO_MUX) && (addr < (PERIPHS_IO_MUX + IO_MUX_REGS * 4)))
+        return io_mux_regs[(addr - PERIPHS_IO_MUX) / 4];
+    return 0;
+}
+
+void sim_peri_reg_write(unsigned int addr, unsigned int val)
+{
+    if ((addr >= HSPI_BASE) && (addr < (HSPI_BASE + HSPI_REGS * 4)))
+    {
+        hspi_regs[(addr - HSPI_BASE) / 4] = val;
+        if ((addr == HSPI_CMD) && (val & HSPI_USR))
+            hspi_transfer();
+        return;
+    }
+    if ((addr >= PERIPHS_IO_MUX) && (addr < (PERIPHS_IO_MUX + IO_MUX_REGS * 4)))
+        io_mux_regs[(addr - PERIPHS_IO_MUX) / 4] = val;
+}
+
+// SCK on HSPI idles low (and is seen like an output), MISO on HSPI is an input
+void sim_pin_func_select(unsigned int addr, unsigned int func)
+{
+    if ((addr < PERIPHS_IO_MUX) || (addr >= (PERIPHS_IO_MUX + IO_MUX_REGS * 4)))
+        return;
+    pin_funcs[(addr - PERIPHS_IO_MUX) / 4] = func;
+    if ((addr == ESPBOT_D5_MUX) && (func == HSPI_FUNC))
+        gpio_output_set(0, BIT(ESPBOT_D5_NUM), BIT(ESPBOT_D5_NUM), 0);
+    if ((addr == ESPBOT_D6_MUX) && (func == HSPI_FUNC))
+        gpio_output_set(0, 0, 0, BIT(ESPBOT_D6_NUM));
+}
+
+void sim_get_hspi(struct sim_hspi *dest)
+{
+    os_memcpy(dest, &hspi, sizeof(struct sim_hspi));
+}
+
+//
+// interrupts
+//
+
+void ets_isr_attach(int i, ets_isr_t func, void *arg)
+{
+    if (i == ETS_GPIO_INUM)
+    {
+        gpio_isr = func;
+        gpio_isr_arg = arg;
+    }
+}
+
+void ets_isr_mask(uint32 mask)
+{
+    isr_mask &= ~mask;
+}
+
+void ets_isr_unmask(uint32 mask)
+{
+    isr_mask |= mask;
+    dispatch_gpio_isr();
+}
+
+//
+// hw timer (FRC1)
+//
+
+static void (*hw_timer_cb)(void);
+static bool hw_timer_autoload;
+static bool hw_timer_armed;
+static uint64 hw_timer_expire;
+static uint32 hw_timer_period;
+
+void hw_timer_set_func(void (*user_hw_timer_cb_set)(void))
+{
+    hw_timer_cb = user_hw_timer_cb_set;
+}
+
+void hw_timer_init(FRC1_TIMER_SOURCE_TYPE source_type, u8 req)
+{
+    (void)source_type;
+    hw_timer_autoload = (req == 1);
+    hw_timer_armed = false;
+}
+
+void hw_timer_arm(uint32 val)
+{
+    hw_timer_period = val;
+    hw_timer_expire = sim_time + val;
+    hw_timer_armed = true;
+}
+
+void hw_timer_disarm(void)
+{
+    hw_timer_armed = false;
+}
+
+// FRC1 counts at APB_CLK_FREQ / 16 (5 ticks per us), the load register is 23 bits
+void sim_rtc_reg_write(unsigned int addr, unsigned int val)
+{
+    if (addr != FRC1_LOAD_ADDRESS)
+        return;
+    stats.hw_timer_loads++;
+    val &= 0x7FFFFF;
+    hw_timer_period = (val + 2) / 5;
+    hw_timer_expire = sim_time + hw_timer_period;
+    hw_timer_armed = true;
+}
+
+//
+// os timers
+//
+
+static os_timer_t *timer_list;
+static uint32 timer_order;
+
+void ets_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction, void *parg)
+{
+    ptimer->timer_func = pfunction;
+    ptimer->timer_arg = parg;
+}
+
+void ets_timer_disarm(os_timer_t *ptimer)
+{
+    os_timer_t **cur = &timer_list;
+    while (*cur)
+    {
+        if (*cur == ptimer)
+        {
+            *cur = ptimer->timer_next;
+            break;
+        }
+        cur = &((*cur)->timer_next);
+    }
+    ptimer->timer_next = NULL;
+    ptimer->sim_armed = false;
+}
+
+void ets_timer_arm_new(os_timer_t *ptimer, uint32 time, bool repeat_flag, bool ms_flag)
+{
+    uint64 us = ms_flag ? ((uint64)time * 1000) : time;
+    if (ptimer->sim_armed)
+        ets_timer_disarm(ptimer);
+    ptimer->sim_expire = sim_time + us;
+    ptimer->sim_period = repeat_flag ? us : 0;
+    ptimer->sim_order = timer_order++;
+    ptimer->sim_armed = true;
+    ptimer->timer_next = timer_list;
+    timer_list = ptimer;
+}
+
+static os_timer_t *next_os_timer(void)
+{
+    os_timer_t *cur = timer_list;
+    os_timer_t *next = NULL;
+    while (cur)
+    {
+        if ((next == NULL) ||
+            (cur->sim_expire < next->sim_expire) ||
+            ((cur->sim_expire == next->sim_expire) && (cur->sim_order < next->sim_order)))
+            next = cur;
+        cur = cur->timer_next;
+    }
+    return next;
+}
+
+//
+// tasks
+//
+
+struct sim_task
+{
+    os_task_t task;
+    os_event_t *queue;
+    uint8 len;
+    int head;
+    int count;
+};
+
+static struct sim_task tasks[USER_TASK_PRIO_MAX];
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue, uint8 qlen)
+{
+    if ((prio >= USER_TASK_PRIO_MAX) || (queue == NULL) || (qlen == 0))
+        return false;
+    tasks[prio].task = task;
+    tasks[prio].queue = queue;
+    tasks[prio].len = qlen;
+    tasks[prio].head = 0;
+    tasks[prio].count = 0;
+    return true;
+}
+
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par)
+{
+    struct sim_task *cur;
+    if ((prio >= USER_TASK_PRIO_MAX) || (tasks[prio].task == NULL))
+        return false;
+    cur = &tasks[prio];
+    if (cur->count == cur->len)
+    {
+        stats.task_posts_dropped++;
+        return false;
+    }
+    cur->queue[(cur->head + cur->count) % cur->len].sig = sig;
+    cur->queue[(cur->head + cur->count) % cur->len].par = par;
+    cur->count++;
+    if ((uint32)cur->count > stats.task_queue_max)
+        stats.task_queue_max = cur->count;
+    return true;
+}
+
+// run every posted event, higher priority first
+static void run_tasks(void)
+{
+    int prio;
+    if (tasks_held)
+        return;
+    for (prio = (USER_TASK_PRIO_MAX - 1); prio >= 0; prio--)
+    {
+        struct sim_task *cur = &tasks[prio];
+        if (cur->count == 0)
+            continue;
+        os_event_t event = cur->queue[cur->head];
+        cur->head = (cur->head + 1) % cur->len;
+        cur->count--;
+        stats.task_events++;
+        cur->task(&event);
+        // a task may have posted to a higher priority
+        prio = USER_TASK_PRIO_MAX;
+    }
+}
+
+//
+// system
+//
+
+uint32 system_get_time(void)
+{
+    return (uint32)sim_time;
+}
+
+uint8 system_get_cpu_freq(void)
+{
+    return SIM_CPU_FREQ;
+}
+
+static uint32 sim_cycles; // cycles elapsed within the current virtual microsecond
+
+uint32 sim_get_ccount(void)
+{
+    // reading the counter takes some cycles so that busy waiting on it moves the clock on
+    uint32 ccount = (uint32)(sim_time * SIM_CPU_FREQ) + sim_cycles;
+    sim_cycles += SIM_CCOUNT_READ_CYCLES;
+    if (sim_cycles >= SIM_CPU_FREQ)
+    {
+        sim_cycles -= SIM_CPU_FREQ;
+        ets_delay_us(1);
+    }
+    return ccount;
+}
+
+uint32 system_get_free_heap_size(void)
+{
+    return 40960;
+}
+
+int os_printf_plus(const char *format, ...)
+{
+    va_list args;
+    int res;
+    va_start(args, format);
+    res = vprintf(format, args);
+    va_end(args);
+    return res;
+}
+
+int os_sprintf_plus(char *str, const char *format, ...)
+{
+    va_list args;
+    int res;
+    va_start(args, format);
+    res = vsprintf(str, format, args);
+    va_end(args);
+    return res;
+}
+
+int os_snprintf_plus(char *str, unsigned int size, const char *format, ...)
+{
+    va_list args;
+    int res;
+    va_start(args, format);
+    res = vsnprintf(str, size, format, args);
+    va_end(args);
+    return res;
+}
+
+//
+// pin waveforms
+//
+
+static bool next_transition(uint64 *time, int *gpio)
+{
+    bool found = false;
+    int idx;
+    for (idx = 0; idx < SIM_GPIO_COUNT; idx++)
+    {
+        if (pins[idx].script_count == 0)
+            continue;
+        if (!found || (pins[idx].script[pins[idx].script_head].time < *time))
+        {
+            *time = pins[idx].script[pins[idx].script_head].time;
+            *gpio = idx;
+            found = true;
+        }
+    }
+    return found;
+}
+
+// apply transitions due up to now without dispatching interrupts
+static uint32 apply_transitions(void)
+{
+    uint32 before = pin_levels();
+    uint64 time;
+    int gpio;
+    while (next_transition(&time, &gpio) && (time <= sim_time))
+    {
+        struct sim_pin *pin = &pins[gpio];
+        pin->ext_level = pin->script[pin->script_head].level;
+        pin->script_head = (pin->script_head + 1) % SIM_PIN_SCRIPT_LEN;
+        pin->script_count--;
+    }
+    return before;
+}
+
+static bool add_transition(int gpio, uint64 time, char level)
+{
+    struct sim_pin *pin = &pins[gpio];
+    if (pin->script_count == SIM_PIN_SCRIPT_LEN)
+        return false;
+    pin->script[(pin->script_head + pin->script_count) % SIM_PIN_SCRIPT_LEN].time = time;
+    pin->script[(pin->script_head + pin->script_count) % SIM_PIN_SCRIPT_LEN].level = level;
+    pin->script_count++;
+    return true;
+}
+
+bool sim_pin_script(int gpio, const struct sim_pulse *pulses, int count, uint32 delay)
+{
+    uint64 time = sim_time + delay;
+    int idx;
+    if ((gpio < 0) || (gpio >= SIM_GPIO_COUNT))
+        return false;
+    if ((pins[gpio].script_count + count + 1) > SIM_PIN_SCRIPT_LEN)
+        return false;
+    for (idx = 0; idx < count; idx++)
+    {
+        add_transition(gpio, time, pulses[idx].level);
+        time += pulses[idx].duration;
+    }
+    add_transition(gpio, time, pins[gpio].ext_level);
+    return true;
+}
+
+void sim_pin_clear_script(int gpio)
+{
+    if ((gpio < 0) || (gpio >= SIM_GPIO_COUNT))
+        return;
+    pins[gpio].script_head = 0;
+    pins[gpio].script_count = 0;
+}
+
+void sim_pin_drive(int gpio, int level)
+{
+    uint32 before = pin_levels();
+    if ((gpio < 0) || (gpio >= SIM_GPIO_COUNT))
+        return;
+    pins[gpio].ext_level = (level ? 1 : 0);
+    pins_changed(before);
+}
+
+int sim_pin_level(int gpio)
+{
+    return ((pin_levels() >> gpio) & 0x01);
+}
+
+void sim_set_output_cb(void (*cb)(int gpio, int level, void *param), void *param)
+{
+    output_cb = cb;
+    output_cb_param = param;
+}
+
+//
+// event loop
+//
+
+void ets_delay_us(uint32 us)
+{
+    // busy waiting: the clock moves on and so do the pins,
+    // the pending interrupts will be served by the event loop
+    sim_time += us;
+    uint32 before = apply_transitions();
+    isr_depth++;
+    pins_changed(before);
+    isr_depth--;
+}
+
+void sim_delay(uint32 us)
+{
+    ets_delay_us(us);
+}
+
+typedef enum
+{
+    EV_NONE = 0,
+    EV_PIN,
+    EV_HW_TIMER,
+    EV_OS_TIMER
+} Sim_event;
+
+static Sim_event next_event(uint64 *time)
+{
+    Sim_event event = EV_NONE;
+    uint64 pin_time;
+    int gpio;
+    os_timer_t *timer;
+    if (next_transition(&pin_time, &gpio))
+    {
+        *time = pin_time;
+        event = EV_PIN;
+    }
+    if (hw_timer_armed && ((event == EV_NONE) || (hw_timer_expire < *time)))
+    {
+        *time = hw_timer_expire;
+        event = EV_HW_TIMER;
+    }
+    timer = next_os_timer();
+    if (timer && ((event == EV_NONE) || (timer->sim_expire < *time)))
+    {
+        *time = timer->sim_expire;
+        event = EV_OS_TIMER;
+    }
+    return event;
+}
+
+static void run_event(Sim_event event)
+{
+    switch (event)
+    {
+    case EV_PIN:
+        pins_changed(apply_transitions());
+        break;
+    case EV_HW_TIMER:
+        if (hw_timer_autoload)
+            hw_timer_expire += hw_timer_period;
+        else
+            hw_timer_armed = false;
+        stats.hw_timer_calls++;
+        if (hw_timer_cb)
+        {
+            isr_depth++;
+            hw_timer_cb();
+            isr_depth--;
+        }
+        dispatch_gpio_isr();
+        break;
+    case EV_OS_TIMER:
+    {
+        os_timer_t *timer = next_os_timer();
+        ets_timer_disarm(timer);
+        if (timer->sim_period)
+        {
+            timer->sim_expire += timer->sim_period;
+            timer->sim_order = timer_order++;
+            timer->sim_armed = true;
+            timer->timer_next = timer_list;
+            timer_list = timer;
+        }
+        stats.os_timer_calls++;
+        if (timer->timer_func)
+            timer->timer_func(timer->timer_arg);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void sim_run_for(uint32 us)
+{
+    uint64 end = sim_time + us;
+    uint64 time;
+    Sim_event event;
+    while (true)
+    {
+        run_tasks();
+        event = next_event(&time);
+        if ((event == EV_NONE) || (time > end))
+            break;
+        if (time > sim_time)
+            sim_time = time;
+        run_event(event);
+    }
+    if (end > sim_time)
+        sim_time = end;
+}
+
+bool sim_run_until_idle(uint32 max_us)
+{
+    uint64 end = sim_time + max_us;
+    uint64 time;
+    Sim_event event;
+    while (true)
+    {
+        run_tasks();
+        event = next_event(&time);
+        if (event == EV_NONE)
+            return true;
+        if (time > end)
+        {
+            sim_time = end;
+            return false;
+        }
+        if (time > sim_time)
+            sim_time = time;
+        run_event(event);
+    }
+}
+
+uint64 sim_now(void)
+{
+    return sim_time;
+}
+
+void sim_reset(void)
+{
+    int idx;
+    sim_time = 0;
+    sim_cycles = 0;
+    isr_depth = 0;
+    for (idx = 0; idx < SIM_GPIO_COUNT; idx++)
+    {
+        pins[idx].ext_level = 1;
+        pins[idx].intr_state = GPIO_PIN_INTR_DISABLE;
+        pins[idx].script_head = 0;
+        pins[idx].script_count = 0;
+    }
+    gpio_out = 0;
+    gpio_enable = 0;
+    gpio_status = 0;
+    gpio_isr = NULL;
+    gpio_isr_arg = NULL;
+    isr_mask = 0;
+    output_cb = NULL;
+    output_cb_param = NULL;
+    hw_timer_cb = NULL;
+    hw_timer_armed = false;
+    hw_timer_autoload = false;
+    while (timer_list)
+        ets_timer_disarm(timer_list);
+    timer_order = 0;
+    for (idx = 0; idx < USER_TASK_PRIO_MAX; idx++)
+        os_memset(&tasks[idx], 0, sizeof(struct sim_task));
+    tasks_held = false;
+    os_memset(&stats, 0, sizeof(stats));
+    os_memset(hspi_regs, 0, sizeof(hspi_regs));
+    os_memset(io_mux_regs, 0, sizeof(io_mux_regs));
+    os_memset(pin_funcs, 0, sizeof(pin_funcs));
+    os_memset(&hspi, 0, sizeof(hspi));
+}
+
+void sim_hold_tasks(bool hold)
+{
+    tasks_held = hold;
+}
+
+void sim_get_stats(struct sim_stats *dest)
+{
+    os_memcpy(dest, &stats, sizeof(struct sim_stats));
+}
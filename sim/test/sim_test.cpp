@@ -0,0 +1,127 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "drivers_dio_task.h"
+}
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "sim_test.hpp"
+
+//
+// sim_test [name ...]
+// runs every registered test (or the named ones), exits with the failures count
+//
+
+static struct
+{
+    const char *name;
+    sim_test_func func;
+} tests[SIM_TEST_MAX];
+static int tests_count;
+
+Sim_test_reg::Sim_test_reg(const char *name, sim_test_func func)
+{
+    if (tests_count >= SIM_TEST_MAX)
+    {
+        fprintf(stderr, "too many tests, increase SIM_TEST_MAX\n");
+        exit(1);
+    }
+    tests[tests_count].name = name;
+    tests[tests_count].func = func;
+    tests_count++;
+}
+
+void sim_test_fail(const char *file, int line, const char *expr, long long value, long long expected)
+{
+    if (value == expected)
+        fprintf(stderr, "  %s:%d check failed: %s\n", file, line, expr);
+    else
+        fprintf(stderr, "  %s:%d check failed: %s (%lld, expected %lld)\n", file, line, expr, value, expected);
+    fflush(stderr);
+    _exit(1);
+}
+
+static bool selected(const char *name, int argc, char **argv)
+{
+    int idx;
+    if (argc < 2)
+        return true;
+    for (idx = 1; idx < argc; idx++)
+        if (0 == strcmp(name, argv[idx]))
+            return true;
+    return false;
+}
+
+static bool run(int idx)
+{
+    int status;
+    pid_t pid;
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0)
+    {
+        perror("fork");
+        return false;
+    }
+    if (pid == 0)
+    {
+        alarm(SIM_TEST_TIMEOUT_S);
+        sim_reset();
+        init_dio_task();
+        tests[idx].func();
+        fflush(stdout);
+        _exit(0);
+    }
+    if (waitpid(pid, &status, 0) < 0)
+    {
+        perror("waitpid");
+        return false;
+    }
+    if (WIFSIGNALED(status))
+    {
+        if (WTERMSIG(status) == SIGALRM)
+            fprintf(stderr, "  timed out after %d s\n", SIM_TEST_TIMEOUT_S);
+        else
+            fprintf(stderr, "  killed by signal %d\n", WTERMSIG(status));
+        return false;
+    }
+    return (WIFEXITED(status) && (WEXITSTATUS(status) == 0));
+}
+
+int main(int argc, char **argv)
+{
+    int failures = 0;
+    int executed = 0;
+    int idx;
+    for (idx = 0; idx < tests_count; idx++)
+    {
+        if (!selected(tests[idx].name, argc, argv))
+            continue;
+        executed++;
+        if (run(idx))
+        {
+            printf("PASS %s\n", tests[idx].name);
+        }
+        else
+        {
+            printf("FAIL %s\n", tests[idx].name);
+            failures++;
+        }
+    }
+    printf("%d tests, %d failures\n", executed, failures);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SIM_TEST_HPP__
+#define __SIM_TEST_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+#include "sim_hal.h"
+}
+
+//
+// host tests of the drivers on the simulation HAL
+//
+// every test runs into its own process (the drivers keep static state)
+// starting from sim_reset() and init_dio_task(), and fails on the first
+// failed check or after SIM_TEST_TIMEOUT_S seconds of wall clock time
+// (e.g. an isr never returning)
+//
+//   SIM_TEST(di_seq_one_shot)
+//   {
+//       ...
+//       SIM_CHECK(get_di_seq_length(seq) == 3);
+//       SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, 0), 1000);
+//   }
+//
+
+#define SIM_TEST_TIMEOUT_S 10
+#define SIM_TEST_MAX 128
+
+typedef void (*sim_test_func)(void);
+
+class Sim_test_reg
+{
+public:
+    Sim_test_reg(const char *name, sim_test_func func);
+};
+
+void sim_test_fail(const char *file, int line, const char *expr, long long value, long long expected);
+
+#define SIM_TEST(name)                                 \
+    static void name(void);                            \
+    static Sim_test_reg name##_reg(#name, name);       \
+    static void name(void)
+
+#define SIM_CHECK(cond)                                          \
+    do                                                           \
+    {                                                            \
+        if (!(cond))                                             \
+            sim_test_fail(__FILE__, __LINE__, #cond, 0, 0);      \
+    } while (0)
+
+#define SIM_CHECK_EQ(value, expected)                                                           \
+    do                                                                                          \
+    {                                                                                           \
+        long long sim_value = (long long)(value);                                               \
+        long long sim_expected = (long long)(expected);                                         \
+        if (sim_value != sim_expected)                                                          \
+            sim_test_fail(__FILE__, __LINE__, #value " == " #expected, sim_value, sim_expected); \
+    } while (0)
+
+// |value - expected| <= tolerance
+#define SIM_CHECK_NEAR(value, expected, tolerance)                                              \
+    do                                                                                          \
+    {                                                                                           \
+        long long sim_value = (long long)(value);                                               \
+        long long sim_expected = (long long)(expected);                                         \
+        if ((sim_value < (sim_expected - (tolerance))) || (sim_value > (sim_expected + (tolerance)))) \
+            sim_test_fail(__FILE__, __LINE__, #value " ~ " #expected, sim_value, sim_expected); \
+    } while (0)
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "esp8266_io.h"
+#include "drivers_dio_task.h"
+}
+
+#include "drivers_dht.hpp"
+#include "sim_test.hpp"
+
+//
+// DHT frames decoded from a sensor model
+//
+// the model answers any start pulse (host LOW for at least 1 ms) on D1 or D2
+// with the 40 bits frame in data (checksum computed unless bad_checksum)
+//
+
+static struct
+{
+    uint8 data[4];
+    bool bad_checksum;
+    uint32 one_us; // high time of a 1 bit
+    int frames;
+    uint64 low_start;
+    uint64 start[2]; // last start pulse begin on D1, D2
+} model;
+
+static void dht_model(int gpio, int level, void *param)
+{
+    struct sim_pulse pulses[84];
+    uint8 frame[5];
+    int count = 0;
+    int idx;
+    if ((gpio != ESPBOT_D1_NUM) && (gpio != ESPBOT_D2_NUM))
+        return;
+    if (level == ESPBOT_LOW)
+    {
+        model.low_start = sim_now();
+        return;
+    }
+    if ((sim_now() - model.low_start) < 1000)
+        return;
+    model.start[(gpio == ESPBOT_D1_NUM) ? 0 : 1] = model.low_start;
+    os_memcpy(frame, model.data, 4);
+    frame[4] = frame[0] + frame[1] + frame[2] + frame[3];
+    if (model.bad_checksum)
+        frame[4]++;
+    pulses[count++] = {ESPBOT_HIGH, 30};
+    pulses[count++] = {ESPBOT_LOW, 80};
+    pulses[count++] = {ESPBOT_HIGH, 80};
+    for (idx = 0; idx < 40; idx++)
+    {
+        pulses[count++] = {ESPBOT_LOW, 50};
+        pulses[count++] = {ESPBOT_HIGH, (frame[idx / 8] & (0x80 >> (idx % 8))) ? model.one_us : 26};
+    }
+    pulses[count++] = {ESPBOT_LOW, 50};
+    sim_pin_script(gpio, pulses, count, 0);
+    model.frames++;
+}
+
+static void model_init(uint8 d0, uint8 d1, uint8 d2, uint8 d3)
+{
+    model.data[0] = d0;
+    model.data[1] = d1;
+    model.data[2] = d2;
+    model.data[3] = d3;
+    model.bad_checksum = false;
+    model.one_us = 70;
+    model.frames = 0;
+    sim_set_output_cb(dht_model, NULL);
+}
+
+static int readings_done;
+
+// values in tenths, rounded
+static int tenths(float value)
+{
+    return (int)((value * 10) + ((value < 0) ? -0.5f : 0.5f));
+}
+
+static void reading_done(void *param)
+{
+    readings_done++;
+}
+
+SIM_TEST(dht22_frame_decode)
+{
+    sensors_event_t event;
+    // 45.6 %, 23.4 C
+    model_init(0x01, 0xC8, 0x00, 0xEA);
+    Dht *dht = new Dht(ESPBOT_D2, DHT22, 1, 2, 0, 4);
+    dht->temperature.force_reading(reading_done, NULL);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(model.frames, 1);
+    dht->temperature.getEvent(&event);
+    SIM_CHECK(!event.invalid);
+    SIM_CHECK_EQ(event.sensor_id, 1);
+    SIM_CHECK_EQ(tenths(event.temperature), 234);
+    dht->humidity.getEvent(&event);
+    SIM_CHECK(!event.invalid);
+    SIM_CHECK_EQ(event.sensor_id, 2);
+    SIM_CHECK_EQ(tenths(event.relative_humidity), 456);
+    SIM_CHECK_EQ(dht->temperature.getSequence(), 1);
+    SIM_CHECK_EQ(dht->humidity.getSequence(), 1);
+    delete dht;
+}
+
+SIM_TEST(dht22_negative_temperature)
+{
+    sensors_event_t event;
+    // 80.0 %, -10.1 C (sign bit)
+    model_init(0x03, 0x20, 0x80, 0x65);
+    Dht *dht = new Dht(ESPBOT_D2, DHT22, 1, 2, 0, 4);
+    dht->temperature.force_reading(reading_done, NULL);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    dht->temperature.getEvent(&event);
+    SIM_CHECK(!event.invalid);
+    SIM_CHECK_EQ(tenths(event.temperature), -101);
+    dht->humidity.getEvent(&event);
+    SIM_CHECK_EQ(tenths(event.relative_humidity), 800);
+    delete dht;
+}
+
+SIM_TEST(dht11_frame_decode)
+{
+    sensors_event_t event;
+    // 40 %, 21 C
+    model_init(40, 0, 21, 0);
+    Dht *dht = new Dht(ESPBOT_D2, DHT11, 1, 2, 0, 4);
+    dht->temperature.force_reading(reading_done, NULL);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(readings_done, 1);
+    dht->temperature.getEvent(&event);
+    SIM_CHECK(!event.invalid);
+    SIM_CHECK_EQ(tenths(event.temperature), 210);
+    dht->humidity.getEvent(&event);
+    SIM_CHECK_EQ(tenths(event.relative_humidity), 400);
+    delete dht;
+}
+
+SIM_TEST(dht22_checksum_error)
+{
+    struct dht_reading_stats stats;
+    sensors_event_t event;
+    model_init(0x01, 0xC8, 0x00, 0xEA);
+    model.bad_checksum = true;
+    Dht *dht = new Dht(ESPBOT_D2, DHT22, 1, 2, 0, 4);
+    dht->temperature.force_reading(reading_done, NULL);
+    SIM_CHECK(sim_run_until_idle(10000000));
+    // first attempt plus 2 retries, then an invalid sample
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(model.frames, 3);
+    dht->get_reading_stats(&stats);
+    SIM_CHECK_EQ(stats.attempts, 3);
+    SIM_CHECK_EQ(stats.retries, 2);
+    SIM_CHECK_EQ(stats.failures, 1);
+    dht->temperature.getEvent(&event);
+    SIM_CHECK(event.invalid);
+    delete dht;
+}
+
+// a request arriving right after an idle bus release still waits for the spacing
+static Dht *bus_second;
+static uint64 bus_first_done;
+
+static void bus_first_done_cb(void *param)
+{
+    bus_first_done = sim_now();
+    bus_second->temperature.force_reading(reading_done, NULL);
+}
+
+SIM_TEST(dht_bus_spacing_after_idle_release)
+{
+    struct dht_bus_stats stats;
+    model_init(0x01, 0xC8, 0x00, 0xEA);
+    Dht *first = new Dht(ESPBOT_D1, DHT22, 1, 2, 0, 4);
+    bus_second = new Dht(ESPBOT_D2, DHT22, 3, 4, 0, 4);
+    first->temperature.force_reading(bus_first_done_cb, NULL);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(model.frames, 2);
+    SIM_CHECK(model.start[1] >= (bus_first_done + 5000));
+    SIM_CHECK(model.start[1] < (bus_first_done + 7000));
+    get_dht_bus_stats(&stats);
+    SIM_CHECK_EQ(stats.readings, 2);
+    delete bus_second;
+    delete first;
+}
+
+SIM_TEST(dht_delete_with_completion_queued)
+{
+    struct dio_task_stats stats;
+    model_init(0x01, 0xC8, 0x00, 0xEA);
+    Dht *dht = new Dht(ESPBOT_D2, DHT22, 1, 2, 0, 4);
+    dht->temperature.force_reading(reading_done, NULL);
+    while (model.frames == 0)
+        sim_run_for(100);
+    // the frame ends while the task is busy, the completion stays queued
+    sim_hold_tasks(true);
+    sim_run_for(10000);
+    delete dht;
+    sim_hold_tasks(false);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(readings_done, 0);
+    get_dio_task_stats(&stats);
+    SIM_CHECK_EQ(stats.posted, stats.handled + 1);
+}
@@ -0,0 +1,295 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "esp8266_io.h"
+#include "drivers_di_sequence.h"
+}
+
+#include "sim_test.hpp"
+
+//
+// input sequences captured from scripted waveforms
+//
+
+static int completions;
+
+static void seq_completed(void *param)
+{
+    completions++;
+}
+
+// direct callbacks run into the isr, they stop the timeout themselves
+static void seq_completed_direct(void *param)
+{
+    stop_di_sequence_timeout((struct di_seq *)param);
+    completions++;
+}
+
+// pin is HIGH (pull-up), then LOW 1000 us, HIGH 2000 us, LOW 500 us, back to HIGH
+static const struct sim_pulse waveform[] = {{ESPBOT_LOW, 1000}, {ESPBOT_HIGH, 2000}, {ESPBOT_LOW, 500}};
+
+static void check_waveform(struct di_seq *seq)
+{
+    SIM_CHECK_EQ(completions, 1);
+    SIM_CHECK(!seq->ended_by_timeout);
+    SIM_CHECK_EQ(get_di_seq_length(seq), 3);
+    SIM_CHECK_EQ(get_di_seq_pulse_level(seq, 0), ESPBOT_LOW);
+    SIM_CHECK_EQ(get_di_seq_pulse_level(seq, 1), ESPBOT_HIGH);
+    SIM_CHECK_EQ(get_di_seq_pulse_level(seq, 2), ESPBOT_LOW);
+    SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, 0), 1000);
+    SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, 1), 2000);
+    SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, 2), 500);
+}
+
+SIM_TEST(di_seq_capture)
+{
+    struct di_seq *seq = new_di_seq(ESPBOT_D5_NUM, 3, 20, TIMEOUT_MS);
+    SIM_CHECK(seq != NULL);
+    set_di_seq_cb(seq, seq_completed, seq, task);
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, waveform, 3, 100));
+    read_di_sequence(seq);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    check_waveform(seq);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_capture_compact)
+{
+    struct di_seq *seq = new_di_seq_compact(ESPBOT_D5_NUM, 3, 20, TIMEOUT_MS);
+    SIM_CHECK(seq != NULL);
+    set_di_seq_cb(seq, seq_completed, seq, task);
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, waveform, 3, 100));
+    read_di_sequence(seq);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    check_waveform(seq);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_compact_long_gaps)
+{
+    // one more long pulse than the long gaps table holds
+    struct sim_pulse pulses[DI_SEQ_LONG_GAPS + 1];
+    int idx;
+    for (idx = 0; idx <= DI_SEQ_LONG_GAPS; idx++)
+        pulses[idx] = {(char)((idx % 2) ? ESPBOT_HIGH : ESPBOT_LOW), 70000u + idx};
+    struct di_seq *seq = new_di_seq_compact(ESPBOT_D5_NUM, (DI_SEQ_LONG_GAPS + 1), 1000, TIMEOUT_MS);
+    SIM_CHECK(seq != NULL);
+    set_di_seq_cb(seq, seq_completed, seq, task);
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, pulses, (DI_SEQ_LONG_GAPS + 1), 100));
+    read_di_sequence(seq);
+    SIM_CHECK(sim_run_until_idle(2000000));
+    SIM_CHECK_EQ(completions, 1);
+    SIM_CHECK_EQ(get_di_seq_length(seq), (DI_SEQ_LONG_GAPS + 1));
+    for (idx = 0; idx < DI_SEQ_LONG_GAPS; idx++)
+        SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, idx), 70000 + idx);
+    // not a wrong duration: reported as unknown
+    SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, DI_SEQ_LONG_GAPS), (uint32)-1);
+    SIM_CHECK(seq->long_gap_overflow);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_capture_ccount)
+{
+    struct di_seq *seq = new_di_seq(ESPBOT_D5_NUM, 3, 20, TIMEOUT_MS);
+    SIM_CHECK(seq != NULL);
+    set_di_seq_cb(seq, seq_completed_direct, seq, direct);
+    set_di_seq_timestamp(seq, TIMESTAMP_CCOUNT);
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, waveform, 3, 100));
+    read_di_sequence(seq);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    check_waveform(seq);
+    // each CCOUNT read costs SIM_CCOUNT_READ_CYCLES
+    SIM_CHECK_NEAR(get_di_seq_pulse_duration_ns(seq, 2), 500000, 100);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_timeout)
+{
+    // waiting for 5 pulses, the waveform has 3 (plus the edge back to HIGH)
+    struct di_seq *seq = new_di_seq(ESPBOT_D5_NUM, 5, 20, TIMEOUT_MS);
+    SIM_CHECK(seq != NULL);
+    set_di_seq_cb(seq, seq_completed, seq, task);
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, waveform, 3, 100));
+    read_di_sequence(seq);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(completions, 1);
+    SIM_CHECK(seq->ended_by_timeout);
+    SIM_CHECK_EQ(get_di_seq_length(seq), 3);
+    SIM_CHECK_EQ(get_di_seq_pulse_duration(seq, 2), 500);
+    free_di_seq(seq);
+}
+
+//
+// streaming
+//
+
+#define STREAM_PULSES 64
+
+static struct
+{
+    struct di_seq *seq;
+    int batches;
+    int pulses;
+    int partial_batches;
+    char level[STREAM_PULSES];
+    uint32 duration[STREAM_PULSES];
+    int stop_at_batch; // stopping from the batch callback
+} consumer;
+
+static void batch_ready(void *param)
+{
+    struct di_seq *seq = (struct di_seq *)param;
+    int idx;
+    consumer.batches++;
+    if (get_di_seq_batch_length(seq) < seq->stream_batch_size)
+        consumer.partial_batches++;
+    for (idx = 0; idx < get_di_seq_batch_length(seq); idx++)
+    {
+        if (consumer.pulses < STREAM_PULSES)
+        {
+            consumer.level[consumer.pulses] = get_di_seq_batch_pulse_level(seq, idx);
+            consumer.duration[consumer.pulses] = get_di_seq_batch_pulse_duration(seq, idx);
+        }
+        consumer.pulses++;
+    }
+    if (consumer.batches == consumer.stop_at_batch)
+        stop_di_seq_stream(seq);
+}
+
+// count pulses, first one LOW, durations 100, 110, 120, ...
+// (count is odd: the last pulse is LOW and ends going back to HIGH)
+static void stream_waveform(int count, uint32 delay)
+{
+    struct sim_pulse pulses[STREAM_PULSES];
+    int idx;
+    for (idx = 0; idx < count; idx++)
+    {
+        pulses[idx].level = (idx % 2) ? ESPBOT_HIGH : ESPBOT_LOW;
+        pulses[idx].duration = 100 + 10 * idx;
+    }
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, pulses, count, delay));
+}
+
+static void check_stream(int count)
+{
+    int idx;
+    SIM_CHECK_EQ(consumer.pulses, count);
+    for (idx = 0; idx < count; idx++)
+    {
+        SIM_CHECK_EQ(consumer.level[idx], (idx % 2) ? ESPBOT_HIGH : ESPBOT_LOW);
+        SIM_CHECK_EQ(consumer.duration[idx], 100 + 10 * idx);
+    }
+}
+
+static struct di_seq *new_stream(int batch_size, int flush_ms)
+{
+    struct di_seq *seq = new_di_seq_stream(ESPBOT_D5_NUM, batch_size, flush_ms);
+    SIM_CHECK(seq != NULL);
+    set_di_seq_cb(seq, batch_ready, seq, task);
+    consumer.seq = seq;
+    return seq;
+}
+
+SIM_TEST(di_seq_stream_batches)
+{
+    struct di_seq *seq = new_stream(4, 10);
+    read_di_seq_stream(seq);
+    stream_waveform(9, 100);
+    sim_run_for(50000);
+    // 2 full batches then the partial one flushed
+    check_stream(9);
+    SIM_CHECK_EQ(consumer.batches, 3);
+    SIM_CHECK_EQ(consumer.partial_batches, 1);
+    SIM_CHECK_EQ(seq->stream_overruns, 0);
+    stop_di_seq_stream(seq);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_stream_flush_skipped_while_batches_flow)
+{
+    struct sim_pulse pulses[STREAM_PULSES];
+    struct di_seq *seq = new_stream(4, 5);
+    int idx;
+    // a pulse every ms: a full batch every 4 ms, no partial batch needed
+    for (idx = 0; idx < 39; idx++)
+    {
+        pulses[idx].level = (idx % 2) ? ESPBOT_HIGH : ESPBOT_LOW;
+        pulses[idx].duration = 1000;
+    }
+    read_di_seq_stream(seq);
+    SIM_CHECK(sim_pin_script(ESPBOT_D5_NUM, pulses, 39, 100));
+    sim_run_for(40000);
+    SIM_CHECK_EQ(consumer.partial_batches, 0);
+    SIM_CHECK_EQ(consumer.pulses, 36);
+    // then the stream goes idle, the rest is flushed within 2 flush periods
+    sim_run_for(10000);
+    SIM_CHECK_EQ(consumer.pulses, 39);
+    SIM_CHECK_EQ(consumer.partial_batches, 1);
+    stop_di_seq_stream(seq);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_stream_flush_waits_for_release)
+{
+    struct di_seq *seq = new_stream(4, 10);
+    read_di_seq_stream(seq);
+    // the task is busy: the first batch waits while the flush finds a partial one
+    sim_hold_tasks(true);
+    stream_waveform(5, 100);
+    sim_run_for(25000);
+    SIM_CHECK_EQ(consumer.batches, 0);
+    sim_hold_tasks(false);
+    sim_run_for(1000);
+    check_stream(5);
+    SIM_CHECK_EQ(consumer.batches, 2);
+    SIM_CHECK_EQ(seq->stream_overruns, 0);
+    stop_di_seq_stream(seq);
+    free_di_seq(seq);
+}
+
+SIM_TEST(di_seq_stream_stop_delivers_queued)
+{
+    struct di_seq *seq = new_stream(4, 10);
+    read_di_seq_stream(seq);
+    sim_hold_tasks(true);
+    stream_waveform(5, 100);
+    sim_run_for(5000);
+    // a batch is queued for the task and a partial one is being filled
+    stop_di_seq_stream(seq);
+    check_stream(5);
+    SIM_CHECK_EQ(consumer.batches, 2);
+    free_di_seq(seq);
+    // the queued event was cancelled: nothing reaches the freed sequence
+    sim_hold_tasks(false);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(consumer.batches, 2);
+}
+
+SIM_TEST(di_seq_stream_stop_from_callback)
+{
+    struct di_seq *seq = new_stream(4, 10);
+    consumer.stop_at_batch = 1;
+    read_di_seq_stream(seq);
+    sim_hold_tasks(true);
+    stream_waveform(5, 100);
+    sim_run_for(5000);
+    // the partial batch follows the first one as soon as the callback returns
+    sim_hold_tasks(false);
+    sim_run_for(1);
+    check_stream(5);
+    SIM_CHECK_EQ(consumer.batches, 2);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(consumer.batches, 2);
+    free_di_seq(seq);
+}
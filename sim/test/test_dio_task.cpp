@@ -0,0 +1,50 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "user_interface.h"
+#include "drivers_dio_task.h"
+}
+
+#include "sim_test.hpp"
+
+//
+// dio task wake ups
+//
+
+static int handled;
+
+static void user_handler(void *param)
+{
+    handled++;
+}
+
+SIM_TEST(dio_task_lost_wake_up)
+{
+    struct dio_task_stats stats;
+    SIM_CHECK(dio_set_handler(SIG_DIO_USER, user_handler));
+    // the SDK queue is full, the wake up is lost
+    sim_hold_tasks(true);
+    while (system_os_post(USER_TASK_PRIO_2, 0, 0))
+        ;
+    SIM_CHECK(dio_post(SIG_DIO_USER, NULL));
+    get_dio_task_stats(&stats);
+    SIM_CHECK_EQ(stats.wake_up_failures, 1);
+    sim_hold_tasks(false);
+    sim_run_for(1000);
+    SIM_CHECK_EQ(handled, 1);
+    // and the next post wakes up the task again
+    SIM_CHECK(dio_post(SIG_DIO_USER, NULL));
+    sim_run_for(1000);
+    SIM_CHECK_EQ(handled, 2);
+    get_dio_task_stats(&stats);
+    SIM_CHECK_EQ(stats.wake_up_failures, 1);
+}
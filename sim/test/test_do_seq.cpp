@@ -0,0 +1,267 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "esp8266_io.h"
+#include "drivers_do_sequence.h"
+}
+
+#include "sim_test.hpp"
+
+//
+// output sequences edges timing
+//
+
+#define EDGES_MAX 64
+
+static struct
+{
+    int count;
+    uint64 time[EDGES_MAX];
+    int level[EDGES_MAX];
+} edges;
+
+static void edge_recorder(int gpio, int level, void *param)
+{
+    if (gpio != ESPBOT_D4_NUM)
+        return;
+    if (edges.count < EDGES_MAX)
+    {
+        edges.time[edges.count] = sim_now();
+        edges.level[edges.count] = level;
+    }
+    edges.count++;
+}
+
+static int completions;
+
+static void seq_completed(void *param)
+{
+    completions++;
+}
+
+static struct do_seq *new_seq(const uint32 *durations, int count)
+{
+    struct do_seq *seq = new_do_seq(ESPBOT_D4_NUM, count);
+    int idx;
+    SIM_CHECK(seq != NULL);
+    set_do_seq_cb(seq, seq_completed, seq, task);
+    out_seq_clear(seq);
+    for (idx = 0; idx < count; idx++)
+        out_seq_add(seq, (idx % 2) ? ESPBOT_HIGH : ESPBOT_LOW, durations[idx]);
+    GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+    sim_set_output_cb(edge_recorder, NULL);
+    return seq;
+}
+
+// pulses alternate LOW, HIGH, ... (count is odd, the last one is LOW)
+// edges at the exact pulse boundaries (1 us, the CCOUNT wait resolution)
+// then back to HIGH
+static void check_edges(const uint32 *durations, int count, int cycles)
+{
+    uint64 start = edges.time[0];
+    uint64 expected = start;
+    int edge = 0;
+    int cycle;
+    int idx;
+    SIM_CHECK_EQ(edges.count, count * cycles + 1);
+    for (cycle = 0; cycle < cycles; cycle++)
+        for (idx = 0; idx < count; idx++)
+        {
+            SIM_CHECK_EQ(edges.level[edge], (idx % 2) ? ESPBOT_HIGH : ESPBOT_LOW);
+            SIM_CHECK_NEAR(edges.time[edge], expected, 1);
+            expected += durations[idx];
+            edge++;
+        }
+    SIM_CHECK_EQ(edges.level[edge], ESPBOT_HIGH);
+    SIM_CHECK_NEAR(edges.time[edge], expected, 1);
+}
+
+SIM_TEST(do_seq_compiled_edges)
+{
+    static const uint32 durations[] = {2, 3, 5, 50, 8, 100, 20, 1000, 7};
+    struct sim_stats stats;
+    struct do_seq *seq = new_seq(durations, 9);
+    SIM_CHECK(compile_do_seq(seq));
+    exe_do_seq_us(seq);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    check_edges(durations, 9, 1);
+    // the 4 long pulses re-armed the timer with the precomputed FRC1 loads
+    sim_get_stats(&stats);
+    SIM_CHECK_EQ(stats.hw_timer_loads, 4);
+    free_do_seq(seq);
+}
+
+SIM_TEST(do_seq_compiled_long_pulses)
+{
+    // CCOUNT ticks would overflow (53.7 s at 80 MHz)
+    static const uint32 durations[] = {20, 60000000, 3, 1500000, 7};
+    struct do_seq *seq = new_seq(durations, 5);
+    SIM_CHECK(compile_do_seq(seq));
+    exe_do_seq_us(seq);
+    SIM_CHECK(sim_run_until_idle(70000000));
+    SIM_CHECK_EQ(completions, 1);
+    check_edges(durations, 5, 1);
+    free_do_seq(seq);
+}
+
+SIM_TEST(do_seq_compiled_spin_limit)
+{
+    static const uint32 durations[] = {10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10};
+    static const uint32 durations_ok[] = {10, 10, 10, 10, 10, 20, 10, 10, 10, 10, 10};
+    struct do_seq *seq = new_seq(durations, 11);
+    // 110 us busy waited in a single isr run
+    SIM_CHECK(!compile_do_seq(seq));
+    free_do_seq(seq);
+    seq = new_seq(durations_ok, 11);
+    SIM_CHECK(compile_do_seq(seq));
+    // 100 us across the cycle boundary
+    SIM_CHECK(set_do_seq_repeat(seq, 3));
+    exe_do_seq_us(seq);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    SIM_CHECK_EQ(edges.time[edges.count - 1] - edges.time[0], 3 * 120);
+    SIM_CHECK(out_seq_update(seq, 0, 11));
+    SIM_CHECK(!commit_do_seq_update(seq));
+    free_do_seq(seq);
+}
+
+SIM_TEST(do_seq_us_edges)
+{
+    static const uint32 durations[] = {20, 30, 50, 100, 40};
+    struct do_seq *seq = new_seq(durations, 5);
+    exe_do_seq_us(seq);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    check_edges(durations, 5, 1);
+    free_do_seq(seq);
+}
+
+SIM_TEST(do_seq_free_running)
+{
+    static const uint32 durations[] = {200, 300, 500, 100, 400};
+    struct do_seq *seq = new_seq(durations, 5);
+    exe_do_seq_us(seq);
+    sim_run_for(250);
+    // no more edges and no completion once freed
+    free_do_seq(seq);
+    SIM_CHECK_EQ(edges.count, 2);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(edges.count, 2);
+    SIM_CHECK_EQ(completions, 0);
+}
+
+SIM_TEST(do_pseq_edges)
+{
+    uint32 pins = BIT(ESPBOT_D4_NUM) | BIT(ESPBOT_D7_NUM);
+    struct sim_stats stats;
+    struct do_pseq *seq = new_do_pseq(pins, 5);
+    static const uint32 durations[] = {100, 4, 300, 50, 20};
+    int idx;
+    SIM_CHECK(seq != NULL);
+    set_do_pseq_cb(seq, seq_completed, seq, task);
+    out_pseq_clear(seq);
+    for (idx = 0; idx < 5; idx++)
+        out_pseq_add(seq, (idx % 2) ? pins : 0, durations[idx]);
+    GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+    GPIO_OUTPUT_SET(ESPBOT_D7_NUM, ESPBOT_HIGH);
+    sim_set_output_cb(edge_recorder, NULL);
+    exe_do_pseq_us(seq);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    check_edges(durations, 5, 1);
+    SIM_CHECK_EQ(sim_pin_level(ESPBOT_D7_NUM), ESPBOT_HIGH);
+    sim_get_stats(&stats);
+    SIM_CHECK_EQ(stats.hw_timer_loads, 4);
+    free_do_pseq(seq);
+}
+
+//
+// repeating sequences
+//
+
+SIM_TEST(do_seq_repeat_burst)
+{
+    static const uint32 durations[] = {100, 300, 50};
+    struct do_seq *seq = new_seq(durations, 3);
+    SIM_CHECK(set_do_seq_repeat(seq, 4));
+    exe_do_seq_us(seq);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    // LOW 50 then LOW 100: the cycles join without an edge
+    SIM_CHECK_EQ(edges.count, 3 + 2 * 3 + 1);
+    SIM_CHECK_EQ(edges.time[edges.count - 1] - edges.time[0], 4 * 450);
+    free_do_seq(seq);
+}
+
+SIM_TEST(do_seq_repeat_compiled_stop_and_update)
+{
+    static const uint32 durations[] = {20, 80, 20};
+    struct do_seq *seq = new_seq(durations, 3);
+    uint64 stop_time;
+    SIM_CHECK(set_do_seq_repeat(seq, DO_SEQ_REPEAT_FOREVER));
+    SIM_CHECK(compile_do_seq(seq));
+    exe_do_seq_us(seq);
+    sim_run_for(1000);
+    // a new duty cycle at the next cycle boundary
+    SIM_CHECK(out_seq_update(seq, 1, 60));
+    SIM_CHECK(out_seq_update(seq, 2, 40));
+    SIM_CHECK(commit_do_seq_update(seq));
+    sim_run_for(1000);
+    stop_do_seq(seq);
+    stop_time = sim_now();
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    // the sequence ends at the cycle boundary
+    SIM_CHECK_EQ(edges.level[edges.count - 1], ESPBOT_HIGH);
+    SIM_CHECK((edges.time[edges.count - 1] - stop_time) <= 120);
+    SIM_CHECK_EQ((edges.time[edges.count - 1] - edges.time[0]) % 120, 0);
+    // the last cycle: 20 LOW, 60 HIGH, 40 LOW
+    SIM_CHECK_EQ(edges.time[edges.count - 1] - edges.time[edges.count - 2], 40);
+    SIM_CHECK_EQ(edges.time[edges.count - 2] - edges.time[edges.count - 3], 60);
+    free_do_seq(seq);
+}
+
+SIM_TEST(do_seq_repeat_compiled_short_pulses_rejected)
+{
+    static const uint32 durations[] = {5, 10, 5};
+    static const uint32 durations_ok[] = {20, 10, 5};
+    struct do_seq *seq = new_seq(durations, 3);
+    // compiling a repeating sequence that would never leave the isr
+    SIM_CHECK(set_do_seq_repeat(seq, DO_SEQ_REPEAT_FOREVER));
+    SIM_CHECK(!compile_do_seq(seq));
+    SIM_CHECK(set_do_seq_repeat(seq, 1000));
+    SIM_CHECK(!compile_do_seq(seq));
+    // repeating a compiled one
+    SIM_CHECK(set_do_seq_repeat(seq, 1));
+    SIM_CHECK(compile_do_seq(seq));
+    SIM_CHECK(!set_do_seq_repeat(seq, DO_SEQ_REPEAT_FOREVER));
+    SIM_CHECK_EQ(seq->repeat_cycles, 1);
+    free_do_seq(seq);
+    // updating a running one
+    seq = new_seq(durations_ok, 3);
+    SIM_CHECK(set_do_seq_repeat(seq, DO_SEQ_REPEAT_FOREVER));
+    SIM_CHECK(compile_do_seq(seq));
+    exe_do_seq_us(seq);
+    sim_run_for(500);
+    SIM_CHECK(out_seq_update(seq, 0, 5));
+    SIM_CHECK(!commit_do_seq_update(seq));
+    SIM_CHECK(out_seq_update(seq, 1, 15));
+    SIM_CHECK(commit_do_seq_update(seq));
+    sim_run_for(500);
+    stop_do_seq(seq);
+    SIM_CHECK(sim_run_until_idle(100000));
+    SIM_CHECK_EQ(completions, 1);
+    free_do_seq(seq);
+}
@@ -0,0 +1,61 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "ets_sys.h"
+#include "gpio.h"
+#include "esp8266_io.h"
+#include "drivers_gpio_isr.h"
+}
+
+#include "sim_test.hpp"
+
+//
+// shared GPIO interrupt dispatcher
+//
+
+static int handler_calls;
+
+static void count_handler(void *param)
+{
+    handler_calls++;
+}
+
+SIM_TEST(gpio_isr_attach_keeps_mask)
+{
+    gpio_isr_attach(ESPBOT_D5_NUM, count_handler, NULL);
+    gpio_pin_intr_state_set(ESPBOT_D5_NUM, GPIO_PIN_INTR_ANYEDGE);
+    sim_pin_drive(ESPBOT_D5_NUM, 0);
+    SIM_CHECK_EQ(handler_calls, 1);
+    // attaching into a critical section doesn't unmask the interrupt
+    ETS_GPIO_INTR_DISABLE();
+    gpio_isr_attach(ESPBOT_D6_NUM, count_handler, NULL);
+    sim_pin_drive(ESPBOT_D5_NUM, 1);
+    SIM_CHECK_EQ(handler_calls, 1);
+    ETS_GPIO_INTR_ENABLE();
+    SIM_CHECK_EQ(handler_calls, 2);
+    gpio_isr_detach(ESPBOT_D5_NUM);
+    gpio_isr_detach(ESPBOT_D6_NUM);
+}
+
+SIM_TEST(gpio_isr_detach_disables_pin)
+{
+    gpio_isr_attach(ESPBOT_D5_NUM, count_handler, NULL);
+    gpio_pin_intr_state_set(ESPBOT_D5_NUM, GPIO_PIN_INTR_ANYEDGE);
+    // a pending edge is dropped with the handler
+    ETS_GPIO_INTR_DISABLE();
+    sim_pin_drive(ESPBOT_D5_NUM, 0);
+    gpio_isr_detach(ESPBOT_D5_NUM);
+    ETS_GPIO_INTR_ENABLE();
+    sim_pin_drive(ESPBOT_D5_NUM, 1);
+    SIM_CHECK_EQ(handler_calls, 0);
+    SIM_CHECK_EQ(GPIO_REG_READ(GPIO_STATUS_ADDRESS) & BIT(ESPBOT_D5_NUM), 0);
+}
@@ -0,0 +1,266 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+#include "gpio.h"
+#include "esp8266_io.h"
+#include "esp8266_ccount.h"
+}
+
+#include "drivers_max6675.hpp"
+#include "sim_test.hpp"
+
+//
+// MAX6675 chip model
+//
+// chips share SCK (D5) and SO (D6), each one has its own CS:
+// CS low shifts out the frame MSB first, SO changes on SCK falling edges
+//
+
+#define CHIPS 2
+
+static struct
+{
+    int cs[CHIPS];         // gpio
+    uint16 frame[CHIPS];   // what the chip answers
+    int reads[CHIPS];      // CS falling edges
+    uint64 cs_low[CHIPS];  // last CS falling edge time
+    uint64 cs_len[CHIPS];  // last CS low time
+    uint64 min_spacing[CHIPS];
+    int selected;          // -1 => none
+    int bit;
+    int sck_edges;
+    uint32 sck_rise;
+    uint32 sck_fall;
+    uint32 min_high;       // CCOUNT ticks
+    uint32 min_low;
+} chip;
+
+static void chip_so(void)
+{
+    uint16 frame = chip.frame[chip.selected];
+    if (chip.bit < 16)
+        sim_pin_drive(ESPBOT_D6_NUM, (frame & (0x8000 >> chip.bit)) ? ESPBOT_HIGH : ESPBOT_LOW);
+}
+
+static void chip_model(int gpio, int level, void *param)
+{
+    uint32 now = get_ccount();
+    int idx;
+    for (idx = 0; idx < CHIPS; idx++)
+    {
+        if (gpio != chip.cs[idx])
+            continue;
+        if (level == ESPBOT_LOW)
+        {
+            if (chip.reads[idx] && ((sim_now() - chip.cs_low[idx]) < chip.min_spacing[idx]))
+                chip.min_spacing[idx] = sim_now() - chip.cs_low[idx];
+            chip.cs_low[idx] = sim_now();
+            chip.reads[idx]++;
+            chip.selected = idx;
+            chip.bit = 0;
+            chip_so();
+        }
+        else if (chip.selected == idx)
+        {
+            chip.cs_len[idx] = sim_now() - chip.cs_low[idx];
+            chip.selected = -1;
+        }
+        return;
+    }
+    if (gpio != ESPBOT_D5_NUM)
+        return;
+    chip.sck_edges++;
+    if (chip.selected < 0)
+        return;
+    if (level == ESPBOT_HIGH)
+    {
+        if (chip.bit && ((now - chip.sck_fall) < chip.min_low))
+            chip.min_low = now - chip.sck_fall;
+        chip.sck_rise = now;
+        return;
+    }
+    if ((now - chip.sck_rise) < chip.min_high)
+        chip.min_high = now - chip.sck_rise;
+    chip.sck_fall = now;
+    chip.bit++;
+    chip_so();
+}
+
+// temperature in quarters of degree, open thermocouple sets bit 2
+static void chip_init(int cs0, uint16 quarters0, int cs1, uint16 quarters1)
+{
+    int idx;
+    os_memset(&chip, 0, sizeof(chip));
+    chip.cs[0] = cs0;
+    chip.cs[1] = cs1;
+    chip.frame[0] = quarters0 << 3;
+    chip.frame[1] = quarters1 << 3;
+    for (idx = 0; idx < CHIPS; idx++)
+        chip.min_spacing[idx] = 0xFFFFFFFF;
+    chip.selected = -1;
+    chip.min_high = 0xFFFFFFFF;
+    chip.min_low = 0xFFFFFFFF;
+    sim_set_output_cb(chip_model, NULL);
+}
+
+static int readings_done;
+
+static void reading_done(void *param)
+{
+    readings_done++;
+}
+
+SIM_TEST(max6675_sw_timer_delete_while_reading)
+{
+    chip_init(ESPBOT_D1_NUM, 100, -1, 0);
+    Max6675 *sensor = new Max6675(ESPBOT_D1, ESPBOT_D5, ESPBOT_D6, 1, 0, 4, MAX6675_SW_TIMER);
+    sensor->force_reading(reading_done, NULL);
+    sim_run_for(50000);
+    SIM_CHECK(chip.sck_edges > 0);
+    delete sensor;
+    // the bit timer is gone with the sensor
+    chip.sck_edges = 0;
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(chip.sck_edges, 0);
+    SIM_CHECK_EQ(readings_done, 0);
+}
+
+static int temperature_quarters(Max6675 *sensor, bool *invalid)
+{
+    sensors_event_t event;
+    sensor->getEvent(&event);
+    *invalid = event.invalid;
+    return (int)(event.temperature * 4);
+}
+
+SIM_TEST(max6675_hspi_read)
+{
+    struct sim_hspi hspi;
+    bool invalid;
+    chip_init(ESPBOT_D1_NUM, 1000, -1, 0);
+    Max6675 *sensor = new Max6675(ESPBOT_D1, 1, 0, 4);
+    sensor->force_reading(reading_done, NULL);
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(temperature_quarters(sensor, &invalid), 1000);
+    SIM_CHECK(!invalid);
+    // registers setup
+    sim_get_hspi(&hspi);
+    SIM_CHECK_EQ(hspi.transfers, 1);
+    SIM_CHECK(hspi.pins_muxed);
+    SIM_CHECK(hspi.miso_only);
+    SIM_CHECK(hspi.cs_disabled);
+    SIM_CHECK(!hspi.lsb_first);
+    SIM_CHECK_EQ(hspi.bits, 16);
+    // the 2 MHz divider: 16 bits in 8 us while CS is low
+    SIM_CHECK_EQ(hspi.clock_hz, 2000000);
+    SIM_CHECK_EQ(chip.reads[0], 1);
+    SIM_CHECK_NEAR(chip.cs_len[0], 8, 1);
+    delete sensor;
+}
+
+SIM_TEST(max6675_hspi_shared_bus)
+{
+    bool invalid;
+    uint64 force_time;
+    int reads;
+    chip_init(ESPBOT_D1_NUM, 100, ESPBOT_D2_NUM, 200);
+    // polling faster than the conversion is raised to MAX6675_MIN_POLL_MS
+    Max6675 *fast = new Max6675(ESPBOT_D1, 1, 100, 16);
+    Max6675 *slow = new Max6675(ESPBOT_D2, 2, 1000, 16);
+    sim_run_for(3000000);
+    SIM_CHECK(chip.reads[0] >= 11);
+    SIM_CHECK(chip.reads[0] <= 12);
+    SIM_CHECK(chip.reads[1] >= 2);
+    SIM_CHECK(chip.reads[1] <= 3);
+    SIM_CHECK(chip.min_spacing[0] >= MAX6675_CONVERSION_MS * 1000);
+    SIM_CHECK(chip.min_spacing[1] >= MAX6675_CONVERSION_MS * 1000);
+    SIM_CHECK_EQ(temperature_quarters(fast, &invalid), 100);
+    SIM_CHECK_EQ(temperature_quarters(slow, &invalid), 200);
+    // a forced reading right after a bus one waits for the conversion end
+    reads = chip.reads[0];
+    while (chip.reads[0] == reads)
+        sim_run_for(1000);
+    reads = chip.reads[0];
+    force_time = sim_now();
+    fast->force_reading(reading_done, NULL);
+    SIM_CHECK_EQ(readings_done, 0);
+    sim_run_for(MAX6675_CONVERSION_MS * 1000);
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(chip.reads[0], reads + 1);
+    SIM_CHECK(chip.cs_low[0] >= (force_time + (MAX6675_CONVERSION_MS - 2) * 1000));
+    SIM_CHECK(chip.min_spacing[0] >= MAX6675_CONVERSION_MS * 1000);
+    delete slow;
+    delete fast;
+}
+
+SIM_TEST(max6675_fast_read)
+{
+    bool invalid;
+    uint32 half_clock = (SIM_CPU_FREQ * MAX6675_HALF_CLOCK_NS) / 1000;
+    chip_init(ESPBOT_D1_NUM, 0x0ABC, -1, 0);
+    Max6675 *sensor = new Max6675(ESPBOT_D1, ESPBOT_D5, ESPBOT_D6, 1, 0, 4, MAX6675_FAST);
+    chip.sck_edges = 0;
+    sensor->force_reading(reading_done, NULL);
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(temperature_quarters(sensor, &invalid), 0x0ABC);
+    SIM_CHECK(!invalid);
+    // SCK high and low times on CCOUNT
+    SIM_CHECK_EQ(chip.sck_edges, 32);
+    SIM_CHECK(chip.min_high >= half_clock);
+    SIM_CHECK(chip.min_low >= half_clock);
+    // 16 bits of 300 ns (plus the CCOUNT reads cost)
+    SIM_CHECK(chip.cs_len[0] <= 10);
+    delete sensor;
+}
+
+SIM_TEST(max6675_sw_timer_read)
+{
+    bool invalid;
+    chip_init(ESPBOT_D1_NUM, 0x0555, -1, 0);
+    Max6675 *sensor = new Max6675(ESPBOT_D1, ESPBOT_D5, ESPBOT_D6, 1, 0, 4, MAX6675_SW_TIMER);
+    chip.sck_edges = 0;
+    sensor->force_reading(reading_done, NULL);
+    SIM_CHECK(sim_run_until_idle(1000000));
+    SIM_CHECK_EQ(readings_done, 1);
+    SIM_CHECK_EQ(temperature_quarters(sensor, &invalid), 0x0555);
+    SIM_CHECK(!invalid);
+    // 32 SCK edges 5 ms apart, CS goes high at the next timer run
+    SIM_CHECK_EQ(chip.sck_edges, 32);
+    SIM_CHECK_NEAR(chip.cs_len[0], 33 * 5000, 1000);
+    delete sensor;
+}
+
+SIM_TEST(max6675_open_thermocouple)
+{
+    struct sensor_stats stats;
+    bool invalid;
+    chip_init(ESPBOT_D1_NUM, 400, ESPBOT_D2_NUM, 400);
+    // bit 2 set => thermocouple input open
+    chip.frame[0] |= 0x0004;
+    chip.frame[1] |= 0x0004;
+    Max6675 *hspi_sensor = new Max6675(ESPBOT_D1, 1, 0, 4);
+    hspi_sensor->force_reading(reading_done, NULL);
+    SIM_CHECK_EQ(readings_done, 1);
+    temperature_quarters(hspi_sensor, &invalid);
+    SIM_CHECK(invalid);
+    hspi_sensor->getStats(&stats);
+    SIM_CHECK_EQ(stats.count, 0);
+    SIM_CHECK_EQ(stats.invalid, 1);
+    delete hspi_sensor;
+    Max6675 *fast_sensor = new Max6675(ESPBOT_D2, ESPBOT_D5, ESPBOT_D6, 2, 0, 4, MAX6675_FAST);
+    fast_sensor->force_reading(reading_done, NULL);
+    SIM_CHECK_EQ(readings_done, 2);
+    temperature_quarters(fast_sensor, &invalid);
+    SIM_CHECK(invalid);
+    delete fast_sensor;
+}
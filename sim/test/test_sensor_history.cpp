@@ -0,0 +1,151 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+#include "drivers_dht.hpp"
+#include "drivers_sensor_history.hpp"
+#include "sim_test.hpp"
+
+//
+// SensorHistory timestamps rebuilt from deltas and anchors
+// against the pushed timestamps
+//
+
+#define HISTORY_PUSHES 400
+
+static uint32 pushed_ts[HISTORY_PUSHES];
+
+// push count samples (value = push order) with timestamps from next_ts
+static void history_fill(SensorHistory<uint16_t> *history, int count, uint32 (*next_ts)(int, uint32))
+{
+    uint32 timestamp = 1600000000;
+    int idx;
+    for (idx = 0; idx < count; idx++)
+    {
+        timestamp = next_ts(idx, timestamp);
+        pushed_ts[idx] = timestamp;
+        history->push((uint16_t)idx, timestamp);
+    }
+}
+
+// every stored sample, through get and through older
+static bool history_check(SensorHistory<uint16_t> *history, int pushed)
+{
+    uint32 timestamp;
+    uint32 walk_timestamp;
+    uint16_t *value;
+    int idx;
+    for (idx = 0; idx < history->count(); idx++)
+    {
+        value = history->get(idx, &timestamp);
+        if ((value == NULL) || (*value != (pushed - 1 - idx)) || (timestamp != pushed_ts[pushed - 1 - idx]))
+            return false;
+        if (idx == 0)
+            value = history->get(0, &walk_timestamp);
+        else
+            value = history->older(idx, &walk_timestamp);
+        if ((value == NULL) || (walk_timestamp != timestamp))
+            return false;
+    }
+    return true;
+}
+
+static uint32 every_10s(int idx, uint32 prev) { return prev + 10; }
+
+// polls every 10-12 s and sometimes a gap or a clock change
+static uint32 mixed_gaps(int idx, uint32 prev)
+{
+    static const int32 gaps[] = {300, 0, 100000, -50, 254, 255, 3600};
+    if (idx % 20)
+        return prev + 10 + (idx % 3);
+    return prev + gaps[(idx / 20) % (sizeof(gaps) / sizeof(gaps[0]))];
+}
+
+static uint32 hourly(int idx, uint32 prev) { return prev + 3600 - 30 + (idx % 7) * 10; }
+
+static uint32 every_1000s(int idx, uint32 prev) { return prev + 1000; }
+
+SIM_TEST(sensor_history_short_deltas)
+{
+    SensorHistory<uint16_t> history;
+    uint32 timestamp = 1;
+    SIM_CHECK(history.init(64));
+    SIM_CHECK(history.get(0, &timestamp) == NULL);
+    SIM_CHECK_EQ(timestamp, 0);
+    history_fill(&history, 100, every_10s);
+    SIM_CHECK_EQ(history.count(), 64);
+    SIM_CHECK(history_check(&history, 100));
+    timestamp = 1;
+    SIM_CHECK(history.get(64, &timestamp) == NULL);
+    SIM_CHECK_EQ(timestamp, 0);
+    SIM_CHECK_EQ(history.record_size(), 3);
+}
+
+SIM_TEST(sensor_history_escapes)
+{
+    SensorHistory<uint16_t> history;
+    SIM_CHECK(history.init(200));
+    history_fill(&history, 150, mixed_gaps);
+    SIM_CHECK_EQ(history.count(), 150);
+    SIM_CHECK(history_check(&history, 150));
+    history_fill(&history, HISTORY_PUSHES, mixed_gaps);
+    SIM_CHECK(history_check(&history, HISTORY_PUSHES));
+}
+
+SIM_TEST(sensor_history_same_timestamp)
+{
+    SensorHistory<uint16_t> history;
+    uint32 timestamp;
+    int idx;
+    // samples in the same second still move the sequence
+    SIM_CHECK(history.init(16));
+    SIM_CHECK_EQ(history.pushed(), 0);
+    for (idx = 0; idx < 3; idx++)
+        history.push((uint16_t)idx, 1600000000);
+    SIM_CHECK_EQ(history.pushed(), 3);
+    SIM_CHECK_EQ(*history.get(2, &timestamp), 0);
+    SIM_CHECK_EQ(timestamp, 1600000000);
+}
+
+SIM_TEST(sensor_history_long_period)
+{
+    SensorHistory<uint16_t> history;
+    // deltas around the period fit the byte, no escape drops samples
+    SIM_CHECK(history.init(128, 3600));
+    history_fill(&history, HISTORY_PUSHES, hourly);
+    SIM_CHECK_EQ(history.count(), 128);
+    SIM_CHECK(history_check(&history, HISTORY_PUSHES));
+}
+
+SIM_TEST(sensor_history_frequent_escapes)
+{
+    SensorHistory<uint16_t> history;
+    // every sample escapes: the anchors ring bounds the history
+    SIM_CHECK(history.init(64));
+    history_fill(&history, HISTORY_PUSHES, every_1000s);
+    SIM_CHECK(history.count() > 0);
+    SIM_CHECK(history.count() < 64);
+    SIM_CHECK(history_check(&history, HISTORY_PUSHES));
+}
+
+SIM_TEST(dht_sample_packing)
+{
+    struct dht_sample sample;
+    SIM_CHECK_EQ(sizeof(struct dht_sample), 3);
+    sample.temperature = -DHT_SAMPLE_TEMPERATURE_MAX;
+    sample.humidity = DHT_SAMPLE_HUMIDITY_MAX;
+    sample.invalid = 1;
+    SIM_CHECK_EQ(sample.temperature, -DHT_SAMPLE_TEMPERATURE_MAX);
+    SIM_CHECK_EQ(sample.humidity, DHT_SAMPLE_HUMIDITY_MAX);
+    SIM_CHECK_EQ(sample.invalid, 1);
+}
@@ -0,0 +1,97 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+}
+
+#include "espbot_spiffs.hpp"
+#include "drivers_sensor_log.hpp"
+#include "sim_test.hpp"
+
+//
+// SensorLog buffering and file names
+//
+
+static void log_append(SensorLog *log, int count)
+{
+    sensors_event_t event;
+    int idx;
+    os_memset(&event, 0, sizeof(event));
+    event.type = SENSOR_TYPE_TEMPERATURE;
+    for (idx = 0; idx < count; idx++)
+    {
+        event.timestamp = 1600000000 + idx;
+        event.temperature = 20.0f + idx;
+        log->append(&event);
+    }
+}
+
+SIM_TEST(sensor_log_max_age)
+{
+    struct sensor_log_record record;
+    SensorLog *log = new SensorLog("temp", 0.1f, 4096);
+    log_append(log, 3);
+    sim_run_for((SENSOR_LOG_MAX_AGE_MS - 1000) * 1000);
+    SIM_CHECK(!Espfile::exists("temp.0"));
+    SIM_CHECK_EQ(log->count(), 3);
+    // the buffer is not full, written anyway when the first record gets old
+    sim_run_for(2000 * 1000);
+    SIM_CHECK_EQ(Espfile::size("temp.0"), 3 * (int)sizeof(struct sensor_log_record));
+    SIM_CHECK_EQ(log->count(), 3);
+    SIM_CHECK_EQ(log->read(2, &record, 1), 1);
+    SIM_CHECK_EQ(record.value, 220);
+    delete log;
+}
+
+SIM_TEST(sensor_log_full_buffer)
+{
+    struct sensor_log_stats stats;
+    SensorLog *log = new SensorLog("temp", 0.1f, 4096);
+    log_append(log, LOG_PAGE_SIZE / sizeof(struct sensor_log_record));
+    sim_run_for(SENSOR_LOG_FLUSH_DELAY_MS * 1000 * 2);
+    SIM_CHECK_EQ(Espfile::size("temp.0"), LOG_PAGE_SIZE);
+    log->get_stats(&stats);
+    SIM_CHECK_EQ(stats.flushes, 1);
+    SIM_CHECK_EQ(stats.dropped, 0);
+    delete log;
+}
+
+SIM_TEST(sensor_log_previous_boot)
+{
+    struct sensor_log_record record;
+    int lookups;
+    SensorLog *log = new SensorLog("temp", 0.1f, 4096);
+    log_append(log, 3);
+    delete log;
+    // the files are checked once, at construction
+    log = new SensorLog("temp", 0.1f, 4096);
+    lookups = sim_spiffs_lookups();
+    SIM_CHECK_EQ(log->count(), 3);
+    log_append(log, 2);
+    SIM_CHECK_EQ(log->count(), 5);
+    SIM_CHECK_EQ(log->read(4, &record, 1), 1);
+    SIM_CHECK_EQ(sim_spiffs_lookups(), lookups);
+    SIM_CHECK_EQ(record.value, 210);
+    log->flush();
+    SIM_CHECK_EQ(Espfile::size("temp.0"), 5 * (int)sizeof(struct sensor_log_record));
+    delete log;
+}
+
+SIM_TEST(sensor_log_long_name)
+{
+    // SENSOR_LOG_NAME_LEN chars plus ".0" fit the SPIFFS name
+    SensorLog *log = new SensorLog("abcdefghijklmnopqrstuvwxyz012", 0.1f, 4096);
+    log_append(log, 1);
+    log->flush();
+    SIM_CHECK(Espfile::exists("abcdefghijklmnopqrstuvwxyz012.0"));
+    delete log;
+}
@@ -0,0 +1,48 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+}
+
+#include "drivers_sensor_registry.hpp"
+#include "sim_test.hpp"
+
+//
+// sensor polling scheduler
+//
+
+static uint64 dispatch_times[8];
+static int dispatch_count;
+
+static void poll_func(void *param)
+{
+    if (dispatch_count < 8)
+        dispatch_times[dispatch_count] = sim_now();
+    dispatch_count++;
+}
+
+// periods longer than the system_get_time wrap (71.6 minutes)
+SIM_TEST(sensor_poll_long_period)
+{
+    struct sensor_poll poll;
+    uint32 period_ms = 100 * 60 * 1000;
+    int idx;
+    sensor_poll_setfn(&poll, poll_func, NULL);
+    sensor_poll_start(&poll, period_ms);
+    // sim_run_for takes less than a wrap
+    for (idx = 0; idx < 16; idx++)
+        sim_run_for(20 * 60 * 1000000u);
+    SIM_CHECK_EQ(dispatch_count, 3);
+    for (idx = 0; idx < 3; idx++)
+        SIM_CHECK_NEAR(dispatch_times[idx], (uint64)period_ms * 1000 * (idx + 1), 1000000);
+    sensor_poll_stop(&poll);
+}
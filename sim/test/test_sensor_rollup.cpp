@@ -0,0 +1,114 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+#include "drivers_sensor_rollup.hpp"
+#include "sim_test.hpp"
+
+//
+// minute and hour buckets
+// (floats are checked in tenths, the sensor scale)
+//
+
+#define TENTHS(value) ((value) * 10)
+
+SIM_TEST(sensor_rollup_not_enabled)
+{
+    struct sensor_rollup_bucket bucket;
+    SensorRollup rollup;
+    SIM_CHECK(!rollup.allocated());
+    rollup.update(20.0f, 600);
+    SIM_CHECK_EQ(rollup.count(SENSOR_ROLLUP_MINUTES), 0);
+    SIM_CHECK_EQ(rollup.count(SENSOR_ROLLUP_HOURS), 0);
+    SIM_CHECK(!rollup.get(SENSOR_ROLLUP_MINUTES, 0, &bucket));
+    SIM_CHECK_EQ(rollup.get_buckets(SENSOR_ROLLUP_HOURS, &bucket, 1, 0), 0);
+}
+
+SIM_TEST(sensor_rollup_buckets)
+{
+    struct sensor_rollup_bucket bucket;
+    SensorRollup rollup;
+    SIM_CHECK(rollup.init(0.1f, 10, 4));
+    SIM_CHECK_EQ(rollup.size(SENSOR_ROLLUP_MINUTES), 11);
+    rollup.update(20.0f, 600);
+    rollup.update(21.0f, 610);
+    rollup.update(22.5f, 650);
+    rollup.update(19.0f, 700);
+    SIM_CHECK_EQ(rollup.count(SENSOR_ROLLUP_MINUTES), 2);
+    // the open bucket
+    SIM_CHECK(rollup.get(SENSOR_ROLLUP_MINUTES, 0, &bucket));
+    SIM_CHECK_EQ(bucket.timestamp, 660);
+    SIM_CHECK_EQ(bucket.count, 1);
+    SIM_CHECK_NEAR(TENTHS(bucket.avg), 190, 1);
+    // the stored one, in sensor scale units
+    SIM_CHECK(rollup.get(SENSOR_ROLLUP_MINUTES, 1, &bucket));
+    SIM_CHECK_EQ(bucket.timestamp, 600);
+    SIM_CHECK_EQ(bucket.count, 3);
+    SIM_CHECK_NEAR(TENTHS(bucket.min), 200, 1);
+    SIM_CHECK_NEAR(TENTHS(bucket.max), 225, 1);
+    SIM_CHECK_NEAR(TENTHS(bucket.avg), 212, 1);
+    SIM_CHECK(!rollup.get(SENSOR_ROLLUP_MINUTES, 2, &bucket));
+    // the hour accumulates the same samples
+    SIM_CHECK_EQ(rollup.count(SENSOR_ROLLUP_HOURS), 1);
+    SIM_CHECK(rollup.get(SENSOR_ROLLUP_HOURS, 0, &bucket));
+    SIM_CHECK_EQ(bucket.timestamp, 0);
+    SIM_CHECK_EQ(bucket.count, 4);
+    SIM_CHECK_NEAR(TENTHS(bucket.min), 190, 1);
+    SIM_CHECK_NEAR(TENTHS(bucket.max), 225, 1);
+}
+
+SIM_TEST(sensor_rollup_gaps_and_wrap)
+{
+    struct sensor_rollup_bucket buckets[16];
+    SensorRollup rollup;
+    uint32 timestamp;
+    int idx;
+    SIM_CHECK(rollup.init(0.1f, 10, 4));
+    rollup.update(20.0f, 600);
+    rollup.update(21.0f, 660);
+    // three minutes without samples are stored empty
+    rollup.update(22.0f, 900);
+    SIM_CHECK_EQ(rollup.get_buckets(SENSOR_ROLLUP_MINUTES, buckets, 16, 0), 6);
+    for (idx = 0; idx < 6; idx++)
+        SIM_CHECK_EQ(buckets[idx].timestamp, 900 - idx * 60);
+    SIM_CHECK_EQ(buckets[1].count, 0);
+    SIM_CHECK_EQ(buckets[3].count, 0);
+    SIM_CHECK_EQ(buckets[4].count, 1);
+    SIM_CHECK_NEAR(TENTHS(buckets[4].avg), 210, 1);
+    // the minutes ring wraps, the hours go on
+    for (timestamp = 960; timestamp < 7200 + 600; timestamp += 60)
+        rollup.update(25.0f, timestamp);
+    SIM_CHECK_EQ(rollup.count(SENSOR_ROLLUP_MINUTES), 11);
+    SIM_CHECK_EQ(rollup.get_buckets(SENSOR_ROLLUP_MINUTES, buckets, 16, 8), 3);
+    SIM_CHECK_EQ(buckets[2].timestamp, 7200 + 540 - 10 * 60);
+    SIM_CHECK_EQ(rollup.count(SENSOR_ROLLUP_HOURS), 3);
+    SIM_CHECK_EQ(rollup.get_buckets(SENSOR_ROLLUP_HOURS, buckets, 16, 0), 3);
+    SIM_CHECK_EQ(buckets[0].timestamp, 7200);
+    SIM_CHECK_EQ(buckets[1].count, 60);
+    SIM_CHECK_NEAR(TENTHS(buckets[2].min), 200, 1);
+    SIM_CHECK_NEAR(TENTHS(buckets[2].max), 250, 1);
+}
+
+SIM_TEST(sensor_rollup_saturation)
+{
+    struct sensor_rollup_bucket bucket;
+    SensorRollup rollup;
+    SIM_CHECK(rollup.init(0.1f, 2, 2));
+    rollup.update(5000.0f, 60);
+    rollup.update(-5000.0f, 120);
+    rollup.update(0.0f, 180);
+    SIM_CHECK(rollup.get(SENSOR_ROLLUP_MINUTES, 2, &bucket));
+    SIM_CHECK_NEAR(TENTHS(bucket.max), 32767, 1);
+    SIM_CHECK(rollup.get(SENSOR_ROLLUP_MINUTES, 1, &bucket));
+    SIM_CHECK_NEAR(TENTHS(bucket.min), -32768, 1);
+}
@@ -0,0 +1,90 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+#include "drivers_sensor_stats.hpp"
+#include "sim_test.hpp"
+
+//
+// streaming sensor statistics
+// (floats are checked in thousandths)
+//
+
+#define MILLI(value) ((value) * 1000)
+
+SIM_TEST(sensor_stats_welford)
+{
+    static const float values[] = {2, 4, 4, 4, 5, 5, 7, 9};
+    struct sensor_stats stats;
+    SensorStats sensor_stats;
+    int idx;
+    sensor_stats.update_invalid(1000);
+    for (idx = 0; idx < 8; idx++)
+        sensor_stats.update(values[idx], 1001 + idx);
+    sensor_stats.get(&stats);
+    SIM_CHECK_EQ(stats.count, 8);
+    SIM_CHECK_EQ(stats.invalid, 1);
+    SIM_CHECK_EQ(stats.since, 1000);
+    SIM_CHECK_EQ(MILLI(stats.last), 9000);
+    SIM_CHECK_EQ(MILLI(stats.min), 2000);
+    SIM_CHECK_EQ(stats.min_timestamp, 1001);
+    SIM_CHECK_EQ(MILLI(stats.max), 9000);
+    SIM_CHECK_EQ(stats.max_timestamp, 1008);
+    SIM_CHECK_NEAR(MILLI(stats.mean), 5000, 1);
+    // sample variance 32 / 7
+    SIM_CHECK_NEAR(MILLI(stats.stddev), 2138, 1);
+    // a large offset doesn't eat the variance
+    sensor_stats.reset();
+    for (idx = 0; idx < 8; idx++)
+        sensor_stats.update(10000 + values[idx], idx);
+    sensor_stats.get(&stats);
+    SIM_CHECK_NEAR(MILLI(stats.stddev), 2138, 5);
+    SIM_CHECK_EQ(stats.invalid, 0);
+}
+
+SIM_TEST(sensor_stats_ewma_and_window)
+{
+    struct sensor_stats stats;
+    SensorStats sensor_stats;
+    sensor_stats.get(&stats);
+    SIM_CHECK_EQ(stats.window, SENSOR_STATS_WINDOW);
+    // alpha = 0.5
+    sensor_stats.set_window(3);
+    sensor_stats.update(10, 1);
+    sensor_stats.update(20, 2);
+    sensor_stats.get(&stats);
+    SIM_CHECK_NEAR(MILLI(stats.ewma), 15000, 1);
+    SIM_CHECK_NEAR(MILLI(stats.ewm_stddev), 5000, 1);
+    sensor_stats.update(20, 3);
+    sensor_stats.get(&stats);
+    SIM_CHECK_EQ(stats.window, 3);
+    SIM_CHECK_NEAR(MILLI(stats.ewma), 17500, 1);
+    // variance 18.75
+    SIM_CHECK_NEAR(MILLI(stats.ewm_stddev), 4330, 1);
+    // a new window restarts the EWMA from the last sample
+    sensor_stats.set_window(1);
+    sensor_stats.get(&stats);
+    SIM_CHECK_NEAR(MILLI(stats.ewma), 20000, 1);
+    SIM_CHECK_EQ(MILLI(stats.ewm_stddev), 0);
+    sensor_stats.update(30, 4);
+    sensor_stats.get(&stats);
+    SIM_CHECK_NEAR(MILLI(stats.ewma), 30000, 1);
+    SIM_CHECK_EQ(MILLI(stats.ewm_stddev), 0);
+    // the Welford ones go on
+    SIM_CHECK_EQ(stats.count, 4);
+    SIM_CHECK_NEAR(MILLI(stats.mean), 20000, 1);
+    // the window is at least one sample
+    sensor_stats.set_window(0);
+    sensor_stats.get(&stats);
+    SIM_CHECK_EQ(stats.window, 1);
+}
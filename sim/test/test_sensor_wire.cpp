@@ -0,0 +1,201 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+}
+
+#include "drivers_sensor_wire.hpp"
+#include "sim_test.hpp"
+
+//
+// binary sensor events encoding, byte by byte
+//
+
+static uint32 get32(const char *buf)
+{
+    return ((uint32)(uint8)buf[0]) |
+           ((uint32)(uint8)buf[1] << 8) |
+           ((uint32)(uint8)buf[2] << 16) |
+           ((uint32)(uint8)buf[3] << 24);
+}
+
+SIM_TEST(sensor_wire_header)
+{
+    char buf[SENSOR_WIRE_HEADER_LEN + 1];
+    sensor_t sensor;
+    os_memset(&sensor, 0, sizeof(sensor));
+    // a 12 chars name has no terminator
+    os_memcpy(sensor.name, "ABCDEFGHIJKL", 12);
+    sensor.sensor_id = -2;
+    sensor.type = SENSOR_TYPE_TEMPERATURE;
+    sensor.max_value = 1024.0f;
+    sensor.min_value = -40.0f;
+    sensor.resolution = 0.25f;
+    sensor.min_delay = 85000;
+    buf[SENSOR_WIRE_HEADER_LEN] = 0x55;
+    sensor_wire_header(buf, &sensor, 0x01020304);
+    SIM_CHECK(os_memcmp(buf, "SEVT", 4) == 0);
+    SIM_CHECK_EQ(buf[4], SENSOR_WIRE_VERSION);
+    SIM_CHECK_EQ(buf[5], SENSOR_TYPE_TEMPERATURE);
+    SIM_CHECK_EQ(buf[6], SENSOR_WIRE_EVENT_LEN);
+    SIM_CHECK_EQ(buf[7], 0);
+    SIM_CHECK_EQ(get32(buf + 8), 0xFFFFFFFE);
+    SIM_CHECK(os_memcmp(buf + 12, "ABCDEFGHIJKL", 12) == 0);
+    // IEEE 754 single precision, little endian
+    SIM_CHECK_EQ(get32(buf + 24), 0x44800000);
+    SIM_CHECK_EQ(get32(buf + 28), 0xC2200000);
+    SIM_CHECK_EQ(get32(buf + 32), 0x3E800000);
+    SIM_CHECK_EQ(get32(buf + 36), 85000);
+    SIM_CHECK_EQ((uint8)buf[40], 0x04);
+    SIM_CHECK_EQ((uint8)buf[43], 0x01);
+    SIM_CHECK_EQ(buf[SENSOR_WIRE_HEADER_LEN], 0x55);
+    // shorter names are zero padded
+    os_memset(sensor.name, 0, sizeof(sensor.name));
+    os_strncpy(sensor.name, "DHT22", 12);
+    sensor_wire_header(buf, &sensor, 0);
+    SIM_CHECK(os_memcmp(buf + 12, "DHT22\0\0\0\0\0\0\0", 12) == 0);
+    SIM_CHECK_EQ(get32(buf + 40), 0);
+}
+
+SIM_TEST(sensor_wire_events)
+{
+    char buf[SENSOR_WIRE_EVENT_LEN + 1];
+    sensors_event_t event;
+    os_memset(&event, 0, sizeof(event));
+    event.timestamp = 1600000000;
+    event.temperature = 23.5f;
+    buf[SENSOR_WIRE_EVENT_LEN] = 0x55;
+    sensor_wire_event(buf, &event);
+    SIM_CHECK_EQ(get32(buf), 1600000000);
+    SIM_CHECK_EQ(get32(buf + 4), 0x41BC0000);
+    event.temperature = -0.5f;
+    sensor_wire_event(buf, &event);
+    SIM_CHECK_EQ(get32(buf + 4), 0xBF000000);
+    // invalid events carry a quiet NaN whatever the value
+    event.invalid = true;
+    sensor_wire_event(buf, &event);
+    SIM_CHECK_EQ(get32(buf + 4), SENSOR_WIRE_INVALID);
+    SIM_CHECK_EQ(buf[SENSOR_WIRE_EVENT_LEN], 0x55);
+}
+
+//
+// chunked export against a sensor storing samples meanwhile
+//
+
+#define RING_EVENTS 20
+
+class Ring_sensor : public Esp8266_Sensor
+{
+  public:
+    Ring_sensor() : pushed(0) {}
+    void getSensor(sensor_t *sensor) { os_memset(sensor, 0, sizeof(sensor_t)); }
+    int get_max_events_count(void) { return RING_EVENTS; }
+    // sample n has timestamp n
+    void getEvent(sensors_event_t *event, int idx)
+    {
+        os_memset(event, 0, sizeof(sensors_event_t));
+        if ((idx < 0) || (idx >= RING_EVENTS) || ((uint32)idx >= pushed))
+            return;
+        event->timestamp = pushed - idx;
+        event->temperature = 0.5f * (pushed - idx);
+    }
+    void force_reading(void (*callback)(void *), void *param) {}
+    uint32 getSequence(void) { return pushed; }
+    void push(int count) { pushed += count; }
+    uint32 pushed;
+};
+
+// the app export loop (app_http_routes.cpp) with chunk_len bytes chunks,
+// push samples stored between two chunks
+// returns the bytes sent
+static int export_chunks(Ring_sensor *sensor, char *content, int chunk_len, int push)
+{
+    sensors_event_t events[8];
+    sensor_t info;
+    uint32 sequence = sensor->getSequence();
+    int count = RING_EVENTS;
+    int sent = 0;
+    int total = 0;
+    int len;
+    int batch;
+    int idx;
+    sensor->getSensor(&info);
+    sensor_wire_header(content, &info, count);
+    len = SENSOR_WIRE_HEADER_LEN;
+    while (true)
+    {
+        while ((sent < count) && ((len + SENSOR_WIRE_EVENT_LEN) <= chunk_len))
+        {
+            batch = (chunk_len - len) / SENSOR_WIRE_EVENT_LEN;
+            if (batch > 8)
+                batch = 8;
+            if (batch > (count - sent))
+                batch = count - sent;
+            sensor_wire_export_events(sensor, sequence, events, batch, sent);
+            for (idx = 0; idx < batch; idx++)
+            {
+                sensor_wire_event((content + total + len), &events[idx]);
+                len += SENSOR_WIRE_EVENT_LEN;
+                sent++;
+            }
+        }
+        total += len;
+        len = 0;
+        if (sent >= count)
+            return total;
+        sensor->push(push);
+    }
+}
+
+SIM_TEST(sensor_wire_export_overwritten)
+{
+    char content[SENSOR_WIRE_HEADER_LEN + RING_EVENTS * SENSOR_WIRE_EVENT_LEN];
+    Ring_sensor sensor;
+    uint32 first = 100;
+    const char *event;
+    int idx;
+    sensor.push(first);
+    // 2 events in the first chunk then 8 per chunk, 5 samples stored between chunks
+    SIM_CHECK_EQ(export_chunks(&sensor, content, 64, 5), sensor_wire_content_len(RING_EVENTS));
+    SIM_CHECK_EQ(get32(content + 40), RING_EVENTS);
+    for (idx = 0; idx < RING_EVENTS; idx++)
+    {
+        event = content + SENSOR_WIRE_HEADER_LEN + idx * SENSOR_WIRE_EVENT_LEN;
+        // the samples at the export start, the overwritten ones as invalid
+        if (get32(event + 4) == SENSOR_WIRE_INVALID)
+        {
+            SIM_CHECK_EQ(get32(event), 0);
+            SIM_CHECK(idx >= 2);
+        }
+        else
+        {
+            SIM_CHECK_EQ(get32(event), first - idx);
+            SIM_CHECK_EQ(get32(event + 4), sensor_wire_float(0.5f * (first - idx)));
+        }
+    }
+    // the second chunk is read 5 samples later, the third one 10 samples later
+    SIM_CHECK_EQ(get32(content + SENSOR_WIRE_HEADER_LEN + 9 * SENSOR_WIRE_EVENT_LEN), first - 9);
+    SIM_CHECK_EQ(get32(content + SENSOR_WIRE_HEADER_LEN + 10 * SENSOR_WIRE_EVENT_LEN + 4), SENSOR_WIRE_INVALID);
+}
+
+SIM_TEST(sensor_wire_export_deleted)
+{
+    sensors_event_t events[4];
+    int idx;
+    // sensor deleted during the export: still count events
+    sensor_wire_export_events(NULL, 0, events, 4, 0);
+    for (idx = 0; idx < 4; idx++)
+    {
+        SIM_CHECK(events[idx].invalid);
+        SIM_CHECK_EQ(events[idx].timestamp, 0);
+    }
+}
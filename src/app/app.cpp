@@ -40,15 +40,23 @@ char *app_release = APP_RELEASE;
 
 Dht *dht22;
 Max6675 *max6675;
+SensorLog *dht22_temperature_log;
 
 void app_init_before_wifi(void)
 {
     init_dio_task();
     // dht22 = new Dht(ESPBOT_D2, DHT22, 2000, 3000, 60000, 10);
     // max6675 = new Max6675(ESPBOT_D5, ESPBOT_D6, ESPBOT_D7, 1000, 30000, 10);
+    // HSPI (SCK D5, SO D6, CS D7)
+    // max6675 = new Max6675(ESPBOT_D7, 1000, 30000, 10);
     // following is for no polling
     dht22 = new Dht(ESPBOT_D2, DHT22, 2000, 3000, 0, 10);
     max6675 = new Max6675(ESPBOT_D5, ESPBOT_D6, ESPBOT_D7, 1000, 0, 10);
+    // minute and hour trends (last hour and last two days, 864 bytes)
+    dht22->temperature.enableRollup(60, 48);
+    // temperature samples log on SPIFFS (two 4 kB files, 512 to 1024 samples)
+    dht22_temperature_log = new SensorLog("dht22_t", 0.1, 4096);
+    dht22_temperature_log->attach(&dht22->temperature);
 }
 
 void app_init_after_wifi(void)
@@ -27,6 +27,8 @@ extern "C"
 #include "espbot_utils.hpp"
 #include "espbot_http_server.hpp"
 #include "drivers.hpp"
+#include "drivers_sensor_registry.hpp"
+#include "drivers_sensor_wire.hpp"
 
 static void get_api_info(struct espconn *ptr_espconn, Http_parsed_req *parsed_req)
 {
@@ -69,6 +71,264 @@ static void runTest(struct espconn *ptr_espconn, Http_parsed_req *parsed_req)
     run_test(test_number, test_param);
 }
 
+//
+// sensor events export
+//
+// GET /api/sensors/<id>/events
+// {"sensor_id":2000,"name":"DHT22","type":1,"events":[
+//   {"timestamp":1600000000,"value":   23.40,"invalid":0},... (latest first)
+// ]}
+//
+// GET /api/sensors/<id>/events.bin
+// the same events in the compact binary format (see drivers_sensor_wire.hpp):
+// sensor_t header then 8 bytes per event
+// (the espbot request parser does not keep the Accept header, so the format
+// is selected by the url)
+//
+// the history is formatted into SENSOR_EXPORT_CHUNK bytes chunks, a chunk is
+// formatted when the previous one was sent (pending_split_send) so heap usage
+// does not depend on the history length
+// events have fixed length (space padded fields) so that the content length
+// is known before formatting them
+//
+
+#define SENSOR_EXPORT_CHUNK 512
+#define SENSOR_EXPORT_EVENTS 8       // events read from the sensor at a time
+#define SENSOR_EXPORT_EVENT_LEN 53   // comma excluded
+#define SENSOR_EXPORT_PREFIX_LEN 80  // JSON prefix or binary header
+#define HTTP_CONTENT_BINARY "application/octet-stream"
+
+struct sensor_export
+{
+    int sensor_id;
+    uint32 sequence;         // sensor getSequence() when the export started
+    int count;               // events to be sent
+    bool binary;
+    int prefix_len;
+    char prefix[SENSOR_EXPORT_PREFIX_LEN];
+};
+
+// /api/sensors/<id>/events     => id, binary = false
+// /api/sensors/<id>/events.bin => id, binary = true
+// -1 when the url does not match
+static int sensor_events_url(char *url, bool *binary)
+{
+    char *suffix;
+    int id;
+    if (os_strncmp(url, f_str("/api/sensors/"), 13))
+        return -1;
+    suffix = (char *)os_strstr(url + 13, f_str("/"));
+    if ((suffix == NULL) || (suffix == (url + 13)))
+        return -1;
+    if (0 == os_strcmp(suffix, f_str("/events")))
+        *binary = false;
+    else if (0 == os_strcmp(suffix, f_str("/events.bin")))
+        *binary = true;
+    else
+        return -1;
+    id = atoi(url + 13);
+    return id;
+}
+
+// stored events count
+static int sensor_export_count(Esp8266_Sensor *sensor)
+{
+    sensors_event_t events[SENSOR_EXPORT_EVENTS];
+    int offset = 0;
+    int count;
+    int idx;
+    while (true)
+    {
+        count = sensor->getEvents(events, SENSOR_EXPORT_EVENTS, offset);
+        for (idx = 0; idx < count; idx++)
+        {
+            // not stored yet
+            if (events[idx].timestamp == 0)
+                return (offset + idx);
+        }
+        if (count < SENSOR_EXPORT_EVENTS)
+            return (offset + count);
+        offset += count;
+    }
+}
+
+static void sensor_export_event(char *str, sensors_event_t *event)
+{
+    char value_str[16];
+    float value = event->temperature;
+    // keep the fixed length
+    if (value > 99999.99)
+        value = 99999.99;
+    if (value < -9999.99)
+        value = -9999.99;
+    f2str(value_str, value, 2);
+    fs_sprintf(str,
+               "{\"timestamp\":%10u,\"value\":%8s,\"invalid\":%d}",
+               event->timestamp,
+               value_str,
+               (event->invalid ? 1 : 0));
+}
+
+static void sensor_export_chunk(struct http_split_send *p_sr)
+{
+    ALL("sensor_export_chunk");
+    struct sensor_export *export_ptr = (struct sensor_export *)p_sr->content;
+    Esp8266_Sensor *sensor = get_sensor_by_id(export_ptr->sensor_id);
+    sensors_event_t events[SENSOR_EXPORT_EVENTS];
+    int sent = p_sr->content_transferred;
+    // JSON events are followed by a comma (but the last one) and by the closing "]}"
+    int event_len = export_ptr->binary ? SENSOR_WIRE_EVENT_LEN : (SENSOR_EXPORT_EVENT_LEN + 1);
+    int suffix_len = export_ptr->binary ? 0 : 2;
+    int len = 0;
+    int count;
+    int idx;
+    char *buffer = new char[SENSOR_EXPORT_CHUNK + 1];
+    if (buffer == NULL)
+    {
+        dia_error_evnt(APP_SENSOR_EXPORT_HEAP_EXHAUSTED, SENSOR_EXPORT_CHUNK);
+        ERROR("sensor_export_chunk heap exhausted %d", SENSOR_EXPORT_CHUNK);
+        delete[] p_sr->content;
+        return;
+    }
+    if (sent == 0)
+    {
+        os_memcpy(buffer, export_ptr->prefix, export_ptr->prefix_len);
+        len = export_ptr->prefix_len;
+    }
+    while ((sent < export_ptr->count) && ((len + event_len + suffix_len) <= SENSOR_EXPORT_CHUNK))
+    {
+        count = (SENSOR_EXPORT_CHUNK - len - suffix_len) / event_len;
+        if (count > SENSOR_EXPORT_EVENTS)
+            count = SENSOR_EXPORT_EVENTS;
+        if (count > (export_ptr->count - sent))
+            count = export_ptr->count - sent;
+        // events overwritten meanwhile (or sensor deleted) are sent as invalid
+        sensor_wire_export_events(sensor, export_ptr->sequence, events, count, sent);
+        for (idx = 0; idx < count; idx++)
+        {
+            if (export_ptr->binary)
+            {
+                sensor_wire_event((buffer + len), &events[idx]);
+                len += SENSOR_WIRE_EVENT_LEN;
+            }
+            else
+            {
+                if (sent > 0)
+                    buffer[len++] = ',';
+                sensor_export_event((buffer + len), &events[idx]);
+                len += SENSOR_EXPORT_EVENT_LEN;
+            }
+            sent++;
+        }
+    }
+    if (sent >= export_ptr->count)
+    {
+        if (!export_ptr->binary)
+        {
+            os_strcpy((buffer + len), f_str("]}"));
+            len += 2;
+        }
+        delete[] p_sr->content;
+    }
+    else
+    {
+        struct http_split_send *p_pending_response = new struct http_split_send;
+        if (p_pending_response == NULL)
+        {
+            dia_error_evnt(APP_SENSOR_EXPORT_HEAP_EXHAUSTED, sizeof(struct http_split_send));
+            ERROR("sensor_export_chunk heap exhausted %d", (int)sizeof(struct http_split_send));
+            delete[] p_sr->content;
+        }
+        else
+        {
+            p_pending_response->p_espconn = p_sr->p_espconn;
+            p_pending_response->order = p_sr->order + 1;
+            p_pending_response->content = p_sr->content;
+            p_pending_response->content_size = p_sr->content_size;
+            p_pending_response->content_transferred = sent;
+            p_pending_response->action_function = sensor_export_chunk;
+            if (pending_split_send->push(p_pending_response) != Queue_ok)
+            {
+                dia_error_evnt(APP_SENSOR_EXPORT_QUEUE_FULL, 0);
+                ERROR("sensor_export_chunk pending send queue full");
+                delete p_pending_response;
+                delete[] p_sr->content;
+            }
+        }
+    }
+    http_send_buffer(p_sr->p_espconn, p_sr->order, buffer, len);
+}
+
+static void get_sensor_events(struct espconn *ptr_espconn, int sensor_id, bool binary)
+{
+    ALL("get_sensor_events");
+    Esp8266_Sensor *sensor = get_sensor_by_id(sensor_id);
+    struct sensor_export *export_ptr;
+    sensor_t sensor_info;
+    if (sensor == NULL)
+    {
+        http_response(ptr_espconn, HTTP_NOT_FOUND, HTTP_CONTENT_JSON, f_str("Sensor not found"), false);
+        return;
+    }
+    // allocated as char[] like any other pending_split_send content
+    export_ptr = (struct sensor_export *)new char[sizeof(struct sensor_export)];
+    if (export_ptr == NULL)
+    {
+        dia_error_evnt(APP_SENSOR_EXPORT_HEAP_EXHAUSTED, sizeof(struct sensor_export));
+        ERROR("get_sensor_events heap exhausted %d", (int)sizeof(struct sensor_export));
+        http_response(ptr_espconn, HTTP_SERVER_ERROR, HTTP_CONTENT_JSON, f_str("Heap exhausted"), false);
+        return;
+    }
+    sensor->getSensor(&sensor_info);
+    export_ptr->sensor_id = sensor_id;
+    export_ptr->sequence = sensor->getSequence();
+    export_ptr->count = sensor_export_count(sensor);
+    export_ptr->binary = binary;
+    // header
+    Http_header header;
+    header.m_code = HTTP_OK;
+    if (binary)
+    {
+        sensor_wire_header(export_ptr->prefix, &sensor_info, export_ptr->count);
+        export_ptr->prefix_len = SENSOR_WIRE_HEADER_LEN;
+        header.m_content_type = HTTP_CONTENT_BINARY;
+        header.m_content_length = sensor_wire_content_len(export_ptr->count);
+    }
+    else
+    {
+        fs_sprintf(export_ptr->prefix,
+                   "{\"sensor_id\":%d,\"name\":\"%s\",\"type\":%d,\"events\":[",
+                   sensor_info.sensor_id,
+                   sensor_info.name,
+                   sensor_info.type);
+        export_ptr->prefix_len = os_strlen(export_ptr->prefix);
+        header.m_content_type = HTTP_CONTENT_JSON;
+        header.m_content_length = export_ptr->prefix_len +
+                                  (export_ptr->count * (SENSOR_EXPORT_EVENT_LEN + 1)) -
+                                  ((export_ptr->count > 0) ? 1 : 0) +
+                                  2;
+    }
+    char *header_str = http_format_header(&header);
+    if (header_str == NULL)
+    {
+        dia_error_evnt(APP_SENSOR_EXPORT_HEAP_EXHAUSTED, 0);
+        ERROR("get_sensor_events heap exhausted");
+        delete[] (char *)export_ptr;
+        http_response(ptr_espconn, HTTP_SERVER_ERROR, HTTP_CONTENT_JSON, f_str("Heap exhausted"), false);
+        return;
+    }
+    http_send_buffer(ptr_espconn, 0, header_str, os_strlen(header_str));
+    // then the content, chunk by chunk
+    struct http_split_send first_chunk;
+    first_chunk.p_espconn = ptr_espconn;
+    first_chunk.order = 1;
+    first_chunk.content = (char *)export_ptr;
+    first_chunk.content_size = export_ptr->count;
+    first_chunk.content_transferred = 0;
+    first_chunk.action_function = sensor_export_chunk;
+    sensor_export_chunk(&first_chunk);
+}
+
 bool app_http_routes(struct espconn *ptr_espconn, Http_parsed_req *parsed_req)
 {
     if ((0 == os_strcmp(parsed_req->url, f_str("/api/info"))) && (parsed_req->req_method == HTTP_GET))
@@ -81,5 +341,12 @@ bool app_http_routes(struct espconn *ptr_espconn, Http_parsed_req *parsed_req)
         runTest(ptr_espconn, parsed_req);
         return true;
     }
+    bool binary;
+    int sensor_id = sensor_events_url(parsed_req->url, &binary);
+    if ((parsed_req->req_method == HTTP_GET) && (sensor_id >= 0))
+    {
+        get_sensor_events(ptr_espconn, sensor_id, binary);
+        return true;
+    }
     return false;
 }
\ No newline at end of file
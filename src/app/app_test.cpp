@@ -26,6 +26,8 @@ extern "C"
 #include "espbot_timedate.hpp"
 #include "espbot_utils.hpp"
 #include "drivers.hpp"
+#include "drivers_sensor_registry.hpp"
+#include "drivers_sensor_wire.hpp"
 
 // function for testing purpose
 
@@ -38,6 +40,13 @@ static void output_seq_completed(void *param)
     fs_printf("Test completed\n");
 }
 
+static void output_pseq_completed(void *param)
+{
+    struct do_pseq *seq = (struct do_pseq *)param;
+    free_do_pseq(seq);
+    fs_printf("Test completed\n");
+}
+
 static void input_seq_completed(void *param)
 {
     struct di_seq *seq = (struct di_seq *)param;
@@ -64,6 +73,38 @@ static void input_seq_completed(void *param)
     free_di_seq(seq);
 }
 
+static void input_batch_ready(void *param)
+{
+    struct di_seq *seq = (struct di_seq *)param;
+    int idx = 0;
+    char level;
+    uint32 duration;
+    fs_printf("Batch acquired (%d overruns):\n", seq->stream_overruns);
+    for (idx = 0; idx < get_di_seq_batch_length(seq); idx++)
+    {
+        level = get_di_seq_batch_pulse_level(seq, idx);
+        duration = get_di_seq_batch_pulse_duration(seq, idx);
+        if (level == ESPBOT_LOW)
+            fs_printf("pulse %d: level  'LOW' - duration %d\n", idx, duration);
+        else
+            fs_printf("pulse %d: level 'HIGH' - duration %d\n", idx, duration);
+    }
+    fs_printf("Batch end.\n");
+}
+
+static struct di_seq *input_stream;
+
+static void output_seq_completed_stop_stream(void *param)
+{
+    struct do_seq *seq = (struct do_seq *)param;
+    free_do_seq(seq);
+    // the pending pulses are printed before stop returns
+    stop_di_seq_stream(input_stream);
+    free_di_seq(input_stream);
+    input_stream = NULL;
+    fs_printf("Test completed\n");
+}
+
 uint32 start_time;
 uint32 end_time;
 static di_seq *dht_input;
@@ -95,6 +136,21 @@ static void print_event(sensors_event_t *event, int decimals)
     fs_printf("==>   timestamp: %s\n", timedate_get_timestr(event->timestamp));
 }
 
+static void print_stats(struct sensor_stats *stats, int decimals)
+{
+    Heap_chunk str(20);
+    fs_printf("          STATS\n");
+    fs_printf("==>      count: %d (invalid %d)\n", stats->count, stats->invalid);
+    fs_printf("==>      since: %s\n", timedate_get_timestr(stats->since));
+    fs_printf("==>       last: %s\n", f2str(str.ref, stats->last, decimals));
+    fs_printf("==>        min: %s\n", f2str(str.ref, stats->min, decimals));
+    fs_printf("==>        max: %s\n", f2str(str.ref, stats->max, decimals));
+    fs_printf("==>       mean: %s\n", f2str(str.ref, stats->mean, decimals));
+    fs_printf("==>     stddev: %s\n", f2str(str.ref, stats->stddev, decimals));
+    fs_printf("==>       ewma: %s (window %d)\n", f2str(str.ref, stats->ewma, decimals), stats->window);
+    fs_printf("==> ewm stddev: %s\n", f2str(str.ref, stats->ewm_stddev, decimals));
+}
+
 static void get_and_print_max6675_event(void *param)
 {
     sensors_event_t event;
@@ -765,6 +821,382 @@ void run_test(int idx, int param)
         }
     }
     break;
+    case 23:
+    {
+        // checking input sequence streaming
+        // defining input stream (batches of 4 pulses)
+        PIN_FUNC_SELECT(ESPBOT_D5_MUX, ESPBOT_D5_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D5_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D5_NUM);
+
+        if (input_stream == NULL)
+        {
+            input_stream = new_di_seq_stream(ESPBOT_D5_NUM, 4, 50);
+            set_di_seq_cb(input_stream, input_batch_ready, (void *)input_stream, task);
+        }
+        read_di_seq_stream(input_stream);
+
+        // now the output
+        PIN_FUNC_SELECT(ESPBOT_D4_MUX, ESPBOT_D4_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+        seq = new_do_seq(ESPBOT_D4_NUM, 9);
+        set_do_seq_cb(seq, output_seq_completed_stop_stream, (void *)seq, task);
+
+        out_seq_clear(seq);
+        out_seq_add(seq, ESPBOT_LOW, 10);
+        out_seq_add(seq, ESPBOT_HIGH, 20);
+        out_seq_add(seq, ESPBOT_LOW, 10);
+        out_seq_add(seq, ESPBOT_HIGH, 20);
+        out_seq_add(seq, ESPBOT_LOW, 10);
+        out_seq_add(seq, ESPBOT_HIGH, 20);
+        out_seq_add(seq, ESPBOT_LOW, 10);
+        out_seq_add(seq, ESPBOT_HIGH, 20);
+        out_seq_add(seq, ESPBOT_LOW, 10);
+        exe_do_seq_ms(seq);
+    }
+    break;
+    case 24:
+    {
+        // checking concurrent input sequence readings on different pins
+        // (D5 and D6 both connected to D4)
+        PIN_FUNC_SELECT(ESPBOT_D5_MUX, ESPBOT_D5_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D5_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D5_NUM);
+        PIN_FUNC_SELECT(ESPBOT_D6_MUX, ESPBOT_D6_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D6_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D6_NUM);
+
+        struct di_seq *input_seq = new_di_seq(ESPBOT_D5_NUM, 9, 20, TIMEOUT_MS);
+        set_di_seq_cb(input_seq, input_seq_completed, (void *)input_seq, task);
+        struct di_seq *input_seq_2 = new_di_seq(ESPBOT_D6_NUM, 9, 20, TIMEOUT_MS);
+        set_di_seq_cb(input_seq_2, input_seq_completed, (void *)input_seq_2, task);
+        read_di_sequence(input_seq);
+        read_di_sequence(input_seq_2);
+
+        // now the output
+        PIN_FUNC_SELECT(ESPBOT_D4_MUX, ESPBOT_D4_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+        seq = new_do_seq(ESPBOT_D4_NUM, 9);
+        set_do_seq_cb(seq, output_seq_completed, (void *)seq, task);
+
+        out_seq_clear(seq);
+        out_seq_add(seq, ESPBOT_LOW, 1000);
+        out_seq_add(seq, ESPBOT_HIGH, 1000);
+        out_seq_add(seq, ESPBOT_LOW, 1000);
+        out_seq_add(seq, ESPBOT_HIGH, 1000);
+        out_seq_add(seq, ESPBOT_LOW, 1000);
+        out_seq_add(seq, ESPBOT_HIGH, 1000);
+        out_seq_add(seq, ESPBOT_LOW, 1000);
+        out_seq_add(seq, ESPBOT_HIGH, 1000);
+        out_seq_add(seq, ESPBOT_LOW, 1000);
+        exe_do_seq_us(seq);
+    }
+    break;
+    case 25:
+    {
+        // checking concurrent us sequences sharing the HW timer
+        // D4 output read on D5 (us timeout) while D7 runs a different output
+        PIN_FUNC_SELECT(ESPBOT_D5_MUX, ESPBOT_D5_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D5_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D5_NUM);
+
+        struct di_seq *input_seq = new_di_seq(ESPBOT_D5_NUM, 5, 5000, TIMEOUT_US);
+        set_di_seq_cb(input_seq, input_seq_completed, (void *)input_seq, task);
+        read_di_sequence(input_seq);
+
+        PIN_FUNC_SELECT(ESPBOT_D4_MUX, ESPBOT_D4_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+        seq = new_do_seq(ESPBOT_D4_NUM, 5);
+        set_do_seq_cb(seq, output_seq_completed, (void *)seq, task);
+        out_seq_clear(seq);
+        out_seq_add(seq, ESPBOT_LOW, 100);
+        out_seq_add(seq, ESPBOT_HIGH, 200);
+        out_seq_add(seq, ESPBOT_LOW, 300);
+        out_seq_add(seq, ESPBOT_HIGH, 400);
+        out_seq_add(seq, ESPBOT_LOW, 500);
+
+        PIN_FUNC_SELECT(ESPBOT_D7_MUX, ESPBOT_D7_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D7_NUM, ESPBOT_HIGH);
+        struct do_seq *seq_2 = new_do_seq(ESPBOT_D7_NUM, 4);
+        set_do_seq_cb(seq_2, output_seq_completed, (void *)seq_2, task);
+        out_seq_clear(seq_2);
+        out_seq_add(seq_2, ESPBOT_LOW, 150);
+        out_seq_add(seq_2, ESPBOT_HIGH, 150);
+        out_seq_add(seq_2, ESPBOT_LOW, 150);
+        out_seq_add(seq_2, ESPBOT_HIGH, 150);
+
+        exe_do_seq_us(seq);
+        exe_do_seq_us(seq_2);
+    }
+    break;
+    case 26:
+    {
+        // checking a compiled us sequence with short pulses
+        // (D5 connected to D4)
+        PIN_FUNC_SELECT(ESPBOT_D5_MUX, ESPBOT_D5_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D5_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D5_NUM);
+
+        struct di_seq *input_seq = new_di_seq(ESPBOT_D5_NUM, 6, 10, TIMEOUT_MS);
+        set_di_seq_cb(input_seq, input_seq_completed, (void *)input_seq, task);
+        set_di_seq_timestamp(input_seq, TIMESTAMP_CCOUNT);
+        read_di_sequence(input_seq);
+
+        PIN_FUNC_SELECT(ESPBOT_D4_MUX, ESPBOT_D4_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+        seq = new_do_seq(ESPBOT_D4_NUM, 6);
+        set_do_seq_cb(seq, output_seq_completed, (void *)seq, task);
+        out_seq_clear(seq);
+        out_seq_add(seq, ESPBOT_LOW, 2);
+        out_seq_add(seq, ESPBOT_HIGH, 3);
+        out_seq_add(seq, ESPBOT_LOW, 5);
+        out_seq_add(seq, ESPBOT_HIGH, 50);
+        out_seq_add(seq, ESPBOT_LOW, 8);
+        out_seq_add(seq, ESPBOT_HIGH, 100);
+        if (!compile_do_seq(seq))
+        {
+            fs_printf("compile_do_seq failed\n");
+            free_do_seq(seq);
+            break;
+        }
+        exe_do_seq_us(seq);
+    }
+    break;
+    case 27:
+    {
+        // checking a parallel output sequence on D4 and D7
+        // (D5 connected to D4, D6 connected to D7: the readings should match)
+        PIN_FUNC_SELECT(ESPBOT_D5_MUX, ESPBOT_D5_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D5_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D5_NUM);
+        PIN_FUNC_SELECT(ESPBOT_D6_MUX, ESPBOT_D6_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D6_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D6_NUM);
+
+        struct di_seq *input_seq = new_di_seq(ESPBOT_D5_NUM, 4, 20, TIMEOUT_MS);
+        set_di_seq_cb(input_seq, input_seq_completed, (void *)input_seq, task);
+        struct di_seq *input_seq_2 = new_di_seq(ESPBOT_D6_NUM, 4, 20, TIMEOUT_MS);
+        set_di_seq_cb(input_seq_2, input_seq_completed, (void *)input_seq_2, task);
+        read_di_sequence(input_seq);
+        read_di_sequence(input_seq_2);
+
+        PIN_FUNC_SELECT(ESPBOT_D4_MUX, ESPBOT_D4_FUNC);
+        PIN_FUNC_SELECT(ESPBOT_D7_MUX, ESPBOT_D7_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+        GPIO_OUTPUT_SET(ESPBOT_D7_NUM, ESPBOT_HIGH);
+        uint32 pins = BIT(ESPBOT_D4_NUM) | BIT(ESPBOT_D7_NUM);
+        struct do_pseq *pseq = new_do_pseq(pins, 4);
+        set_do_pseq_cb(pseq, output_pseq_completed, (void *)pseq, task);
+        out_pseq_clear(pseq);
+        out_pseq_add(pseq, 0, 100);
+        out_pseq_add(pseq, pins, 200);
+        out_pseq_add(pseq, 0, 300);
+        out_pseq_add(pseq, pins, 400);
+        exe_do_pseq_us(pseq);
+    }
+    break;
+    case 28:
+    {
+        // checking a repeating sequence: a burst of 4 cycles
+        // (D5 connected to D4)
+        PIN_FUNC_SELECT(ESPBOT_D5_MUX, ESPBOT_D5_FUNC);
+        PIN_PULLUP_EN(ESPBOT_D5_MUX);
+        GPIO_DIS_OUTPUT(ESPBOT_D5_NUM);
+
+        struct di_seq *input_seq = new_di_seq(ESPBOT_D5_NUM, 8, 10, TIMEOUT_MS);
+        set_di_seq_cb(input_seq, input_seq_completed, (void *)input_seq, task);
+        read_di_sequence(input_seq);
+
+        PIN_FUNC_SELECT(ESPBOT_D4_MUX, ESPBOT_D4_FUNC);
+        GPIO_OUTPUT_SET(ESPBOT_D4_NUM, ESPBOT_HIGH);
+        seq = new_do_seq(ESPBOT_D4_NUM, 2);
+        set_do_seq_cb(seq, output_seq_completed, (void *)seq, task);
+        out_seq_clear(seq);
+        out_seq_add(seq, ESPBOT_LOW, 100);
+        out_seq_add(seq, ESPBOT_HIGH, 300);
+        set_do_seq_repeat(seq, 4);
+        exe_do_seq_us(seq);
+    }
+    break;
+    case 29:
+    {
+        // printing the DHT22 bit classifier status
+        struct dht_classifier_stats stats;
+        int idx;
+        dht22->get_classifier_stats(&stats);
+        fs_printf("DHT22 bit classifier\n");
+        fs_printf("learnt frames: %d\n", stats.learnt_frames);
+        fs_printf("checksum errors: %d\n", stats.checksum_errors);
+        fs_printf("threshold: %d us\n", stats.threshold_us);
+        fs_printf("'0' mean: %d us - '1' mean: %d us\n", stats.zero_mean_us, stats.one_mean_us);
+        for (idx = 0; idx < DHT_HIST_BINS; idx++)
+            fs_printf("bin %2d [%5d ns]: %d\n", idx, (idx * stats.bin_width_ns), stats.histogram[idx]);
+    }
+    break;
+    case 30:
+    {
+        // printing the DHT22 reading counters
+        struct dht_reading_stats stats;
+        dht22->get_reading_stats(&stats);
+        fs_printf("DHT22 readings\n");
+        fs_printf("attempts: %d\n", stats.attempts);
+        fs_printf("successes: %d\n", stats.successes);
+        fs_printf("retries: %d\n", stats.retries);
+        fs_printf("failures: %d\n", stats.failures);
+        fs_printf("deferred: %d\n", stats.deferred);
+    }
+    break;
+    case 31:
+    {
+        // printing the DHT bus counters
+        struct dht_bus_stats stats;
+        get_dht_bus_stats(&stats);
+        fs_printf("DHT bus\n");
+        fs_printf("sensors: %d\n", stats.sensors);
+        fs_printf("readings: %d\n", stats.readings);
+        fs_printf("busy: %d ms\n", stats.busy_ms);
+        fs_printf("queued: %d\n", stats.queued);
+        fs_printf("max queue: %d\n", stats.max_queue);
+        fs_printf("max wait: %d ms\n", stats.max_wait_ms);
+    }
+    break;
+    case 32:
+    {
+        // DHT temperature bulk events reading
+        // the 8 latest events, then the ones newer than the 4th
+        sensors_event_t events[8];
+        int count = dht22->temperature.getEvents(events, 8);
+        int idx;
+        fs_printf("DHT temperature %d events\n", count);
+        for (idx = 0; idx < count; idx++)
+            print_event(&events[idx], 1);
+        if (count < 4)
+            break;
+        count = dht22->temperature.getEventsSince(events, 8, events[3].timestamp);
+        fs_printf("DHT temperature %d events (expected 3)\n", count);
+        for (idx = 0; idx < count; idx++)
+            print_event(&events[idx], 1);
+    }
+    break;
+    case 33:
+    {
+        // MAX6675 fast reading duration
+        // (fast reading completes inside force_reading)
+        uint32 start_time = system_get_time();
+        max6675->force_reading(NULL, NULL);
+        uint32 elapsed = system_get_time() - start_time;
+        sensors_event_t event;
+        max6675->getEvent(&event);
+        print_event(&event, 2);
+        fs_printf("MAX6675 force reading took %d us\n", elapsed);
+    }
+    break;
+    case 34:
+    {
+        // printing the registered sensors and the polling scheduler counters
+        struct sensor_sched_stats stats;
+        sensor_t sensor;
+        int idx;
+        fs_printf("%d registered sensors\n", get_sensors_count());
+        for (idx = 0; idx < get_sensors_count(); idx++)
+        {
+            get_sensor(idx)->getSensor(&sensor);
+            fs_printf("%d: %s id %d\n", idx, sensor.name, sensor.sensor_id);
+        }
+        get_sensor_sched_stats(&stats);
+        fs_printf("sensor polling\n");
+        fs_printf("active: %d\n", stats.active);
+        fs_printf("dispatched: %d\n", stats.dispatched);
+        fs_printf("shifted: %d\n", stats.shifted);
+        fs_printf("max delay: %d ms\n", stats.max_delay_ms);
+    }
+    break;
+    case 35:
+    {
+        // DHT streaming statistics
+        // (force a few readings with test 19 before)
+        struct sensor_stats stats;
+        dht22->temperature.getStats(&stats);
+        print_stats(&stats, 1);
+        dht22->humidity.getStats(&stats);
+        print_stats(&stats, 1);
+    }
+    break;
+    case 36:
+    {
+        // DHT temperature rollups: the 5 latest minute and hour buckets
+        struct sensor_rollup_bucket buckets[5];
+        Heap_chunk str(20);
+        int tier;
+        int count;
+        int idx;
+        for (tier = SENSOR_ROLLUP_MINUTES; tier <= SENSOR_ROLLUP_HOURS; tier++)
+        {
+            count = dht22->temperature.getRollup((sensor_rollup_tier)tier, buckets, 5);
+            fs_printf("DHT temperature %d %s buckets\n", count, (tier == SENSOR_ROLLUP_MINUTES) ? "minute" : "hour");
+            for (idx = 0; idx < count; idx++)
+            {
+                fs_printf("%s count %d", timedate_get_timestr(buckets[idx].timestamp), buckets[idx].count);
+                fs_printf(" min %s", f2str(str.ref, buckets[idx].min, 1));
+                fs_printf(" max %s", f2str(str.ref, buckets[idx].max, 1));
+                fs_printf(" avg %s\n", f2str(str.ref, buckets[idx].avg, 1));
+            }
+        }
+    }
+    break;
+    case 37:
+    {
+        // DHT temperature log: counters and the 3 latest records
+        // (test 38 flushes the buffered records)
+        struct sensor_log_stats stats;
+        struct sensor_log_record records[3];
+        sensors_event_t event;
+        int count = dht22_temperature_log->count();
+        int read;
+        int idx;
+        dht22_temperature_log->get_stats(&stats);
+        fs_printf("DHT temperature log\n");
+        fs_printf("records: %d\n", count);
+        fs_printf("appended: %d\n", stats.appended);
+        fs_printf("dropped: %d\n", stats.dropped);
+        fs_printf("flushes: %d\n", stats.flushes);
+        fs_printf("write errors: %d\n", stats.write_errors);
+        fs_printf("rotations: %d\n", stats.rotations);
+        read = dht22_temperature_log->read(((count > 3) ? (count - 3) : 0), records, 3);
+        for (idx = 0; idx < read; idx++)
+        {
+            dht22_temperature_log->fill_event(&records[idx], &event);
+            print_event(&event, 1);
+        }
+    }
+    break;
+    case 38:
+    {
+        dht22_temperature_log->flush();
+        fs_printf("DHT temperature log flushed, %d records\n", dht22_temperature_log->count());
+    }
+    break;
+    case 39:
+    {
+        // DHT temperature binary encoding: header and latest event bytes
+        // (for checking a collector decoder against GET /api/sensors/<id>/events.bin)
+        char buffer[SENSOR_WIRE_HEADER_LEN];
+        sensor_t sensor_info;
+        sensors_event_t event;
+        int idx;
+        dht22->temperature.getSensor(&sensor_info);
+        dht22->temperature.getEvent(&event);
+        sensor_wire_header(buffer, &sensor_info, 1);
+        fs_printf("header");
+        for (idx = 0; idx < SENSOR_WIRE_HEADER_LEN; idx++)
+            fs_printf(" %X", (uint8)buffer[idx]);
+        sensor_wire_event(buffer, &event);
+        fs_printf("\nevent");
+        for (idx = 0; idx < SENSOR_WIRE_EVENT_LEN; idx++)
+            fs_printf(" %X", (uint8)buffer[idx]);
+        fs_printf("\n");
+    }
+    break;
     default:
         break;
     }
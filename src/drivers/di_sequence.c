@@ -13,10 +13,11 @@
 #include "mem.h"
 #include "espbot_mem_macros.h"
 #include "user_interface.h"
-#include "driver_hw_timer.h"
 #include "esp8266_io.h"
 #include "drivers_di_sequence.h"
 #include "drivers_dio_task.h"
+#include "drivers_gpio_isr.h"
+#include "esp8266_ccount.h"
 #include "drivers.h"
 //
 // sequence definition
@@ -40,10 +41,38 @@ struct di_seq IRAM *new_di_seq(int pin, int num_pulses, int timeout_val, Di_time
     return seq;
 }
 
+struct di_seq IRAM *new_di_seq_compact(int pin, int num_pulses, int timeout_val, Di_timeout_unit timeout_unit)
+{
+    struct di_seq *seq = (struct di_seq *)call_espbot_zalloc(sizeof(struct di_seq));
+    if (seq == NULL)
+        return NULL;
+    seq->di_pin = pin;
+    seq->pulse_max_count = num_pulses + 1;
+    seq->timeout_val = timeout_val;
+    seq->timeout_unit = timeout_unit;
+    seq->compact = true;
+    seq->pulse_delta = (uint16 *)call_espbot_zalloc(sizeof(uint16) * num_pulses);
+    if (seq->pulse_delta == NULL)
+    {
+        call_espbot_free(seq);
+        return NULL;
+    }
+    return seq;
+}
+
 void IRAM free_di_seq(struct di_seq *seq)
 {
-    call_espbot_free(seq->pulse_level);
-    call_espbot_free(seq->pulse_duration);
+    // neither the timeout nor events still queued for the task must reach a freed sequence
+    os_timer_disarm(&(seq->timeout_timer));
+    hw_vtimer_disarm(&(seq->timeout_vtimer));
+    dio_cancel(SIG_DI_SEQ_COMPLETED, seq);
+    dio_cancel(SIG_DI_SEQ_BATCH, seq);
+    if (seq->pulse_level)
+        call_espbot_free(seq->pulse_level);
+    if (seq->pulse_duration)
+        call_espbot_free(seq->pulse_duration);
+    if (seq->pulse_delta)
+        call_espbot_free(seq->pulse_delta);
     call_espbot_free(seq);
 }
 
@@ -58,6 +87,15 @@ void seq_di_clear(struct di_seq *seq)
 {
     int idx = 0;
     seq->current_pulse = 0;
+    if (seq->compact)
+    {
+        seq->start_level = ESPBOT_LOW;
+        seq->long_gap_count = 0;
+        seq->long_gap_overflow = false;
+        for (idx = 0; idx < (seq->pulse_max_count - 1); idx++)
+            seq->pulse_delta[idx] = 0;
+        return;
+    }
     for (idx = 0; idx < seq->pulse_max_count; idx++)
     {
         seq->pulse_level[idx] = ESPBOT_LOW;
@@ -72,38 +110,132 @@ int get_di_seq_length(struct di_seq *seq)
 
 char get_di_seq_pulse_level(struct di_seq *seq, int idx)
 {
+    if (seq->compact)
+    {
+        if (idx >= seq->pulse_max_count)
+            return -1;
+        if (idx % 2)
+            return (seq->start_level == ESPBOT_LOW) ? ESPBOT_HIGH : ESPBOT_LOW;
+        return seq->start_level;
+    }
     if (idx < seq->pulse_max_count)
         return seq->pulse_level[idx];
     else
         return -1;
 }
 
-uint32 get_di_seq_pulse_duration(struct di_seq *seq, int idx)
+static uint32 get_long_gap(struct di_seq *seq, int idx)
 {
+    int gap;
+    for (gap = 0; gap < seq->long_gap_count; gap++)
+        if (seq->long_gap_idx[gap] == idx)
+            return seq->long_gap_val[gap];
+    // not stored (the long gaps table was full)
+    return -1;
+}
+
+// pulse length in timestamp ticks (us or CPU cycles)
+static uint32 get_pulse_ticks(struct di_seq *seq, int idx)
+{
+    if (seq->compact)
+    {
+        if (idx >= (seq->pulse_max_count - 1))
+            return -1;
+        if (seq->pulse_delta[idx] == 0xFFFF)
+            return get_long_gap(seq, idx);
+        return seq->pulse_delta[idx];
+    }
     if (idx < (seq->pulse_max_count - 1))
         return (seq->pulse_duration[idx + 1] - seq->pulse_duration[idx]);
     else
         return -1;
 }
 
+static uint32 ticks_to_us(struct di_seq *seq, uint32 ticks)
+{
+    if (ticks == (uint32)-1)
+        return -1;
+    if (seq->timestamp == TIMESTAMP_CCOUNT)
+        return (ticks / seq->ccount_mhz);
+    return ticks;
+}
+
+static uint32 ticks_to_ns(struct di_seq *seq, uint32 ticks)
+{
+    if (ticks == (uint32)-1)
+        return -1;
+    if (seq->timestamp == TIMESTAMP_CCOUNT)
+        return (uint32)(((uint64)ticks * 1000) / seq->ccount_mhz);
+    return (ticks * 1000);
+}
+
+uint32 get_di_seq_pulse_duration(struct di_seq *seq, int idx)
+{
+    return ticks_to_us(seq, get_pulse_ticks(seq, idx));
+}
+
+uint32 get_di_seq_pulse_duration_ns(struct di_seq *seq, int idx)
+{
+    return ticks_to_ns(seq, get_pulse_ticks(seq, idx));
+}
+
+void set_di_seq_timestamp(struct di_seq *seq, Di_timestamp timestamp)
+{
+    seq->timestamp = timestamp;
+}
+
+static inline uint32 di_seq_now(struct di_seq *seq)
+{
+    if (seq->timestamp == TIMESTAMP_CCOUNT)
+        return get_ccount();
+    return system_get_time();
+}
+
 //
 // recording sequence
 //
 
 static void IRAM input_pulse(struct di_seq *seq)
 {
-    uint32 gpio_status;
-
-    // clear interrupt status (checkout sdk API docs)
-    gpio_status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
-    GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, gpio_status);
+    // the interrupt status is cleared by the gpio isr dispatcher
 
     // check the allocated memory boundary
     // before acquiring new samples
     if (seq->current_pulse < seq->pulse_max_count)
     {
-        seq->pulse_duration[seq->current_pulse] = system_get_time();
-        seq->pulse_level[seq->current_pulse] = GPIO_INPUT_GET(seq->di_pin);
+        if (seq->compact)
+        {
+            uint32 now = di_seq_now(seq);
+            if (seq->current_pulse == 0)
+            {
+                seq->start_level = GPIO_INPUT_GET(seq->di_pin);
+            }
+            else
+            {
+                uint32 delta = now - seq->last_edge_time;
+                if (delta >= 0xFFFF)
+                {
+                    if (seq->long_gap_count < DI_SEQ_LONG_GAPS)
+                    {
+                        seq->long_gap_idx[seq->long_gap_count] = seq->current_pulse - 1;
+                        seq->long_gap_val[seq->long_gap_count] = delta;
+                        seq->long_gap_count++;
+                    }
+                    else
+                    {
+                        seq->long_gap_overflow = true;
+                    }
+                    delta = 0xFFFF;
+                }
+                seq->pulse_delta[seq->current_pulse - 1] = delta;
+            }
+            seq->last_edge_time = now;
+        }
+        else
+        {
+            seq->pulse_duration[seq->current_pulse] = di_seq_now(seq);
+            seq->pulse_level[seq->current_pulse] = GPIO_INPUT_GET(seq->di_pin);
+        }
         seq->current_pulse++;
         if (seq->current_pulse == seq->pulse_max_count)
         {
@@ -111,36 +243,43 @@ static void IRAM input_pulse(struct di_seq *seq)
             // disable the interrupt and
             // signal the sequence has been acquired
             gpio_pin_intr_state_set(seq->di_pin, GPIO_PIN_INTR_DISABLE);
+            gpio_isr_detach(seq->di_pin);
             if (seq->callback_direct == direct)
                 seq->end_sequence_callack(seq->end_sequence_callack_param);
             else
-                system_os_post(USER_TASK_PRIO_2, SIG_DI_SEQ_COMPLETED, (os_param_t)seq);
+                dio_post(SIG_DI_SEQ_COMPLETED, seq);
         }
     }
     // isr function takes 1-2 us
-    //                    5-6 us when system_os_post is called
+    //                    5-6 us when dio_post is called
 }
 
 static void input_reading_timeout_ms(struct di_seq *seq)
 {
     os_timer_disarm(&(seq->timeout_timer));
+    // release the pin, other sequences may be reading other pins
+    gpio_pin_intr_state_set(seq->di_pin, GPIO_PIN_INTR_DISABLE);
+    gpio_isr_detach(seq->di_pin);
     seq->ended_by_timeout = true;
-    system_os_post(USER_TASK_PRIO_2, SIG_DI_SEQ_COMPLETED, (os_param_t)seq);
+    dio_post(SIG_DI_SEQ_COMPLETED, seq);
 }
 
-static struct di_seq *us_seq;
-
-static void input_reading_timeout_us(void)
+static void IRAM input_reading_timeout_us(struct di_seq *seq)
 {
-    hw_timer_disarm();
-    us_seq->ended_by_timeout = true;
-    system_os_post(USER_TASK_PRIO_2, SIG_DI_SEQ_COMPLETED, (os_param_t)us_seq);
+    // release the pin, other sequences may be reading other pins
+    gpio_pin_intr_state_set(seq->di_pin, GPIO_PIN_INTR_DISABLE);
+    gpio_isr_detach(seq->di_pin);
+    seq->ended_by_timeout = true;
+    dio_post(SIG_DI_SEQ_COMPLETED, seq);
 }
 
 void IRAM read_di_sequence(struct di_seq *seq)
 {
+    seq->ccount_mhz = system_get_cpu_freq();
     seq->current_pulse = 0;
     seq->ended_by_timeout = false;
+    seq->long_gap_count = 0;
+    seq->long_gap_overflow = false;
 
     if (seq->timeout_unit == TIMEOUT_MS)
     {
@@ -150,16 +289,14 @@ void IRAM read_di_sequence(struct di_seq *seq)
     }
     else
     {
-        us_seq = seq;
-        hw_timer_set_func(input_reading_timeout_us);
-        hw_timer_init(FRC1_SOURCE, 0);
-        hw_timer_arm(seq->timeout_val);
+        hw_vtimer_disarm(&(seq->timeout_vtimer));
+        hw_vtimer_setfn(&(seq->timeout_vtimer), (void (*)(void *))input_reading_timeout_us, seq);
+        hw_vtimer_arm(&(seq->timeout_vtimer), seq->timeout_val);
     }
 
     // enable interrupt on GPIO selected pin for any edge
-    ETS_GPIO_INTR_ATTACH((ets_isr_t)input_pulse, seq);
+    gpio_isr_attach(seq->di_pin, (void (*)(void *))input_pulse, seq);
     gpio_pin_intr_state_set(seq->di_pin, GPIO_PIN_INTR_ANYEDGE);
-    ETS_GPIO_INTR_ENABLE();
 }
 
 void stop_di_sequence_timeout(struct di_seq *seq)
@@ -167,5 +304,204 @@ void stop_di_sequence_timeout(struct di_seq *seq)
     if (seq->timeout_unit == TIMEOUT_MS)
         os_timer_disarm(&(seq->timeout_timer));
     else
-        hw_timer_disarm();
-}
\ No newline at end of file
+        hw_vtimer_disarm(&(seq->timeout_vtimer));
+}
+//
+// streaming
+//
+
+struct di_seq IRAM *new_di_seq_stream(int pin, int batch_size, int flush_ms)
+{
+    struct di_seq *seq = (struct di_seq *)call_espbot_zalloc(sizeof(struct di_seq));
+    if (seq == NULL)
+        return NULL;
+    seq->di_pin = pin;
+    seq->pulse_max_count = 2 * batch_size;
+    seq->timeout_val = flush_ms;
+    seq->timeout_unit = TIMEOUT_MS;
+    seq->stream = true;
+    seq->stream_batch_size = batch_size;
+    seq->pulse_level = (char *)call_espbot_zalloc(sizeof(char) * (2 * batch_size));
+    if (seq->pulse_level == NULL)
+    {
+        call_espbot_free(seq);
+        return NULL;
+    }
+    seq->pulse_duration = (uint32 *)call_espbot_zalloc(sizeof(uint32) * (2 * batch_size));
+    if (seq->pulse_duration == NULL)
+    {
+        call_espbot_free(seq->pulse_level);
+        call_espbot_free(seq);
+        return NULL;
+    }
+    return seq;
+}
+
+// to be called with the gpio interrupt disabled (or from the isr)
+// once stopped batches are not posted, stop_di_seq_stream and
+// release_di_seq_batch deliver them
+static bool IRAM stream_hand_over(struct di_seq *seq)
+{
+    if (seq->stream_ready_half >= 0)
+        return false;
+    seq->stream_ready_half = seq->stream_fill_half;
+    seq->stream_ready_count = seq->stream_fill_count;
+    seq->stream_fill_half = 1 - seq->stream_fill_half;
+    seq->stream_fill_count = 0;
+    seq->stream_flush_pending = false;
+    seq->stream_handed_over = true;
+    if (seq->stream_stopped)
+        return true;
+    if (!dio_post(SIG_DI_SEQ_BATCH, seq))
+    {
+        // the task queue is full, the batch is lost
+        seq->stream_overruns += seq->stream_ready_count;
+        seq->stream_ready_half = -1;
+    }
+    return true;
+}
+
+static void IRAM input_pulse_stream(struct di_seq *seq)
+{
+    uint32 now;
+    char level;
+
+    now = di_seq_now(seq);
+    level = GPIO_INPUT_GET(seq->di_pin);
+    if (seq->stream_first_edge)
+    {
+        // the first edge is just the beginning of the first pulse
+        seq->stream_first_edge = false;
+    }
+    else if (seq->stream_fill_count < seq->stream_batch_size)
+    {
+        int idx = seq->stream_fill_half * seq->stream_batch_size + seq->stream_fill_count;
+        seq->pulse_level[idx] = seq->stream_last_level;
+        seq->pulse_duration[idx] = now - seq->stream_last_time;
+        seq->stream_fill_count++;
+        if (seq->stream_fill_count == seq->stream_batch_size)
+            stream_hand_over(seq);
+    }
+    else
+    {
+        // both halves are full, the task is late
+        seq->stream_overruns++;
+        stream_hand_over(seq);
+    }
+    seq->stream_last_time = now;
+    seq->stream_last_level = level;
+}
+
+// flush timer: the partial batch is handed over when no batch was
+// handed over since the previous flush
+// when the task is still consuming a batch the partial one waits for
+// release_di_seq_batch
+static void stream_flush(struct di_seq *seq)
+{
+    ETS_GPIO_INTR_DISABLE();
+    if (seq->stream_handed_over)
+        seq->stream_handed_over = false;
+    else if ((seq->stream_fill_count > 0) && !stream_hand_over(seq))
+        seq->stream_flush_pending = true;
+    ETS_GPIO_INTR_ENABLE();
+}
+
+// calling the batch callback from the caller context (stopped stream)
+static void stream_deliver(struct di_seq *seq)
+{
+    seq->end_sequence_callack(seq->end_sequence_callack_param);
+    release_di_seq_batch(seq);
+}
+
+void IRAM read_di_seq_stream(struct di_seq *seq)
+{
+    seq->ccount_mhz = system_get_cpu_freq();
+    seq->current_pulse = 0;
+    seq->ended_by_timeout = false;
+    seq->stream_fill_half = 0;
+    seq->stream_fill_count = 0;
+    seq->stream_ready_half = -1;
+    seq->stream_ready_count = 0;
+    seq->stream_first_edge = true;
+    seq->stream_overruns = 0;
+    seq->stream_flush_pending = false;
+    seq->stream_handed_over = false;
+    seq->stream_stopped = false;
+
+    // periodic hand over of partial batches
+    os_timer_disarm(&(seq->timeout_timer));
+    if (seq->timeout_val > 0)
+    {
+        os_timer_setfn(&(seq->timeout_timer), (os_timer_func_t *)stream_flush, seq);
+        os_timer_arm(&(seq->timeout_timer), seq->timeout_val, 1);
+    }
+
+    // enable interrupt on GPIO selected pin for any edge
+    gpio_isr_attach(seq->di_pin, (void (*)(void *))input_pulse_stream, seq);
+    gpio_pin_intr_state_set(seq->di_pin, GPIO_PIN_INTR_ANYEDGE);
+}
+
+void stop_di_seq_stream(struct di_seq *seq)
+{
+    os_timer_disarm(&(seq->timeout_timer));
+    gpio_pin_intr_state_set(seq->di_pin, GPIO_PIN_INTR_DISABLE);
+    gpio_isr_detach(seq->di_pin);
+    seq->stream_stopped = true;
+    // a batch still queued for the task is delivered now
+    if (dio_cancel(SIG_DI_SEQ_BATCH, seq) > 0)
+        stream_deliver(seq);
+    if (seq->stream_fill_count == 0)
+        return;
+    if (stream_hand_over(seq))
+        stream_deliver(seq);
+    else
+        // called by the batch callback, release_di_seq_batch will deliver it
+        seq->stream_flush_pending = true;
+}
+
+int get_di_seq_batch_length(struct di_seq *seq)
+{
+    if (seq->stream_ready_half < 0)
+        return 0;
+    return seq->stream_ready_count;
+}
+
+char get_di_seq_batch_pulse_level(struct di_seq *seq, int idx)
+{
+    if ((seq->stream_ready_half < 0) || (idx >= seq->stream_ready_count))
+        return -1;
+    return seq->pulse_level[seq->stream_ready_half * seq->stream_batch_size + idx];
+}
+
+static uint32 get_batch_pulse_ticks(struct di_seq *seq, int idx)
+{
+    if ((seq->stream_ready_half < 0) || (idx >= seq->stream_ready_count))
+        return -1;
+    return seq->pulse_duration[seq->stream_ready_half * seq->stream_batch_size + idx];
+}
+
+uint32 get_di_seq_batch_pulse_duration(struct di_seq *seq, int idx)
+{
+    return ticks_to_us(seq, get_batch_pulse_ticks(seq, idx));
+}
+
+uint32 get_di_seq_batch_pulse_duration_ns(struct di_seq *seq, int idx)
+{
+    return ticks_to_ns(seq, get_batch_pulse_ticks(seq, idx));
+}
+
+void release_di_seq_batch(struct di_seq *seq)
+{
+    bool deliver = false;
+    ETS_GPIO_INTR_DISABLE();
+    seq->stream_ready_half = -1;
+    seq->stream_ready_count = 0;
+    // the batch filled (or flushed) meanwhile is handed over now
+    if ((seq->stream_flush_pending && (seq->stream_fill_count > 0)) ||
+        (seq->stream_fill_count == seq->stream_batch_size))
+        deliver = stream_hand_over(seq) && seq->stream_stopped;
+    seq->stream_flush_pending = false;
+    ETS_GPIO_INTR_ENABLE();
+    if (deliver)
+        stream_deliver(seq);
+}
@@ -11,6 +11,8 @@
 #include "osapi.h"
 #include "user_interface.h"
 #include "mem.h"
+#include "espbot_mem_macros.h"
+#include "esp8266_intr.h"
 #include "drivers.h"
 #include "drivers_dio_task.h"
 #include "drivers_do_sequence.h"
@@ -18,35 +20,181 @@
 
 static os_event_t *dio_queue;
 
+struct dio_event
+{
+    int sig;
+    void *param;
+};
+
+static struct dio_event *dio_ring;
+static int ring_head;
+static int ring_count;
+static bool wake_up_pending;
+static void (*dio_handlers[DIO_SIGNALS])(void *);
+static struct dio_task_stats dio_stats;
+
 //
 // this task is for decoupling the end sequence callback
 // from isr routines and/or timer functions
 // (that could be an isr function when hw timer is used)
 //
+// events wait into the ring, the SDK queue just carries a wake up
+// for the task (posted when the ring turns not empty)
+//
+
+// a lost wake up (SDK queue full) leaves the events into the ring
+// and lets the next dio_post try again
+static void IRAM dio_wake_up(void)
+{
+    uint32 ps;
+    if (system_os_post(USER_TASK_PRIO_2, 0, 0))
+        return;
+    ps = intr_lock();
+    wake_up_pending = false;
+    dio_stats.wake_up_failures++;
+    intr_unlock(ps);
+}
+
+bool IRAM dio_post(int sig, void *param)
+{
+    bool wake_up = false;
+    uint32 ps = intr_lock();
+    if ((dio_ring == NULL) || (ring_count >= DIO_EVENT_RING_LEN))
+    {
+        dio_stats.overflows++;
+        intr_unlock(ps);
+        return false;
+    }
+    dio_ring[(ring_head + ring_count) % DIO_EVENT_RING_LEN].sig = sig;
+    dio_ring[(ring_head + ring_count) % DIO_EVENT_RING_LEN].param = param;
+    ring_count++;
+    dio_stats.posted++;
+    if (ring_count > dio_stats.high_water)
+        dio_stats.high_water = ring_count;
+    if (!wake_up_pending)
+    {
+        wake_up_pending = true;
+        wake_up = true;
+    }
+    intr_unlock(ps);
+    if (wake_up)
+        dio_wake_up();
+    return true;
+}
+
+// cancelled events stay into the ring and are skipped by the task
+int IRAM dio_cancel(int sig, void *param)
+{
+    int cancelled = 0;
+    int idx;
+    struct dio_event *event;
+    uint32 ps = intr_lock();
+    if (dio_ring == NULL)
+    {
+        intr_unlock(ps);
+        return 0;
+    }
+    for (idx = 0; idx < ring_count; idx++)
+    {
+        event = &dio_ring[(ring_head + idx) % DIO_EVENT_RING_LEN];
+        if ((event->sig == sig) && (event->param == param))
+        {
+            event->sig = DIO_SIG_CANCELLED;
+            cancelled++;
+        }
+    }
+    intr_unlock(ps);
+    return cancelled;
+}
 
 static void dio_task(os_event_t *e)
 {
-    switch (e->sig)
+    struct dio_event event;
+    uint32 ps;
+    int served;
+    // don't hold the CPU too long, other tasks are waiting
+    for (served = 0; served < DIO_EVENT_RING_LEN; served++)
     {
-    case SIG_DO_SEQ_COMPLETED:
-        // calling the end of sequence callback
-        ((struct do_seq *)(e->par))->end_sequence_callack(((struct do_seq *)(e->par))->end_sequence_callack_param);
+        ps = intr_lock();
+        if (ring_count == 0)
+        {
+            wake_up_pending = false;
+            intr_unlock(ps);
+            return;
+        }
+        event = dio_ring[ring_head];
+        ring_head = (ring_head + 1) % DIO_EVENT_RING_LEN;
+        ring_count--;
+        intr_unlock(ps);
+        if (event.sig == DIO_SIG_CANCELLED)
+            continue;
+        if ((event.sig >= 0) && (event.sig < DIO_SIGNALS) && dio_handlers[event.sig])
+        {
+            dio_handlers[event.sig](event.param);
+            dio_stats.handled++;
+        }
+        else
+        {
+            dio_stats.unhandled++;
+        }
+    }
+    // more events waiting, wake_up_pending stays true
+    dio_wake_up();
+}
+
+bool dio_set_handler(int sig, void (*handler)(void *))
+{
+    if ((sig < 0) || (sig >= DIO_SIGNALS))
+        return false;
+    dio_handlers[sig] = handler;
+    return true;
+}
 
-        break;
-    case SIG_DI_SEQ_COMPLETED:
-        stop_di_sequence_timeout((struct di_seq *)(e->par));
+void get_dio_task_stats(struct dio_task_stats *stats)
+{
+    uint32 ps = intr_lock();
+    os_memcpy(stats, &dio_stats, sizeof(struct dio_task_stats));
+    intr_unlock(ps);
+}
 
-        // calling the end of sequence callback
-        ((struct di_seq *)(e->par))->end_sequence_callack(((struct di_seq *)(e->par))->end_sequence_callack_param);
+//
+// sequence drivers events
+//
 
-        break;
-    default:
-        break;
-    }
+static void do_seq_completed(void *param)
+{
+    // calling the end of sequence callback
+    ((struct do_seq *)param)->end_sequence_callack(((struct do_seq *)param)->end_sequence_callack_param);
+}
+
+static void di_seq_completed(void *param)
+{
+    stop_di_sequence_timeout((struct di_seq *)param);
+    // calling the end of sequence callback
+    ((struct di_seq *)param)->end_sequence_callack(((struct di_seq *)param)->end_sequence_callack_param);
+}
+
+static void di_seq_batch(void *param)
+{
+    // calling the stream batch callback
+    ((struct di_seq *)param)->end_sequence_callack(((struct di_seq *)param)->end_sequence_callack_param);
+    // the isr can now reuse the batch half buffer
+    release_di_seq_batch((struct di_seq *)param);
+}
+
+static void do_pseq_completed(void *param)
+{
+    // calling the end of sequence callback
+    ((struct do_pseq *)param)->end_sequence_callack(((struct do_pseq *)param)->end_sequence_callack_param);
 }
 
 void init_dio_task(void)
 {
     dio_queue = (os_event_t *)call_espbot_zalloc(sizeof(os_event_t) * DIO_TASK_QUEUE_LEN);
+    dio_ring = (struct dio_event *)call_espbot_zalloc(sizeof(struct dio_event) * DIO_EVENT_RING_LEN);
     system_os_task(dio_task, USER_TASK_PRIO_2, dio_queue, DIO_TASK_QUEUE_LEN);
+    dio_set_handler(SIG_DO_SEQ_COMPLETED, do_seq_completed);
+    dio_set_handler(SIG_DI_SEQ_COMPLETED, di_seq_completed);
+    dio_set_handler(SIG_DI_SEQ_BATCH, di_seq_batch);
+    dio_set_handler(SIG_DO_PSEQ_COMPLETED, do_pseq_completed);
 }
\ No newline at end of file
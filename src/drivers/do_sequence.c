@@ -13,8 +13,9 @@
 #include "mem.h"
 #include "espbot_mem_macros.h"
 #include "user_interface.h"
-#include "driver_hw_timer.h"
 #include "esp8266_io.h"
+#include "esp8266_ccount.h"
+#include "driver_hw_timer.h"
 #include "drivers.h"
 #include "drivers_do_sequence.h"
 #include "drivers_dio_task.h"
@@ -41,8 +42,18 @@ struct do_seq IRAM *new_do_seq(int pin, int num_pulses)
 
 void IRAM free_do_seq(struct do_seq *seq)
 {
+    // a running sequence must not fire (or complete) on freed memory
+    os_timer_disarm(&(seq->pulse_timer));
+    hw_vtimer_disarm(&(seq->pulse_vtimer));
+    dio_cancel(SIG_DO_SEQ_COMPLETED, seq);
     call_espbot_free(seq->pulse_level);
     call_espbot_free(seq->pulse_duration);
+    if (seq->pulse_duration_next)
+        call_espbot_free(seq->pulse_duration_next);
+    if (seq->wave)
+        call_espbot_free(seq->wave);
+    if (seq->wave_next)
+        call_espbot_free(seq->wave_next);
     call_espbot_free(seq);
 }
 
@@ -57,6 +68,7 @@ void out_seq_clear(struct do_seq *seq)
 {
     int idx = 0;
     seq->pulse_count = 0;
+    seq->wave_len = 0;
     for (idx = 0; idx < seq->pulse_max_count; idx++)
     {
         seq->pulse_level[idx] = ESPBOT_LOW;
@@ -71,6 +83,7 @@ void out_seq_add(struct do_seq *seq, char level, uint32 duration)
         seq->pulse_level[seq->pulse_count] = level;
         seq->pulse_duration[seq->pulse_count] = duration;
         seq->pulse_count++;
+        seq->wave_len = 0;
     }
 }
 
@@ -95,6 +108,191 @@ uint32 get_do_seq_pulse_duration(struct do_seq *seq, int idx)
         return -1;
 }
 
+//
+// repeating sequences
+//
+
+// a compiled sequence goes back to the timer (leaving the isr)
+// only on pulses not shorter than DO_SEQ_SPIN_US:
+// consecutive shorter pulses are busy waited all in the same isr run
+// (across the cycle boundary when repeating) and must not exceed DO_SEQ_SPIN_MAX_US,
+// a repeating sequence without longer pulses would never leave the isr
+static bool do_seq_wave_leaves_isr(int cycles, uint32 *durations, int count)
+{
+    uint32 spin = 0;
+    uint32 first_spin = 0;
+    bool leaves = false;
+    int idx;
+    for (idx = 0; idx < count; idx++)
+    {
+        if (durations[idx] >= DO_SEQ_SPIN_US)
+        {
+            leaves = true;
+            spin = 0;
+            continue;
+        }
+        spin += durations[idx];
+        if (!leaves)
+            first_spin = spin;
+        if (spin > DO_SEQ_SPIN_MAX_US)
+            return false;
+    }
+    if ((cycles == 0) || (cycles == 1))
+        return true;
+    return (leaves && ((spin + first_spin) <= DO_SEQ_SPIN_MAX_US));
+}
+
+bool set_do_seq_repeat(struct do_seq *seq, int cycles)
+{
+    if (seq->wave_len > 0)
+    {
+        if (!do_seq_wave_leaves_isr(cycles, seq->pulse_duration, seq->wave_len))
+            return false;
+        if (seq->update_pending && !do_seq_wave_leaves_isr(cycles, seq->pulse_duration_next, seq->wave_len))
+            return false;
+    }
+    seq->repeat_cycles = cycles;
+    return true;
+}
+
+void stop_do_seq(struct do_seq *seq)
+{
+    seq->stop_requested = true;
+}
+
+bool out_seq_update(struct do_seq *seq, int idx, uint32 duration)
+{
+    // the isr is still going to swap the previous update
+    if (seq->update_pending)
+        return false;
+    if ((idx < 0) || (idx >= seq->pulse_max_count))
+        return false;
+    if (seq->pulse_duration_next == NULL)
+    {
+        seq->pulse_duration_next = (uint32 *)call_espbot_zalloc(sizeof(uint32) * seq->pulse_max_count);
+        if (seq->pulse_duration_next == NULL)
+            return false;
+        seq->update_applied = true;
+    }
+    if (seq->update_applied)
+    {
+        // next updates start from the current durations
+        os_memcpy(seq->pulse_duration_next, seq->pulse_duration, sizeof(uint32) * seq->pulse_max_count);
+        seq->update_applied = false;
+    }
+    seq->pulse_duration_next[idx] = duration;
+    return true;
+}
+
+// a compiled step timing: CCOUNT ticks for the edges and the FRC1 load
+// for re-arming the timer DO_SEQ_LEAD_US before the next edge
+// steps longer than HW_VTIMER_MAX_US (the FRC1 range) have neither,
+// the virtual timer takes them and the edge CCOUNT is taken from the system time
+// (CCOUNT ticks would overflow and wrap, see esp8266_ccount.h)
+static void IRAM do_seq_step_timing(struct do_seq_step *step, uint32 duration, uint32 mhz)
+{
+    step->duration = duration;
+    if (duration > HW_VTIMER_MAX_US)
+    {
+        step->ticks = 0;
+        step->frc1_ticks = 0;
+        return;
+    }
+    step->ticks = duration * mhz;
+    if (duration >= DO_SEQ_SPIN_US)
+        step->frc1_ticks = US_TO_RTC_TIMER_TICKS(duration - DO_SEQ_LEAD_US);
+    else
+        step->frc1_ticks = 0;
+}
+
+// compiling into wave (allocated on first use) the pulses with the given durations
+static bool do_seq_compile_steps(struct do_seq *seq, struct do_seq_step **wave, uint32 *durations)
+{
+    uint32 mask = BIT(seq->do_pin);
+    int idx;
+    if (*wave == NULL)
+    {
+        *wave = (struct do_seq_step *)call_espbot_zalloc(sizeof(struct do_seq_step) * seq->pulse_max_count);
+        if (*wave == NULL)
+            return false;
+    }
+    for (idx = 0; idx < seq->pulse_count; idx++)
+    {
+        if (seq->pulse_level[idx] == ESPBOT_LOW)
+        {
+            (*wave)[idx].w1ts = 0;
+            (*wave)[idx].w1tc = mask;
+        }
+        else
+        {
+            (*wave)[idx].w1ts = mask;
+            (*wave)[idx].w1tc = 0;
+        }
+        do_seq_step_timing(&((*wave)[idx]), durations[idx], seq->wave_mhz);
+    }
+    return true;
+}
+
+bool commit_do_seq_update(struct do_seq *seq)
+{
+    if (seq->pulse_duration_next == NULL)
+        return false;
+    // the isr may be swapping it in right now, nothing new can be staged anyway
+    if (seq->update_pending)
+        return true;
+    if (seq->wave_len > 0)
+    {
+        if (!do_seq_wave_leaves_isr(seq->repeat_cycles, seq->pulse_duration_next, seq->wave_len))
+            return false;
+        // the isr only swaps the buffers
+        if (!do_seq_compile_steps(seq, &(seq->wave_next), seq->pulse_duration_next))
+            return false;
+    }
+    seq->update_pending = true;
+    return true;
+}
+
+static void IRAM do_seq_apply_update(struct do_seq *seq)
+{
+    uint32 *durations = seq->pulse_duration;
+    struct do_seq_step *wave = seq->wave;
+    seq->pulse_duration = seq->pulse_duration_next;
+    seq->pulse_duration_next = durations;
+    if (seq->wave_len > 0)
+    {
+        seq->wave = seq->wave_next;
+        seq->wave_next = wave;
+    }
+    seq->update_applied = true;
+    seq->update_pending = false;
+}
+
+static void IRAM do_seq_start(struct do_seq *seq)
+{
+    if (seq->update_pending)
+        do_seq_apply_update(seq);
+    seq->cycles_left = seq->repeat_cycles;
+    seq->stop_requested = false;
+    seq->current_pulse = 0;
+}
+
+// called at the end of a cycle: true when the sequence goes on with another cycle
+static bool IRAM do_seq_next_cycle(struct do_seq *seq)
+{
+    if (seq->update_pending)
+        do_seq_apply_update(seq);
+    if (seq->stop_requested)
+        return false;
+    if (seq->cycles_left != DO_SEQ_REPEAT_FOREVER)
+    {
+        if (seq->cycles_left <= 1)
+            return false;
+        seq->cycles_left--;
+    }
+    seq->current_pulse = 0;
+    return true;
+}
+
 //
 // sequence execution
 //
@@ -105,7 +303,7 @@ uint32 get_do_seq_pulse_duration(struct do_seq *seq, int idx)
 
 static void IRAM output_pulse(struct do_seq *seq)
 {
-    if (seq->current_pulse < seq->pulse_max_count)
+    if ((seq->current_pulse < seq->pulse_max_count) || do_seq_next_cycle(seq))
     {
         // executing sequence pulses
         os_timer_arm(&(seq->pulse_timer), seq->pulse_duration[seq->current_pulse], 0);
@@ -120,7 +318,7 @@ static void IRAM output_pulse(struct do_seq *seq)
         if (seq->callback_direct == direct)
             seq->end_sequence_callack(seq->end_sequence_callack_param);
         else
-            system_os_post(USER_TASK_PRIO_2, SIG_DO_SEQ_COMPLETED, (os_param_t)seq);
+            dio_post(SIG_DO_SEQ_COMPLETED, seq);
     }
     // the output_pulse function execution takes 8 us
     // during sequence pulse (while the timer is armed)
@@ -130,7 +328,7 @@ void exe_do_seq_ms(struct do_seq *seq)
 {
     os_timer_disarm(&(seq->pulse_timer));
     os_timer_setfn(&(seq->pulse_timer), (os_timer_func_t *)output_pulse, seq);
-    seq->current_pulse = 0;
+    do_seq_start(seq);
     // save the current status of digital output
     seq->dig_output_initial_value = GPIO_INPUT_GET(seq->do_pin);
     output_pulse(seq);
@@ -140,32 +338,26 @@ void exe_do_seq_ms(struct do_seq *seq)
 // us pulses (HW timers)
 //
 
-static struct do_seq *us_seq;
-static int us_current_pulse;
-static int us_pulse_max_count;
-static int us_do_pin;
-static char *us_pulse_level;
-static uint32 *us_pulse_duration;
-
-static void IRAM output_pulse_us(void)
+static void IRAM output_pulse_us(struct do_seq *seq)
 {
-    if (us_current_pulse < us_pulse_max_count)
+    if ((seq->current_pulse < seq->pulse_max_count) || do_seq_next_cycle(seq))
     {
         // executing sequence pulses
-        hw_timer_arm(us_pulse_duration[us_current_pulse]);
-        GPIO_OUTPUT_SET(us_do_pin, us_pulse_level[us_current_pulse]);
-        us_current_pulse++;
+        // deadlines are absolute so that the isr latency doesn't add up pulse after pulse
+        seq->pulse_deadline += seq->pulse_duration[seq->current_pulse];
+        hw_vtimer_arm_at(&(seq->pulse_vtimer), seq->pulse_deadline);
+        GPIO_OUTPUT_SET(seq->do_pin, seq->pulse_level[seq->current_pulse]);
+        seq->current_pulse++;
     }
     else
     {
         // restoring original digital output status
-        GPIO_OUTPUT_SET(us_seq->do_pin, us_seq->dig_output_initial_value);
-        hw_timer_disarm();
+        GPIO_OUTPUT_SET(seq->do_pin, seq->dig_output_initial_value);
         // this is an isr function, better don't call the end sequence function here
-        if (us_seq->callback_direct == direct)
-            us_seq->end_sequence_callack(us_seq->end_sequence_callack_param);
+        if (seq->callback_direct == direct)
+            seq->end_sequence_callack(seq->end_sequence_callack_param);
         else
-            system_os_post(USER_TASK_PRIO_2, SIG_DO_SEQ_COMPLETED, (os_param_t)us_seq);
+            dio_post(SIG_DO_SEQ_COMPLETED, seq);
     }
     // the output_pulse function execution takes 2-3 us
     // during sequence pulse (while the timer is armed)
@@ -173,22 +365,275 @@ static void IRAM output_pulse_us(void)
     // the callback will be executed by the task after 50-60 us
 }
 
-void exe_do_seq_us(struct do_seq *seq)
+// waiting for the edge at deadline on CCOUNT
+// after a long step (see do_seq_step_timing) the CCOUNT target is taken again
+// from the system time, the virtual timer fired just before the deadline
+static inline void IRAM do_seq_wait_edge(uint32 *ccount, bool *resync, uint32 deadline, uint32 mhz)
+{
+    sint32 left;
+    if (*resync)
+    {
+        left = (sint32)(deadline - system_get_time());
+        *ccount = get_ccount();
+        if (left > 0)
+            *ccount += (uint32)left * mhz;
+        *resync = false;
+    }
+    while ((sint32)(get_ccount() - *ccount) < 0)
+        ;
+}
+
+// re-arming the virtual timer for the step just started
+// returns false for short steps, to be busy waited
+static inline bool IRAM do_seq_arm_step(struct hw_vtimer *vtimer, struct do_seq_step *step,
+                                        uint32 deadline, bool *resync)
 {
-    hw_timer_set_func(output_pulse_us);
-    hw_timer_init(FRC1_SOURCE, 0);
-    us_seq = seq;
-    us_current_pulse = 0;
-    us_pulse_max_count = seq->pulse_max_count;
-    us_do_pin = seq->do_pin;
-    us_pulse_level = seq->pulse_level;
-    us_pulse_duration = seq->pulse_duration;
-    // os_timer_disarm(&(seq->pulse_timer));
-    // os_timer_setfn(&(seq->pulse_timer),
-    //                (os_timer_func_t *)seq->end_sequence_callack,
-    //                seq->end_sequence_callack_param);
+    if (step->frc1_ticks)
+    {
+        hw_vtimer_arm_at_ticks(vtimer, deadline, (step->duration - DO_SEQ_LEAD_US), step->frc1_ticks);
+        return true;
+    }
+    if (step->duration > HW_VTIMER_MAX_US)
+    {
+        *resync = true;
+        hw_vtimer_arm_at(vtimer, deadline);
+        return true;
+    }
+    return false;
+}
 
+static void IRAM output_wave_us(struct do_seq *seq)
+{
+    struct do_seq_step *step;
+    do
+    {
+        while (seq->current_pulse < seq->wave_len)
+        {
+            step = &(seq->wave[seq->current_pulse]);
+            // the virtual timer can fire slightly early, wait for the edge time
+            do_seq_wait_edge(&(seq->wave_ccount), &(seq->wave_resync), seq->pulse_deadline, seq->wave_mhz);
+            GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, step->w1ts);
+            GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, step->w1tc);
+            seq->current_pulse++;
+            seq->wave_ccount += step->ticks;
+            seq->pulse_deadline += step->duration;
+            if (do_seq_arm_step(&(seq->pulse_vtimer), step, seq->pulse_deadline, &(seq->wave_resync)))
+                return;
+            // short pulse: busy waiting is cheaper than a timer round trip
+        }
+        do_seq_wait_edge(&(seq->wave_ccount), &(seq->wave_resync), seq->pulse_deadline, seq->wave_mhz);
+    } while (do_seq_next_cycle(seq));
+    // restoring original digital output status
+    if (seq->dig_output_initial_value)
+        GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, BIT(seq->do_pin));
+    else
+        GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, BIT(seq->do_pin));
+    if (seq->callback_direct == direct)
+        seq->end_sequence_callack(seq->end_sequence_callack_param);
+    else
+        dio_post(SIG_DO_SEQ_COMPLETED, seq);
+}
+
+bool compile_do_seq(struct do_seq *seq)
+{
+    if (!do_seq_wave_leaves_isr(seq->repeat_cycles, seq->pulse_duration, seq->pulse_count))
+        return false;
+    if (seq->update_pending &&
+        !do_seq_wave_leaves_isr(seq->repeat_cycles, seq->pulse_duration_next, seq->pulse_count))
+        return false;
+    seq->wave_mhz = system_get_cpu_freq();
+    if (!do_seq_compile_steps(seq, &(seq->wave), seq->pulse_duration))
+        return false;
+    // a committed update is swapped in precompiled too
+    if (seq->update_pending &&
+        !do_seq_compile_steps(seq, &(seq->wave_next), seq->pulse_duration_next))
+        return false;
+    seq->wave_len = seq->pulse_count;
+    return true;
+}
+
+void exe_do_seq_us(struct do_seq *seq)
+{
+    hw_vtimer_disarm(&(seq->pulse_vtimer));
+    do_seq_start(seq);
     // save the current status of digital output
-    us_seq->dig_output_initial_value = GPIO_INPUT_GET(us_seq->do_pin);
-    output_pulse_us();
-}
\ No newline at end of file
+    seq->dig_output_initial_value = GPIO_INPUT_GET(seq->do_pin);
+    if (seq->wave_len > 0)
+    {
+        // CCOUNT ticks depend on the CPU frequency
+        if (seq->wave_mhz != system_get_cpu_freq())
+            compile_do_seq(seq);
+        hw_vtimer_setfn(&(seq->pulse_vtimer), (void (*)(void *))output_wave_us, seq);
+        GPIO_REG_WRITE(GPIO_ENABLE_W1TS_ADDRESS, BIT(seq->do_pin));
+        seq->pulse_deadline = system_get_time();
+        seq->wave_ccount = get_ccount();
+        seq->wave_resync = false;
+        output_wave_us(seq);
+        return;
+    }
+    hw_vtimer_setfn(&(seq->pulse_vtimer), (void (*)(void *))output_pulse_us, seq);
+    seq->pulse_deadline = system_get_time();
+    output_pulse_us(seq);
+}
+
+
+//
+// parallel output sequences
+//
+
+struct do_pseq IRAM *new_do_pseq(uint32 pin_mask, int num_steps)
+{
+    struct do_pseq *seq = (struct do_pseq *)call_espbot_zalloc(sizeof(struct do_pseq));
+    if (seq == NULL)
+        return NULL;
+    seq->pin_mask = pin_mask;
+    seq->step_max_count = num_steps;
+    seq->steps = (struct do_seq_step *)call_espbot_zalloc(sizeof(struct do_seq_step) * num_steps);
+    if (seq->steps == NULL)
+    {
+        call_espbot_free(seq);
+        return NULL;
+    }
+    return seq;
+}
+
+void IRAM free_do_pseq(struct do_pseq *seq)
+{
+    os_timer_disarm(&(seq->step_timer));
+    hw_vtimer_disarm(&(seq->step_vtimer));
+    dio_cancel(SIG_DO_PSEQ_COMPLETED, seq);
+    call_espbot_free(seq->steps);
+    call_espbot_free(seq);
+}
+
+void IRAM set_do_pseq_cb(struct do_pseq *seq, void (*cb)(void *), void *cb_param, CB_call_type cb_call)
+{
+    seq->end_sequence_callack = cb;
+    seq->end_sequence_callack_param = cb_param;
+    seq->callback_direct = cb_call;
+}
+
+void out_pseq_clear(struct do_pseq *seq)
+{
+    seq->step_count = 0;
+    os_memset(seq->steps, 0, sizeof(struct do_seq_step) * seq->step_max_count);
+}
+
+void out_pseq_add(struct do_pseq *seq, uint32 value_mask, uint32 duration)
+{
+    if (seq->step_count < seq->step_max_count)
+    {
+        seq->steps[seq->step_count].w1ts = value_mask & seq->pin_mask;
+        seq->steps[seq->step_count].w1tc = (~value_mask) & seq->pin_mask;
+        if (seq->steps_mhz == 0)
+            seq->steps_mhz = system_get_cpu_freq();
+        do_seq_step_timing(&(seq->steps[seq->step_count]), duration, seq->steps_mhz);
+        seq->step_count++;
+    }
+}
+
+int get_do_pseq_length(struct do_pseq *seq)
+{
+    return seq->step_count;
+}
+
+uint32 get_do_pseq_step_value(struct do_pseq *seq, int idx)
+{
+    if (idx < seq->step_count)
+        return seq->steps[idx].w1ts;
+    else
+        return -1;
+}
+
+uint32 get_do_pseq_step_duration(struct do_pseq *seq, int idx)
+{
+    if (idx < seq->step_count)
+        return seq->steps[idx].duration;
+    else
+        return -1;
+}
+
+static void IRAM pseq_completed(struct do_pseq *seq)
+{
+    // restoring original digital output status
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, seq->initial_value);
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, (~seq->initial_value) & seq->pin_mask);
+    if (seq->callback_direct == direct)
+        seq->end_sequence_callack(seq->end_sequence_callack_param);
+    else
+        dio_post(SIG_DO_PSEQ_COMPLETED, seq);
+}
+
+static void IRAM pseq_start(struct do_pseq *seq)
+{
+    seq->current_step = 0;
+    // save the current status of digital outputs
+    seq->initial_value = gpio_input_get() & seq->pin_mask;
+    GPIO_REG_WRITE(GPIO_ENABLE_W1TS_ADDRESS, seq->pin_mask);
+}
+
+static void IRAM output_step(struct do_pseq *seq)
+{
+    struct do_seq_step *step;
+    if (seq->current_step < seq->step_count)
+    {
+        step = &(seq->steps[seq->current_step]);
+        os_timer_arm(&(seq->step_timer), step->duration, 0);
+        GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, step->w1ts);
+        GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, step->w1tc);
+        seq->current_step++;
+    }
+    else
+    {
+        os_timer_disarm(&(seq->step_timer));
+        pseq_completed(seq);
+    }
+}
+
+void exe_do_pseq_ms(struct do_pseq *seq)
+{
+    os_timer_disarm(&(seq->step_timer));
+    os_timer_setfn(&(seq->step_timer), (os_timer_func_t *)output_step, seq);
+    pseq_start(seq);
+    output_step(seq);
+}
+
+static void IRAM output_step_us(struct do_pseq *seq)
+{
+    struct do_seq_step *step;
+    while (seq->current_step < seq->step_count)
+    {
+        step = &(seq->steps[seq->current_step]);
+        // the virtual timer can fire slightly early, wait for the edge time
+        do_seq_wait_edge(&(seq->step_ccount), &(seq->step_resync), seq->step_deadline, seq->steps_mhz);
+        GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, step->w1ts);
+        GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, step->w1tc);
+        seq->current_step++;
+        seq->step_ccount += step->ticks;
+        seq->step_deadline += step->duration;
+        if (do_seq_arm_step(&(seq->step_vtimer), step, seq->step_deadline, &(seq->step_resync)))
+            return;
+        // short step: busy waiting is cheaper than a timer round trip
+    }
+    do_seq_wait_edge(&(seq->step_ccount), &(seq->step_resync), seq->step_deadline, seq->steps_mhz);
+    pseq_completed(seq);
+}
+
+void exe_do_pseq_us(struct do_pseq *seq)
+{
+    int idx;
+    hw_vtimer_disarm(&(seq->step_vtimer));
+    hw_vtimer_setfn(&(seq->step_vtimer), (void (*)(void *))output_step_us, seq);
+    // CCOUNT ticks depend on the CPU frequency
+    if (seq->steps_mhz != system_get_cpu_freq())
+    {
+        seq->steps_mhz = system_get_cpu_freq();
+        for (idx = 0; idx < seq->step_count; idx++)
+            do_seq_step_timing(&(seq->steps[idx]), seq->steps[idx].duration, seq->steps_mhz);
+    }
+    pseq_start(seq);
+    seq->step_deadline = system_get_time();
+    seq->step_ccount = get_ccount();
+    seq->step_resync = false;
+    output_step_us(seq);
+}
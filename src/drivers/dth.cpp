@@ -20,8 +20,11 @@ extern "C"
 #include "mem.h"
 #include "user_interface.h"
 #include "esp8266_io.h"
+#include "esp8266_ccount.h"
+#include "drivers_dio_task.h"
 #include "drivers_do_sequence.h"
-#include "drivers_di_sequence.h"
+#include "drivers_gpio_isr.h"
+#include "drivers_hw_vtimer.h"
 }
 
 #include "espbot_diagnostic.hpp"
@@ -34,31 +37,280 @@ extern "C"
 // static uint32 dht_start_sequence;
 // static uint32 dht_start_sequence_completed;
 
+#define DHT_BITS 40
+#define DHT_READING_TIMEOUT_US 100000
+#define DHT_BIT_THRESHOLD_US 49 // high pulse: 26-28 us => 0, 70 us => 1 (until learnt)
+#define DHT_BIT_THRESHOLD_MIN_US 35
+#define DHT_BIT_THRESHOLD_MAX_US 60
+#define DHT_CLASS_MIN_SAMPLES 8 // per class, before moving the threshold
+#define DHT_HIST_MAX_COUNT 4096 // older samples fade out halving the histogram
+#define DHT_MAX_RETRIES 2       // failed readings are retried after min_delay, 2 * min_delay, ...
+
+// the sensor needs this time between readings (same as getSensor min_delay)
+static uint32 dht_min_delay(Dht_type type)
+{
+    if (type == DHT11)
+        return 1000000; // us
+    return 2000000;
+}
+
+// histogram bins are a power of 2 of CCOUNT ticks (no division in the isr)
+// about 6.4 us at 80 and 160 MHz
+static uint32 IRAM dht_hist_shift(uint32 mhz)
+{
+    uint32 shift = 0;
+    while ((1u << shift) < (6 * mhz))
+        shift++;
+    return shift;
+}
+
+static void dht_classifier_learn(Dht *dht_ptr)
+{
+    int idx;
+    uint32 total = 0;
+    for (idx = 0; idx < DHT_HIST_BINS; idx++)
+    {
+        dht_ptr->_hist[idx] += dht_ptr->_frame_hist[idx];
+        total += dht_ptr->_hist[idx];
+    }
+    if (total > DHT_HIST_MAX_COUNT)
+        for (idx = 0; idx < DHT_HIST_BINS; idx++)
+            dht_ptr->_hist[idx] >>= 1;
+    dht_ptr->_learnt_frames++;
+    // two classes split maximizing the between class variance (Otsu)
+    uint32 count_all = 0;
+    uint32 sum_all = 0;
+    for (idx = 0; idx < DHT_HIST_BINS; idx++)
+    {
+        count_all += dht_ptr->_hist[idx];
+        sum_all += idx * dht_ptr->_hist[idx];
+    }
+    uint32 count_0 = 0;
+    uint32 sum_0 = 0;
+    float best_var = 0;
+    int best_split = -1;
+    for (idx = 0; idx < (DHT_HIST_BINS - 1); idx++)
+    {
+        count_0 += dht_ptr->_hist[idx];
+        sum_0 += idx * dht_ptr->_hist[idx];
+        if ((count_0 < DHT_CLASS_MIN_SAMPLES) || ((count_all - count_0) < DHT_CLASS_MIN_SAMPLES))
+            continue;
+        float mean_diff = ((float)sum_0 / count_0) - ((float)(sum_all - sum_0) / (count_all - count_0));
+        float var = mean_diff * mean_diff * count_0 * (count_all - count_0);
+        if (var > best_var)
+        {
+            best_var = var;
+            best_split = idx;
+        }
+    }
+    if (best_split < 0)
+        return;
+    // class means (bin centers) in us
+    count_0 = 0;
+    sum_0 = 0;
+    for (idx = 0; idx <= best_split; idx++)
+    {
+        count_0 += dht_ptr->_hist[idx];
+        sum_0 += idx * dht_ptr->_hist[idx];
+    }
+    float bin_width = (float)(1 << dht_ptr->_hist_shift) / dht_ptr->_ccount_mhz;
+    float mean_0 = (((float)sum_0 / count_0) + 0.5f) * bin_width;
+    float mean_1 = (((float)(sum_all - sum_0) / (count_all - count_0)) + 0.5f) * bin_width;
+    uint32 threshold = (uint32)((mean_0 + mean_1) / 2);
+    if (threshold < DHT_BIT_THRESHOLD_MIN_US)
+        threshold = DHT_BIT_THRESHOLD_MIN_US;
+    if (threshold > DHT_BIT_THRESHOLD_MAX_US)
+        threshold = DHT_BIT_THRESHOLD_MAX_US;
+    dht_ptr->_zero_mean_us = (uint32)mean_0;
+    dht_ptr->_one_mean_us = (uint32)mean_1;
+    dht_ptr->_threshold_us = threshold;
+}
+
+//
+// DHT bus: readings on different pins are serialized
+// (edges of concurrent readings would stretch each other isr)
+// a reading starts at least DHT_BUS_SPACING_MS after the previous end
+// (queued or requested later, when the bus went idle meanwhile)
+//
+
+#define DHT_BUS_SPACING_MS 5
+
+static void dht_read(Dht *dht_ptr);
+
+static Dht *bus_owner;
+static Dht *bus_queue_head;
+static Dht *bus_queue_tail;
+static int bus_queue_len;
+static os_timer_t bus_spacing_timer;
+static bool bus_spacing_timer_init;
+static uint32 bus_start_time;
+static uint32 bus_release_time;
+static bool bus_released;
+static struct dht_bus_stats bus_stats;
+
+static void dht_bus_next(void *param)
+{
+    Dht *dht_ptr = bus_queue_head;
+    if ((bus_owner != NULL) || (dht_ptr == NULL))
+        return;
+    bus_queue_head = dht_ptr->_bus_next;
+    if (bus_queue_head == NULL)
+        bus_queue_tail = NULL;
+    bus_queue_len--;
+    dht_ptr->_bus_next = NULL;
+    dht_ptr->_bus_queued = false;
+    uint32 wait_ms = (system_get_time() - dht_ptr->_bus_request_time) / 1000;
+    if (wait_ms > bus_stats.max_wait_ms)
+        bus_stats.max_wait_ms = wait_ms;
+    bus_owner = dht_ptr;
+    bus_start_time = system_get_time();
+    dht_read(dht_ptr);
+}
+
+static void dht_bus_request(Dht *dht_ptr)
+{
+    if (!bus_spacing_timer_init)
+    {
+        os_timer_setfn(&bus_spacing_timer, (os_timer_func_t *)dht_bus_next, NULL);
+        bus_spacing_timer_init = true;
+    }
+    dht_ptr->_bus_request_time = system_get_time();
+    dht_ptr->_bus_next = NULL;
+    dht_ptr->_bus_queued = true;
+    if (bus_queue_tail)
+        bus_queue_tail->_bus_next = dht_ptr;
+    else
+        bus_queue_head = dht_ptr;
+    bus_queue_tail = dht_ptr;
+    bus_queue_len++;
+    if ((bus_owner != NULL) || (bus_queue_len > 1))
+        bus_stats.queued++;
+    if (bus_queue_len > (int)bus_stats.max_queue)
+        bus_stats.max_queue = bus_queue_len;
+    // when the bus is free and not spacing, start now
+    if ((bus_owner == NULL) && (bus_queue_len == 1))
+    {
+        uint32 elapsed = dht_ptr->_bus_request_time - bus_release_time;
+        if (bus_released && (elapsed < (DHT_BUS_SPACING_MS * 1000)))
+        {
+            // wait for the rest of the spacing (rounded up to the timer ms)
+            os_timer_disarm(&bus_spacing_timer);
+            os_timer_arm(&bus_spacing_timer, ((DHT_BUS_SPACING_MS * 1000 - elapsed + 999) / 1000), 0);
+            return;
+        }
+        dht_bus_next(NULL);
+    }
+}
+
+static void dht_bus_release(Dht *dht_ptr)
+{
+    if (bus_owner != dht_ptr)
+        return;
+    bus_owner = NULL;
+    bus_stats.readings++;
+    bus_release_time = system_get_time();
+    bus_released = true;
+    bus_stats.busy_ms += (bus_release_time - bus_start_time) / 1000;
+    if (bus_queue_head)
+    {
+        os_timer_disarm(&bus_spacing_timer);
+        os_timer_arm(&bus_spacing_timer, DHT_BUS_SPACING_MS, 0);
+    }
+}
+
+static void dht_bus_leave(Dht *dht_ptr)
+{
+    Dht **cur = &bus_queue_head;
+    dht_bus_release(dht_ptr);
+    if (!dht_ptr->_bus_queued)
+        return;
+    bus_queue_tail = NULL;
+    while (*cur)
+    {
+        if (*cur == dht_ptr)
+        {
+            *cur = dht_ptr->_bus_next;
+            bus_queue_len--;
+            continue;
+        }
+        bus_queue_tail = *cur;
+        cur = &((*cur)->_bus_next);
+    }
+    dht_ptr->_bus_queued = false;
+}
+
+void get_dht_bus_stats(struct dht_bus_stats *stats)
+{
+    os_memcpy(stats, &bus_stats, sizeof(struct dht_bus_stats));
+}
+
+// streaming statistics and rollups, O(1) per sample
+static void dht_update_stats(Dht *dht_ptr, struct dht_sample *sample, uint32 timestamp)
+{
+    float scale = (dht_ptr->_type == DHT11) ? 1.0f : 0.1f;
+    if (sample->invalid)
+    {
+        dht_ptr->_temperature_stats.update_invalid(timestamp);
+        dht_ptr->_humidity_stats.update_invalid(timestamp);
+        return;
+    }
+    dht_ptr->_temperature_stats.update(((float)sample->temperature * scale), timestamp);
+    dht_ptr->_humidity_stats.update(((float)sample->humidity * scale), timestamp);
+    dht_ptr->_temperature_rollup.update(((float)sample->temperature * scale), timestamp);
+    dht_ptr->_humidity_rollup.update(((float)sample->humidity * scale), timestamp);
+}
+
+// new sample listeners (e.g. SensorLog)
+static void dht_notify_sample(Dht *dht_ptr)
+{
+    sensors_event_t event;
+    if (dht_ptr->temperature._sample_listener)
+    {
+        dht_ptr->temperature.getEvent(&event);
+        dht_ptr->temperature._sample_listener(dht_ptr->temperature._sample_listener_param, &event);
+    }
+    if (dht_ptr->humidity._sample_listener)
+    {
+        dht_ptr->humidity.getEvent(&event);
+        dht_ptr->humidity._sample_listener(dht_ptr->humidity._sample_listener_param, &event);
+    }
+}
+
 static void dht_reading_completed(void *param)
 {
     Dht *dht_ptr = (Dht *)param;
-    if ((dht_ptr->_dht_in_sequence)->ended_by_timeout)
+    hw_vtimer_disarm(&(dht_ptr->_timeout_timer));
+    dht_bus_release(dht_ptr);
+    // retry a failed reading before storing an invalid sample
+    if (dht_ptr->_retries < DHT_MAX_RETRIES)
     {
-        dia_error_evnt(DHT_READING_TIMEOUT, (dht_ptr->_dht_in_sequence)->current_pulse);
-        ERROR("dht reading timeout D%d %d samples acquired", dht_ptr->_pin, (dht_ptr->_dht_in_sequence)->current_pulse);
-        seq_di_clear(dht_ptr->_dht_in_sequence);
-        // calculate buffer position
-        // don't update the buffer position, someone could be reading ...
-        int cur_pos;
-        if (dht_ptr->_buffer_idx == (dht_ptr->_max_buffer_size - 1))
-            cur_pos = 0;
-        else
-            cur_pos = dht_ptr->_buffer_idx + 1;
+        bool failed = dht_ptr->_ended_by_timeout;
+        if (!failed && ((uint8_t)(dht_ptr->_data[0] + dht_ptr->_data[1] + dht_ptr->_data[2] + dht_ptr->_data[3]) != dht_ptr->_data[4]))
+        {
+            failed = true;
+            dht_ptr->_checksum_errors++;
+        }
+        if (failed)
+        {
+            TRACE("dht reading D%d failed, retry %d", dht_ptr->_pin, (dht_ptr->_retries + 1));
+            // the retry timer checks min_delay again before reading
+            os_timer_arm(&(dht_ptr->_retry_timer), ((dht_min_delay(dht_ptr->_type) / 1000) << dht_ptr->_retries), 0);
+            dht_ptr->_retries++;
+            dht_ptr->_retry_count++;
+            return;
+        }
+    }
+    if (dht_ptr->_ended_by_timeout)
+    {
+        dht_ptr->_failure_count++;
+        dia_error_evnt(DHT_READING_TIMEOUT, dht_ptr->_edge_count);
+        ERROR("dht reading timeout D%d %d samples acquired", dht_ptr->_pin, dht_ptr->_edge_count);
         // insert an invalid event
-        dht_ptr->_invalid_buffer[cur_pos] = true;
-        dht_ptr->_timestamp_buffer[cur_pos] = timedate_get_timestamp();
-        dht_ptr->_temperature_buffer[cur_pos] = 0;
-        dht_ptr->_humidity_buffer[cur_pos] = 0;
-        // update the buffer position
-        if (dht_ptr->_buffer_idx == (dht_ptr->_max_buffer_size - 1))
-            dht_ptr->_buffer_idx = 0;
-        else
-            dht_ptr->_buffer_idx++;
+        struct dht_sample sample = {0, 0, 1};
+        uint32 timestamp = timedate_get_timestamp();
+        dht_ptr->_samples.push(sample, timestamp);
+        dht_update_stats(dht_ptr, &sample, timestamp);
+        dht_notify_sample(dht_ptr);
         // done with reading
         dht_ptr->_reading_ongoing = false;
         // still something to do if it was a force reading
@@ -66,9 +318,8 @@ static void dht_reading_completed(void *param)
         {
             dht_ptr->_force_reading = false;
             // restart polling
-            os_timer_disarm(&(dht_ptr->_poll_timer));
             if (dht_ptr->_poll_interval > 0)
-                os_timer_arm(&(dht_ptr->_poll_timer), dht_ptr->_poll_interval, 1);
+                sensor_poll_start(&(dht_ptr->_poll), dht_ptr->_poll_interval);
             // actually there was no reading but anyway ...
             if (dht_ptr->_force_reading_cb)
                 dht_ptr->_force_reading_cb(dht_ptr->_force_reading_param);
@@ -78,46 +329,15 @@ static void dht_reading_completed(void *param)
     else
     {
         // check "get ready pulse" to send data into read sequence
-        uint32 pulse_duration = get_di_seq_pulse_duration(dht_ptr->_dht_in_sequence, 0);
+        uint32 pulse_duration = dht_ptr->_ready_pulse / dht_ptr->_ccount_mhz;
         if ((pulse_duration < 70) || (pulse_duration > 90))
             // ERROR("DHT [D%d] reading: missing "get ready pulse"", dht_ptr->_pin);
             // nah, on second thougth why you have to mind about a correct 'get ready pulse'
             // just let it trace as an irrilevant event
             TRACE("dht reading D%d missing the get ready pulse", dht_ptr->_pin);
-        // convert read sequence to _data
-        int idx;
-        char bit_idx, byte_idx;
-        for (idx = 0; idx < 5; idx++)
-            dht_ptr->_data[idx] = 0;
+        // _data was filled by the edge isr
         bool invalid_data = false;
-        for (idx = 2; idx < 81; idx = idx + 2)
-        {
-            pulse_duration = get_di_seq_pulse_duration(dht_ptr->_dht_in_sequence, idx);
-            bit_idx = ((idx - 2) / 2) % 8;
-            byte_idx = ((idx - 2) / 2) / 8;
-            // found a 0 => do nothing
-            if ((15 < pulse_duration) && (pulse_duration < 38))
-                continue;
-            // found a 1
-            if ((60 < pulse_duration) && (pulse_duration < 84))
-            {
-                dht_ptr->_data[byte_idx] |= (0x01 << (7 - bit_idx));
-                continue;
-            }
-            // now what the heck is this? let's try a guess
-            // don't mark data as invalid yet, wait for checksum verification
-            // invalid_data = true;
-            // ERROR("DHT [D%d] reading: cannot understand bit (length = %d us)", dht_ptr->_pin, pulse_duration);
-            if (pulse_duration > 49)
-                dht_ptr->_data[byte_idx] |= (0x01 << (7 - bit_idx));
-        }
-        // calculate buffer position
-        // don't update the buffer position, someone could be reading ...
-        int cur_pos;
-        if (dht_ptr->_buffer_idx == (dht_ptr->_max_buffer_size - 1))
-            cur_pos = 0;
-        else
-            cur_pos = dht_ptr->_buffer_idx + 1;
+        struct dht_sample sample;
         // check the checksum
         uint8_t checksum = dht_ptr->_data[0] + dht_ptr->_data[1] + dht_ptr->_data[2] + dht_ptr->_data[3];
         if (checksum != dht_ptr->_data[4])
@@ -125,53 +345,53 @@ static void dht_reading_completed(void *param)
             dia_error_evnt(DHT_READING_CHECKSUM_ERR, dht_ptr->_pin);
             ERROR("dht reading D%d checksum error", dht_ptr->_pin);
             invalid_data = true;
+            dht_ptr->_checksum_errors++;
         }
-        // set the invalid data flag
-        if (invalid_data)
-            dht_ptr->_invalid_buffer[cur_pos] = true;
         else
-            dht_ptr->_invalid_buffer[cur_pos] = false;
-        // get the timestamp
-        dht_ptr->_timestamp_buffer[cur_pos] = timedate_get_timestamp();
-        // convert _data to buffer values
-        // temperature
+        {
+            dht_classifier_learn(dht_ptr);
+        }
+        // convert _data to sample values
+        int temperature = 0;
+        int humidity = 0;
         switch (dht_ptr->_type)
         {
         case DHT11:
-            dht_ptr->_temperature_buffer[cur_pos] = dht_ptr->_data[2];
+            temperature = dht_ptr->_data[2];
+            humidity = dht_ptr->_data[0];
             break;
         case DHT22:
         case DHT21:
-            dht_ptr->_temperature_buffer[cur_pos] = dht_ptr->_data[2] & 0x7F;
-            dht_ptr->_temperature_buffer[cur_pos] *= 256;
-            dht_ptr->_temperature_buffer[cur_pos] += dht_ptr->_data[3];
+            temperature = ((dht_ptr->_data[2] & 0x7F) << 8) + dht_ptr->_data[3];
             if (dht_ptr->_data[2] & 0x80)
-                dht_ptr->_temperature_buffer[cur_pos] *= -1;
+                temperature *= -1;
+            humidity = (dht_ptr->_data[0] << 8) + dht_ptr->_data[1];
             break;
         }
-        // humidity
-        switch (dht_ptr->_type)
+        // a reading that does not fit the stored sample is garbage anyway
+        if ((temperature > DHT_SAMPLE_TEMPERATURE_MAX) || (temperature < -DHT_SAMPLE_TEMPERATURE_MAX) ||
+            (humidity > DHT_SAMPLE_HUMIDITY_MAX))
         {
-        case DHT11:
-            dht_ptr->_humidity_buffer[cur_pos] = dht_ptr->_data[0];
-            break;
-        case DHT22:
-        case DHT21:
-            dht_ptr->_humidity_buffer[cur_pos] = dht_ptr->_data[0];
-            dht_ptr->_humidity_buffer[cur_pos] *= 256;
-            dht_ptr->_humidity_buffer[cur_pos] += dht_ptr->_data[1];
-            break;
+            temperature = 0;
+            humidity = 0;
+            invalid_data = true;
         }
-        // update the buffer position
-        if (dht_ptr->_buffer_idx == (dht_ptr->_max_buffer_size - 1))
-            dht_ptr->_buffer_idx = 0;
+        // count the stored sample
+        if (invalid_data)
+            dht_ptr->_failure_count++;
         else
-            dht_ptr->_buffer_idx++;
-        seq_di_clear(dht_ptr->_dht_in_sequence);
+            dht_ptr->_success_count++;
+        sample.temperature = temperature;
+        sample.humidity = humidity;
+        sample.invalid = invalid_data;
+        uint32 timestamp = timedate_get_timestamp();
+        dht_ptr->_samples.push(sample, timestamp);
+        dht_update_stats(dht_ptr, &sample, timestamp);
+        dht_notify_sample(dht_ptr);
         // DEBUG
         // os_printf("DHT starting sequence took %d us\n", (dht_start_sequence_completed - dht_start_sequence));
-        // os_printf("DHT temperature: %d\n", dht_ptr->_temperature_buffer[cur_pos]);
-        // os_printf("DHT humidity   : %d\n", dht_ptr->_humidity_buffer[cur_pos]);
+        // os_printf("DHT temperature: %d\n", sample.temperature);
+        // os_printf("DHT humidity   : %d\n", sample.humidity);
     }
     // done with reading
     dht_ptr->_reading_ongoing = false;
@@ -180,27 +400,87 @@ static void dht_reading_completed(void *param)
     {
         dht_ptr->_force_reading = false;
         // restart polling
-        os_timer_disarm(&(dht_ptr->_poll_timer));
         if (dht_ptr->_poll_interval > 0)
-            os_timer_arm(&(dht_ptr->_poll_timer), dht_ptr->_poll_interval, 1);
+            sensor_poll_start(&(dht_ptr->_poll), dht_ptr->_poll_interval);
 
         if (dht_ptr->_force_reading_cb)
             dht_ptr->_force_reading_cb(dht_ptr->_force_reading_param);
     }
 }
 
+static void IRAM dht_edge(Dht *dht_ptr)
+{
+    // the interrupt status is cleared by the gpio isr dispatcher
+    uint32 now = get_ccount();
+    uint32 pulse = now - dht_ptr->_last_edge;
+    bool first_edge = (dht_ptr->_edge_count == 0);
+    dht_ptr->_last_edge = now;
+    dht_ptr->_edge_count++;
+    // the sensor answer starts when the line is released:
+    // 80 us low, 80 us high (get ready) then for each bit 50 us low and a high pulse
+    // whose length tells the bit value, so a high pulse is decoded on its falling edge
+    if (first_edge || GPIO_INPUT_GET(gpio_NUM(dht_ptr->_pin)))
+        return;
+    if (!dht_ptr->_ready_seen)
+    {
+        dht_ptr->_ready_seen = true;
+        dht_ptr->_ready_pulse = pulse;
+        return;
+    }
+    uint32 bin = pulse >> dht_ptr->_hist_shift;
+    if (bin >= DHT_HIST_BINS)
+        bin = DHT_HIST_BINS - 1;
+    dht_ptr->_frame_hist[bin]++;
+    if (pulse > dht_ptr->_bit_threshold)
+        dht_ptr->_data[dht_ptr->_bit_count / 8] |= (0x80 >> (dht_ptr->_bit_count % 8));
+    dht_ptr->_bit_count++;
+    if (dht_ptr->_bit_count == DHT_BITS)
+    {
+        // release the pin
+        gpio_pin_intr_state_set(gpio_NUM(dht_ptr->_pin), GPIO_PIN_INTR_DISABLE);
+        gpio_isr_detach(gpio_NUM(dht_ptr->_pin));
+        hw_vtimer_disarm(&(dht_ptr->_timeout_timer));
+        dio_post(SIG_DHT_READ_COMPLETED, dht_ptr);
+    }
+}
+
+static void IRAM dht_reading_timeout(Dht *dht_ptr)
+{
+    // release the pin
+    gpio_pin_intr_state_set(gpio_NUM(dht_ptr->_pin), GPIO_PIN_INTR_DISABLE);
+    gpio_isr_detach(gpio_NUM(dht_ptr->_pin));
+    dht_ptr->_ended_by_timeout = true;
+    dio_post(SIG_DHT_READ_COMPLETED, dht_ptr);
+}
+
 static void IRAM dht_start_completed(void *param)
 {
     // DEBUG
     // dht_start_sequence_completed = system_get_time();
     Dht *dht_ptr = (Dht *)param;
+    int idx;
     // start reading from DHT
     // configure Dx as input and set pullup
     PIN_FUNC_SELECT(gpio_MUX(dht_ptr->_pin), gpio_FUNC(dht_ptr->_pin));
     PIN_PULLUP_EN(gpio_MUX(dht_ptr->_pin));
     GPIO_DIS_OUTPUT(gpio_NUM(dht_ptr->_pin));
 
-    read_di_sequence(dht_ptr->_dht_in_sequence);
+    for (idx = 0; idx < 5; idx++)
+        dht_ptr->_data[idx] = 0;
+    dht_ptr->_edge_count = 0;
+    dht_ptr->_bit_count = 0;
+    dht_ptr->_ready_seen = false;
+    dht_ptr->_ready_pulse = 0;
+    dht_ptr->_ended_by_timeout = false;
+    // DHT edges are 20-30 us apart, timing them on CCOUNT keeps the isr short
+    dht_ptr->_ccount_mhz = system_get_cpu_freq();
+    dht_ptr->_bit_threshold = dht_ptr->_threshold_us * dht_ptr->_ccount_mhz;
+    dht_ptr->_hist_shift = dht_hist_shift(dht_ptr->_ccount_mhz);
+    for (idx = 0; idx < DHT_HIST_BINS; idx++)
+        dht_ptr->_frame_hist[idx] = 0;
+    hw_vtimer_arm(&(dht_ptr->_timeout_timer), DHT_READING_TIMEOUT_US);
+    gpio_isr_attach(gpio_NUM(dht_ptr->_pin), (void (*)(void *))dht_edge, dht_ptr);
+    gpio_pin_intr_state_set(gpio_NUM(dht_ptr->_pin), GPIO_PIN_INTR_ANYEDGE);
 
     // free output sequence
     // free_do_seq(dht_ptr->_dht_out_sequence);
@@ -208,7 +488,9 @@ static void IRAM dht_start_completed(void *param)
 
 static void IRAM dht_read(Dht *dht_ptr)
 {
-    dht_ptr->_reading_ongoing = true;
+    dht_ptr->_last_read_time = system_get_time();
+    dht_ptr->_read_attempted = true;
+    dht_ptr->_attempt_count++;
     // configure Dx as output and set it High
     PIN_FUNC_SELECT(gpio_MUX(dht_ptr->_pin), gpio_FUNC(dht_ptr->_pin));
     GPIO_OUTPUT_SET(gpio_NUM(dht_ptr->_pin), ESPBOT_HIGH);
@@ -222,30 +504,44 @@ static void IRAM dht_read(Dht *dht_ptr)
         {
             dia_error_evnt(DHT_READ_HEAP_EXHAUSTED, sizeof(struct do_seq));
             ERROR("dht_read heap exhausted %d", sizeof(struct do_seq));
+            dht_ptr->_reading_ongoing = false;
+            dht_bus_release(dht_ptr);
             return;
         }
         set_do_seq_cb(dht_ptr->_dht_out_sequence, dht_start_completed, (void *)dht_ptr, direct);
         out_seq_add(dht_ptr->_dht_out_sequence, ESPBOT_LOW, 1500);
         out_seq_add(dht_ptr->_dht_out_sequence, ESPBOT_HIGH, 10);
     }
-    // prepare input sequence (82 pulses)
-    if (!dht_ptr->_dht_in_sequence)
-    {
-        dht_ptr->_dht_in_sequence = new_di_seq(gpio_NUM(dht_ptr->_pin), 82, 100, TIMEOUT_MS);
-        if (dht_ptr->_dht_in_sequence == NULL)
-        {
-            dia_error_evnt(DHT_READ_HEAP_EXHAUSTED, sizeof(struct do_seq));
-            ERROR("dht_read heap exhausted %d", sizeof(struct di_seq));
-            return;
-        }
-        set_di_seq_cb(dht_ptr->_dht_in_sequence, dht_reading_completed, (void *)dht_ptr, task);
-    }
     // Send start sequence
     // DEBUG
     // dht_start_sequence = system_get_time();
     exe_do_seq_us(dht_ptr->_dht_out_sequence);
 }
 
+static void dht_read_when_ready(Dht *dht_ptr)
+{
+    uint32 elapsed = system_get_time() - dht_ptr->_last_read_time;
+    uint32 min_delay = dht_min_delay(dht_ptr->_type);
+    if (dht_ptr->_read_attempted && (elapsed < min_delay))
+    {
+        // too early for the sensor, wait
+        dht_ptr->_deferred_count++;
+        os_timer_arm(&(dht_ptr->_retry_timer), ((min_delay - elapsed) / 1000) + 1, 0);
+        return;
+    }
+    dht_bus_request(dht_ptr);
+}
+
+static void dht_start_reading(Dht *dht_ptr)
+{
+    // polling while a reading (or its retries) is ongoing
+    if (dht_ptr->_reading_ongoing)
+        return;
+    dht_ptr->_reading_ongoing = true;
+    dht_ptr->_retries = 0;
+    dht_read_when_ready(dht_ptr);
+}
+
 Dht::Dht(int pin,
          Dht_type type,
          int temperature_id,
@@ -261,74 +557,175 @@ Dht::Dht(int pin,
     _pin = pin;
     _type = type;
     _poll_interval = poll_interval;
-    _max_buffer_size = buffer_length;
-    // data buffers
-    _temperature_buffer = new int[_max_buffer_size];
-    if (_temperature_buffer == NULL)
+    sensor_poll_setfn(&_poll, (void (*)(void *))dht_start_reading, this);
+    _dht_out_sequence = NULL;
+    for (idx = 0; idx < DHT_HIST_BINS; idx++)
+        _hist[idx] = 0;
+    _threshold_us = DHT_BIT_THRESHOLD_US;
+    _zero_mean_us = 0;
+    _one_mean_us = 0;
+    _learnt_frames = 0;
+    _checksum_errors = 0;
+    _ccount_mhz = system_get_cpu_freq();
+    _hist_shift = dht_hist_shift(_ccount_mhz);
+    hw_vtimer_setfn(&_timeout_timer, (void (*)(void *))dht_reading_timeout, this);
+    dio_set_handler(SIG_DHT_READ_COMPLETED, dht_reading_completed);
+    _force_reading = false;
+    _force_reading_cb = NULL;
+    _force_reading_param = NULL;
+    _reading_ongoing = false;
+    _read_attempted = false;
+    _last_read_time = 0;
+    _retries = 0;
+    _attempt_count = 0;
+    _success_count = 0;
+    _retry_count = 0;
+    _failure_count = 0;
+    _deferred_count = 0;
+    os_timer_disarm(&_retry_timer);
+    os_timer_setfn(&_retry_timer, (os_timer_func_t *)dht_read_when_ready, this);
+    _bus_next = NULL;
+    _bus_queued = false;
+    _bus_request_time = 0;
+    bus_stats.sensors++;
+    // samples
+    // (everything the destructor touches is initialized by now)
+    if (!_samples.init(buffer_length, (_poll_interval / 1000)))
     {
-        dia_error_evnt(DHT_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(int)));
-        ERROR("Dht heap exhausted %d", (_max_buffer_size * sizeof(int)));
+        dia_error_evnt(DHT_HEAP_EXHAUSTED, (buffer_length * _samples.record_size()));
+        ERROR("Dht heap exhausted %d", (buffer_length * _samples.record_size()));
         return;
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _temperature_buffer[idx] = 0;
-    _humidity_buffer = new int[_max_buffer_size];
-    if (_humidity_buffer == NULL)
+    // setup polling
+    // (the scheduler staggers sensors created together)
+    if (_poll_interval > 0)
+        sensor_poll_start(&_poll, _poll_interval);
+    if (!sensor_register(&temperature) || !sensor_register(&humidity))
     {
-        dia_error_evnt(DHT_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(int)));
-        ERROR("Dht heap exhausted %d", (_max_buffer_size * sizeof(int)));
-        return;
+        dia_error_evnt(SENSOR_REGISTRY_FULL, _pin);
+        ERROR("Dht D%d sensor registry full", _pin);
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _humidity_buffer[idx] = 0;
-    _invalid_buffer = new bool[_max_buffer_size];
-    if (_invalid_buffer == NULL)
+}
+
+Dht::~Dht()
+{
+    sensor_unregister(&temperature);
+    sensor_unregister(&humidity);
+    sensor_poll_stop(&_poll);
+    os_timer_disarm(&_retry_timer);
+    hw_vtimer_disarm(&_timeout_timer);
+    if (_reading_ongoing)
     {
-        dia_error_evnt(DHT_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(int)));
-        ERROR("Dht heap exhausted %d", (_max_buffer_size * sizeof(bool)));
-        return;
+        gpio_pin_intr_state_set(gpio_NUM(_pin), GPIO_PIN_INTR_DISABLE);
+        gpio_isr_detach(gpio_NUM(_pin));
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _invalid_buffer[idx] = true;
-    _timestamp_buffer = new uint32_t[_max_buffer_size];
-    if (_timestamp_buffer == NULL)
+    dht_bus_leave(this);
+    bus_stats.sensors--;
+    // a completed reading still queued for the task must not reach a deleted sensor
+    dio_cancel(SIG_DHT_READ_COMPLETED, this);
+    if (_dht_out_sequence)
+        free_do_seq(_dht_out_sequence);
+}
+
+void Dht::get_classifier_stats(struct dht_classifier_stats *stats)
+{
+    int idx;
+    stats->learnt_frames = _learnt_frames;
+    stats->checksum_errors = _checksum_errors;
+    stats->threshold_us = _threshold_us;
+    stats->zero_mean_us = _zero_mean_us;
+    stats->one_mean_us = _one_mean_us;
+    stats->bin_width_ns = (1000 << _hist_shift) / _ccount_mhz;
+    for (idx = 0; idx < DHT_HIST_BINS; idx++)
+        stats->histogram[idx] = _hist[idx];
+}
+
+void Dht::get_reading_stats(struct dht_reading_stats *stats)
+{
+    stats->attempts = _attempt_count;
+    stats->successes = _success_count;
+    stats->retries = _retry_count;
+    stats->failures = _failure_count;
+    stats->deferred = _deferred_count;
+}
+
+// sample == NULL => not stored yet
+static void dht_fill_event(Dht *dht_ptr, sensors_event_t *event, int id, sensors_type_t type,
+                           struct dht_sample *sample, uint32 timestamp)
+{
+    float scale = (dht_ptr->_type == DHT11) ? 1.0f : 0.1f;
+    event->sensor_id = id;
+    event->type = type;
+    if (sample == NULL)
     {
-        dia_error_evnt(DHT_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(int)));
-        ERROR("Dht heap exhausted %d", (_max_buffer_size * sizeof(uint32_t)));
+        event->timestamp = 0;
+        event->invalid = true;
+        event->temperature = 0;
         return;
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _timestamp_buffer[idx] = 0;
-    _buffer_idx = 0;
+    event->timestamp = timestamp;
+    event->invalid = (sample->invalid != 0);
+    if (type == SENSOR_TYPE_TEMPERATURE)
+        event->temperature = ((float)sample->temperature * scale);
+    else
+        event->relative_humidity = ((float)sample->humidity * scale);
+}
 
-    _dht_out_sequence = NULL;
-    _dht_in_sequence = NULL;
-    _force_reading = false;
-    _force_reading_cb = NULL;
-    _force_reading_param = NULL;
-    _reading_ongoing = false;
-    // setup polling
-    os_timer_disarm(&_poll_timer);
-    os_timer_setfn(&_poll_timer, (os_timer_func_t *)dht_read, this);
-    if (_poll_interval > 0)
-        os_timer_arm(&_poll_timer, _poll_interval, 1);
+static void dht_get_event(Dht *dht_ptr, sensors_event_t *event, int idx, int id, sensors_type_t type)
+{
+    uint32 timestamp;
+    struct dht_sample *sample = dht_ptr->_samples.get(idx, &timestamp);
+    dht_fill_event(dht_ptr, event, id, type, sample, timestamp);
 }
 
-Dht::~Dht()
+static int dht_get_events(Dht *dht_ptr, sensors_event_t *events, int count, int offset, int id, sensors_type_t type)
 {
-    os_timer_disarm(&_poll_timer);
-    if (_dht_in_sequence)
-        free_di_seq(_dht_in_sequence);
-    if (_dht_out_sequence)
-        free_do_seq(_dht_out_sequence);
-    if (_temperature_buffer)
-        delete[] _temperature_buffer;
-    if (_humidity_buffer)
-        delete[] _humidity_buffer;
-    if (_invalid_buffer)
-        delete[] _invalid_buffer;
-    if (_timestamp_buffer)
-        delete[] _timestamp_buffer;
+    int idx;
+    uint32 timestamp;
+    struct dht_sample *sample;
+    // if the class was not properly allocated exit
+    if (!dht_ptr->_samples.allocated())
+        return 0;
+    if (offset < 0)
+        offset = 0;
+    if (count > (dht_ptr->_samples.size() - offset))
+        count = dht_ptr->_samples.size() - offset;
+    for (idx = 0; idx < count; idx++)
+    {
+        if (idx == 0)
+            sample = dht_ptr->_samples.get(offset, &timestamp);
+        else
+            sample = dht_ptr->_samples.older(offset + idx, &timestamp);
+        dht_fill_event(dht_ptr, &events[idx], id, type, sample, timestamp);
+    }
+    return (count > 0) ? count : 0;
+}
+
+static int dht_get_events_since(Dht *dht_ptr, sensors_event_t *events, int max_count, uint32_t timestamp, int id, sensors_type_t type)
+{
+    int idx;
+    uint32 sample_timestamp;
+    struct dht_sample *sample = dht_ptr->_samples.get(0, &sample_timestamp);
+    for (idx = 0; (idx < max_count) && sample; idx++)
+    {
+        if (sample_timestamp <= timestamp)
+            break;
+        dht_fill_event(dht_ptr, &events[idx], id, type, sample, sample_timestamp);
+        sample = dht_ptr->_samples.older(idx + 1, &sample_timestamp);
+    }
+    return idx;
+}
+
+static bool dht_enable_rollup(Dht *dht_ptr, SensorRollup *rollup, int minutes, int hours)
+{
+    float scale = (dht_ptr->_type == DHT11) ? 1.0f : 0.1f;
+    if (!rollup->init(scale, minutes, hours))
+    {
+        dia_error_evnt(DHT_HEAP_EXHAUSTED, ((minutes + hours) * (int)sizeof(struct sensor_rollup_record)));
+        ERROR("Dht rollup heap exhausted %d", ((minutes + hours) * (int)sizeof(struct sensor_rollup_record)));
+        return false;
+    }
+    return true;
 }
 
 Dht::Temperature::Temperature(Dht *parent, int id)
@@ -343,15 +740,13 @@ Dht::Temperature::~Temperature()
 
 int Dht::Temperature::get_max_events_count(void)
 {
-    return _parent->_max_buffer_size;
+    return _parent->_samples.size();
 }
 
 void Dht::Temperature::force_reading(void (*callback)(void *), void *param)
 {
     // if the class was not properly allocated exit
-    if ((_parent->_timestamp_buffer == NULL) ||
-        (_parent->_invalid_buffer == NULL) ||
-        (_parent->_temperature_buffer == NULL))
+    if (!_parent->_samples.allocated())
         return;
     _parent->_force_reading_cb = callback;
     _parent->_force_reading_param = param;
@@ -361,40 +756,30 @@ void Dht::Temperature::force_reading(void (*callback)(void *), void *param)
     if (!_parent->_reading_ongoing)
     {
         // stop_polling
-        os_timer_disarm(&_parent->_poll_timer);
-        dht_read(_parent);
+        sensor_poll_stop(&_parent->_poll);
+        dht_start_reading(_parent);
     }
 }
 
 void Dht::Temperature::getEvent(sensors_event_t *event, int idx)
 {
     os_memset(event, 0, sizeof(sensors_event_t));
-    event->sensor_id = _id;
-    event->type = SENSOR_TYPE_TEMPERATURE;
-    // find the idx element
-    int index = _parent->_buffer_idx;
-    while (idx > 0)
-    {
-        index = index - 1;
-        if (index < 0)
-            index = _parent->_max_buffer_size - 1;
-        idx--;
-    }
-    // if the class was not properly allocated exit
-    if ((_parent->_timestamp_buffer == NULL) ||
-        (_parent->_invalid_buffer == NULL) ||
-        (_parent->_temperature_buffer == NULL))
-        return;
-    event->timestamp = _parent->_timestamp_buffer[index];
-    event->invalid = _parent->_invalid_buffer[index];
-    switch (_parent->_type)
-    {
-    case DHT11:
-        event->temperature = (float)_parent->_temperature_buffer[index];
-    case DHT22:
-    case DHT21:
-        event->temperature = ((float)_parent->_temperature_buffer[index] * 0.1);
-    }
+    dht_get_event(_parent, event, idx, _id, SENSOR_TYPE_TEMPERATURE);
+}
+
+int Dht::Temperature::getEvents(sensors_event_t *events, int count, int offset)
+{
+    return dht_get_events(_parent, events, count, offset, _id, SENSOR_TYPE_TEMPERATURE);
+}
+
+int Dht::Temperature::getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp)
+{
+    return dht_get_events_since(_parent, events, max_count, timestamp, _id, SENSOR_TYPE_TEMPERATURE);
+}
+
+uint32 Dht::Temperature::getSequence(void)
+{
+    return _parent->_samples.pushed();
 }
 
 void Dht::Temperature::getSensor(sensor_t *sensor)
@@ -436,6 +821,32 @@ void Dht::Temperature::getSensor(sensor_t *sensor)
     }
 }
 
+bool Dht::Temperature::getStats(struct sensor_stats *stats)
+{
+    _parent->_temperature_stats.get(stats);
+    return true;
+}
+
+void Dht::Temperature::resetStats(void)
+{
+    _parent->_temperature_stats.reset();
+}
+
+void Dht::Temperature::setStatsWindow(int samples)
+{
+    _parent->_temperature_stats.set_window(samples);
+}
+
+bool Dht::Temperature::enableRollup(int minutes, int hours)
+{
+    return dht_enable_rollup(_parent, &_parent->_temperature_rollup, minutes, hours);
+}
+
+int Dht::Temperature::getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset)
+{
+    return _parent->_temperature_rollup.get_buckets(tier, buckets, count, offset);
+}
+
 Dht::Humidity::Humidity(Dht *parent, int id)
 {
     _parent = parent;
@@ -448,11 +859,14 @@ Dht::Humidity::~Humidity()
 
 int Dht::Humidity::get_max_events_count(void)
 {
-    return _parent->_max_buffer_size;
+    return _parent->_samples.size();
 }
 
 void Dht::Humidity::force_reading(void (*callback)(void *), void *param)
 {
+    // if the class was not properly allocated exit
+    if (!_parent->_samples.allocated())
+        return;
     _parent->_force_reading_cb = callback;
     _parent->_force_reading_param = param;
     _parent->_force_reading = true;
@@ -461,35 +875,30 @@ void Dht::Humidity::force_reading(void (*callback)(void *), void *param)
     if (!_parent->_reading_ongoing)
     {
         // stop_polling
-        os_timer_disarm(&_parent->_poll_timer);
-        dht_read(_parent);
+        sensor_poll_stop(&_parent->_poll);
+        dht_start_reading(_parent);
     }
 }
 
 void Dht::Humidity::getEvent(sensors_event_t *event, int idx)
 {
     os_memset(event, 0, sizeof(sensors_event_t));
-    event->sensor_id = _id;
-    event->type = SENSOR_TYPE_RELATIVE_HUMIDITY;
-    // find the idx element
-    int index = _parent->_buffer_idx;
-    while (idx > 0)
-    {
-        index = index - 1;
-        if (index < 0)
-            index = _parent->_max_buffer_size - 1;
-        idx--;
-    }
-    event->timestamp = _parent->_timestamp_buffer[index];
-    event->invalid = _parent->_invalid_buffer[index];
-    switch (_parent->_type)
-    {
-    case DHT11:
-        event->relative_humidity = (float)_parent->_humidity_buffer[index];
-    case DHT22:
-    case DHT21:
-        event->relative_humidity = ((float)_parent->_humidity_buffer[index] * 0.1);
-    }
+    dht_get_event(_parent, event, idx, _id, SENSOR_TYPE_RELATIVE_HUMIDITY);
+}
+
+int Dht::Humidity::getEvents(sensors_event_t *events, int count, int offset)
+{
+    return dht_get_events(_parent, events, count, offset, _id, SENSOR_TYPE_RELATIVE_HUMIDITY);
+}
+
+int Dht::Humidity::getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp)
+{
+    return dht_get_events_since(_parent, events, max_count, timestamp, _id, SENSOR_TYPE_RELATIVE_HUMIDITY);
+}
+
+uint32 Dht::Humidity::getSequence(void)
+{
+    return _parent->_samples.pushed();
 }
 
 void Dht::Humidity::getSensor(sensor_t *sensor)
@@ -529,4 +938,30 @@ void Dht::Humidity::getSensor(sensor_t *sensor)
         sensor->min_delay = 2000000L; // 2 seconds (in microseconds)
         break;
     }
-}
\ No newline at end of file
+}
+
+bool Dht::Humidity::getStats(struct sensor_stats *stats)
+{
+    _parent->_humidity_stats.get(stats);
+    return true;
+}
+
+void Dht::Humidity::resetStats(void)
+{
+    _parent->_humidity_stats.reset();
+}
+
+void Dht::Humidity::setStatsWindow(int samples)
+{
+    _parent->_humidity_stats.set_window(samples);
+}
+
+bool Dht::Humidity::enableRollup(int minutes, int hours)
+{
+    return dht_enable_rollup(_parent, &_parent->_humidity_rollup, minutes, hours);
+}
+
+int Dht::Humidity::getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset)
+{
+    return _parent->_humidity_rollup.get_buckets(tier, buckets, count, offset);
+}
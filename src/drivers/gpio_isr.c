@@ -0,0 +1,73 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+#include "c_types.h"
+#include "ets_sys.h"
+#include "gpio.h"
+#include "osapi.h"
+#include "espbot_mem_macros.h"
+#include "esp8266_intr.h"
+#include "drivers_gpio_isr.h"
+
+static struct
+{
+    void (*handler)(void *);
+    void *param;
+} gpio_handlers[GPIO_ISR_PINS];
+
+static bool gpio_isr_attached;
+
+static void IRAM gpio_isr_dispatch(void *arg)
+{
+    uint32 gpio_status;
+    int gpio;
+
+    // clear interrupt status (checkout sdk API docs)
+    gpio_status = GPIO_REG_READ(GPIO_STATUS_ADDRESS);
+    GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, gpio_status);
+
+    for (gpio = 0; (gpio < GPIO_ISR_PINS) && gpio_status; gpio++)
+    {
+        if ((gpio_status & BIT(gpio)) && gpio_handlers[gpio].handler)
+            gpio_handlers[gpio].handler(gpio_handlers[gpio].param);
+        gpio_status &= ~BIT(gpio);
+    }
+}
+
+void IRAM gpio_isr_attach(int gpio, void (*handler)(void *), void *param)
+{
+    uint32 ps;
+    if ((gpio < 0) || (gpio >= GPIO_ISR_PINS))
+        return;
+    // the GPIO interrupt mask is left as the caller set it (e.g. into a critical section)
+    ps = intr_lock();
+    gpio_handlers[gpio].handler = handler;
+    gpio_handlers[gpio].param = param;
+    intr_unlock(ps);
+    if (!gpio_isr_attached)
+    {
+        gpio_isr_attached = true;
+        ETS_GPIO_INTR_ATTACH((ets_isr_t)gpio_isr_dispatch, NULL);
+        ETS_GPIO_INTR_ENABLE();
+    }
+}
+
+void IRAM gpio_isr_detach(int gpio)
+{
+    uint32 ps;
+    if ((gpio < 0) || (gpio >= GPIO_ISR_PINS))
+        return;
+    ps = intr_lock();
+    // no more interrupts from the pin (and none pending)
+    gpio_pin_intr_state_set(gpio, GPIO_PIN_INTR_DISABLE);
+    GPIO_REG_WRITE(GPIO_STATUS_W1TC_ADDRESS, BIT(gpio));
+    gpio_handlers[gpio].handler = NULL;
+    gpio_handlers[gpio].param = NULL;
+    intr_unlock(ps);
+}
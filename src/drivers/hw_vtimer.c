@@ -0,0 +1,160 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+#include "c_types.h"
+#include "ets_sys.h"
+#include "osapi.h"
+#include "user_interface.h"
+#include "espbot_mem_macros.h"
+#include "driver_hw_timer.h"
+#include "drivers_hw_vtimer.h"
+
+static struct hw_vtimer *vtimer_queue;
+static bool frc1_initialized;
+static bool in_vtimer_isr;
+
+// deadlines wrap around with system_get_time (every 71 minutes)
+#define DEADLINE_BEFORE(a, b) (((sint32)((a) - (b))) < 0)
+
+static void IRAM vtimer_enqueue(struct hw_vtimer *timer)
+{
+    struct hw_vtimer **cur = &vtimer_queue;
+    // timers with the same deadline are served in arming order
+    while (*cur && !DEADLINE_BEFORE(timer->deadline, (*cur)->deadline))
+        cur = &((*cur)->next);
+    timer->next = *cur;
+    *cur = timer;
+    timer->armed = true;
+}
+
+static void IRAM vtimer_dequeue(struct hw_vtimer *timer)
+{
+    struct hw_vtimer **cur = &vtimer_queue;
+    while (*cur)
+    {
+        if (*cur == timer)
+        {
+            *cur = timer->next;
+            break;
+        }
+        cur = &((*cur)->next);
+    }
+    timer->next = NULL;
+    timer->armed = false;
+}
+
+// program FRC1 for the queue head
+static void IRAM frc1_program(void)
+{
+    sint32 delta;
+    if (vtimer_queue == NULL)
+    {
+        hw_timer_disarm();
+        return;
+    }
+    delta = (sint32)(vtimer_queue->deadline - system_get_time());
+    if (vtimer_queue->frc1_ticks && (delta >= (sint32)vtimer_queue->frc1_us))
+    {
+        hw_timer_load(vtimer_queue->frc1_ticks);
+        return;
+    }
+    if (delta < HW_VTIMER_MIN_US)
+        delta = HW_VTIMER_MIN_US;
+    if (delta > HW_VTIMER_MAX_US)
+        delta = HW_VTIMER_MAX_US;
+    hw_timer_arm((uint32)delta);
+}
+
+static void IRAM hw_vtimer_isr(void)
+{
+    struct hw_vtimer *timer;
+    sint32 delta;
+    in_vtimer_isr = true;
+    while (vtimer_queue)
+    {
+        delta = (sint32)(vtimer_queue->deadline - system_get_time());
+        if (delta >= HW_VTIMER_MIN_US)
+            break;
+        // too close for re-arming FRC1, waiting here
+        if (delta > HW_VTIMER_SLACK_US)
+            os_delay_us(delta - HW_VTIMER_SLACK_US);
+        timer = vtimer_queue;
+        vtimer_dequeue(timer);
+        if (timer->func)
+            timer->func(timer->param);
+    }
+    in_vtimer_isr = false;
+    frc1_program();
+}
+
+static void IRAM frc1_init(void)
+{
+    if (frc1_initialized)
+        return;
+    hw_timer_set_func(hw_vtimer_isr);
+    hw_timer_init(FRC1_SOURCE, 0);
+    frc1_initialized = true;
+}
+
+void IRAM hw_vtimer_setfn(struct hw_vtimer *timer, void (*func)(void *), void *param)
+{
+    timer->func = func;
+    timer->param = param;
+}
+
+static void IRAM vtimer_arm(struct hw_vtimer *timer, uint32 deadline)
+{
+    frc1_init();
+    if (!in_vtimer_isr)
+        ETS_FRC1_INTR_DISABLE();
+    if (timer->armed)
+        vtimer_dequeue(timer);
+    timer->deadline = deadline;
+    vtimer_enqueue(timer);
+    if (!in_vtimer_isr)
+    {
+        // the isr will program FRC1 when done with the expired timers
+        if (vtimer_queue == timer)
+            frc1_program();
+        ETS_FRC1_INTR_ENABLE();
+    }
+}
+
+void IRAM hw_vtimer_arm_at(struct hw_vtimer *timer, uint32 deadline)
+{
+    timer->frc1_ticks = 0;
+    vtimer_arm(timer, deadline);
+}
+
+void IRAM hw_vtimer_arm_at_ticks(struct hw_vtimer *timer, uint32 deadline, uint32 us, uint32 frc1_ticks)
+{
+    timer->frc1_us = us;
+    timer->frc1_ticks = frc1_ticks;
+    vtimer_arm(timer, deadline);
+}
+
+void IRAM hw_vtimer_arm(struct hw_vtimer *timer, uint32 us)
+{
+    hw_vtimer_arm_at(timer, system_get_time() + us);
+}
+
+void IRAM hw_vtimer_disarm(struct hw_vtimer *timer)
+{
+    if (!in_vtimer_isr)
+        ETS_FRC1_INTR_DISABLE();
+    if (timer->armed)
+    {
+        bool was_head = (vtimer_queue == timer);
+        vtimer_dequeue(timer);
+        if (was_head && !in_vtimer_isr)
+            frc1_program();
+    }
+    if (!in_vtimer_isr)
+        ETS_FRC1_INTR_ENABLE();
+}
@@ -11,8 +11,11 @@ extern "C"
 {
 #include "c_types.h"
 #include "osapi.h"
+#include "user_interface.h"
 #include "gpio.h"
 #include "esp8266_io.h"
+#include "esp8266_ccount.h"
+#include "esp8266_hspi.h"
 }
 
 #include "espbot_diagnostic.hpp"
@@ -21,13 +24,27 @@ extern "C"
 #include "drivers_event_codes.h"
 #include "drivers_max6675.hpp"
 
+static void max6675_restart_polling(Max6675 *max6675_ptr)
+{
+    // HSPI chips are polled by the bus
+    if (max6675_ptr->_read_mode == MAX6675_HSPI)
+        return;
+    if (max6675_ptr->_poll_interval > 0)
+        sensor_poll_start(&(max6675_ptr->_poll), max6675_ptr->_poll_interval);
+}
+
+// new sample listener (e.g. SensorLog)
+static void max6675_notify_sample(Max6675 *max6675_ptr)
+{
+    sensors_event_t event;
+    if (max6675_ptr->_sample_listener == NULL)
+        return;
+    max6675_ptr->getEvent(&event);
+    max6675_ptr->_sample_listener(max6675_ptr->_sample_listener_param, &event);
+}
+
 static void max6675_read_completed(Max6675 *max6675_ptr)
 {
-    int cur_pos;
-    if (max6675_ptr->_buffer_idx == (max6675_ptr->_max_buffer_size - 1))
-        cur_pos = 0;
-    else
-        cur_pos = max6675_ptr->_buffer_idx + 1;
     // check if the reading is valid
     // thermocouple disconnected => bit 2 is high
     if (max6675_ptr->_data & 0x0004)
@@ -37,17 +54,11 @@ static void max6675_read_completed(Max6675 *max6675_ptr)
               max6675_ptr->_cs,
               max6675_ptr->_sck,
               max6675_ptr->_so);
-        // set the value as invalid
-        max6675_ptr->_invalid_buffer[cur_pos] = true;
-        // set the timestamp
-        max6675_ptr->_timestamp_buffer[cur_pos] = timedate_get_timestamp();
-        // set the temperature to 0
-        max6675_ptr->_temperature_buffer[cur_pos] = 0;
-        // update the buffer position
-        if (max6675_ptr->_buffer_idx == (max6675_ptr->_max_buffer_size - 1))
-            max6675_ptr->_buffer_idx = 0;
-        else
-            max6675_ptr->_buffer_idx++;
+        // store an invalid value
+        uint32 timestamp = timedate_get_timestamp();
+        max6675_ptr->_samples.push(MAX6675_SAMPLE_INVALID, timestamp);
+        max6675_ptr->_stats.update_invalid(timestamp);
+        max6675_notify_sample(max6675_ptr);
         // done with reading
         max6675_ptr->_reading_ongoing = false;
         // still something to do if it was a force reading
@@ -55,26 +66,20 @@ static void max6675_read_completed(Max6675 *max6675_ptr)
         {
             max6675_ptr->_force_reading = false;
             // restart polling
-            os_timer_disarm(&(max6675_ptr->_poll_timer));
-            if (max6675_ptr->_poll_interval > 0)
-                os_timer_arm(&(max6675_ptr->_poll_timer), max6675_ptr->_poll_interval, 1);
+            max6675_restart_polling(max6675_ptr);
             // actually there was no reading but anyway ...
             if (max6675_ptr->_force_reading_cb)
                 max6675_ptr->_force_reading_cb(max6675_ptr->_force_reading_param);
         }
         return;
     }
-    // set the value as valid
-    max6675_ptr->_invalid_buffer[cur_pos] = false;
-    // set the timestamp
-    max6675_ptr->_timestamp_buffer[cur_pos] = timedate_get_timestamp();
-    // set the value bits: 12 bits from 3 to 14
-    max6675_ptr->_temperature_buffer[cur_pos] = (max6675_ptr->_data >> 3) & 0x0FFF;
-    // update the buffer position
-    if (max6675_ptr->_buffer_idx == (max6675_ptr->_max_buffer_size - 1))
-        max6675_ptr->_buffer_idx = 0;
-    else
-        max6675_ptr->_buffer_idx++;
+    // store the value bits: 12 bits from 3 to 14
+    uint16_t sample = ((max6675_ptr->_data >> 3) & 0x0FFF);
+    uint32 timestamp = timedate_get_timestamp();
+    max6675_ptr->_samples.push(sample, timestamp);
+    max6675_ptr->_stats.update(((float)sample * 0.25f), timestamp);
+    max6675_ptr->_rollup.update(((float)sample * 0.25f), timestamp);
+    max6675_notify_sample(max6675_ptr);
     // done with reading
     max6675_ptr->_reading_ongoing = false;
     // still something to do if it was a force reading
@@ -82,9 +87,7 @@ static void max6675_read_completed(Max6675 *max6675_ptr)
     {
         max6675_ptr->_force_reading = false;
         // restart polling
-        os_timer_disarm(&(max6675_ptr->_poll_timer));
-        if (max6675_ptr->_poll_interval > 0)
-            os_timer_arm(&(max6675_ptr->_poll_timer), max6675_ptr->_poll_interval, 1);
+        max6675_restart_polling(max6675_ptr);
 
         if (max6675_ptr->_force_reading_cb)
             max6675_ptr->_force_reading_cb(max6675_ptr->_force_reading_param);
@@ -134,18 +137,68 @@ static void max6675_read_bit(void *param)
     }
 }
 
+static void max6675_read_fast(Max6675 *max6675_ptr)
+{
+    // CS  _                                 _
+    //      |_____________________ .._______|
+    // SCK   _   _   _   _   _   _ ..  _   _
+    //     _| |_| |_| |_| |_| |_| |.._| |_| |_
+    //
+    // SO changes on SCK falling edges and is read while SCK is high
+    uint32 half_clock = (system_get_cpu_freq() * MAX6675_HALF_CLOCK_NS) / 1000;
+    uint32 sck_mask = max6675_ptr->_sck_mask;
+    uint32 so_mask = max6675_ptr->_so_mask;
+    uint32 data = 0;
+    uint32 edge;
+    int bit_idx;
+
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, max6675_ptr->_cs_mask);
+    edge = get_ccount();
+    for (bit_idx = 0; bit_idx < 16; bit_idx++)
+    {
+        while ((get_ccount() - edge) < half_clock)
+            ;
+        GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, sck_mask);
+        edge = get_ccount();
+        while ((get_ccount() - edge) < half_clock)
+            ;
+        data = (data << 1) | ((GPIO_REG_READ(GPIO_IN_ADDRESS) & so_mask) ? 1 : 0);
+        GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, sck_mask);
+        edge = get_ccount();
+    }
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, max6675_ptr->_cs_mask);
+    max6675_ptr->_data = data;
+}
+
 static void max6675_read(Max6675 *max6675_ptr)
 {
     max6675_ptr->_reading_ongoing = true;
-    // configure CS as output and set it LOW
-    PIN_FUNC_SELECT(gpio_MUX(max6675_ptr->_cs), gpio_FUNC(max6675_ptr->_cs));
-    GPIO_OUTPUT_SET(gpio_NUM(max6675_ptr->_cs), ESPBOT_LOW);
+    if (max6675_ptr->_read_mode == MAX6675_HSPI)
+    {
+        GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, max6675_ptr->_cs_mask);
+        max6675_ptr->_data = hspi_read16();
+        GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, max6675_ptr->_cs_mask);
+        max6675_ptr->_last_read_time = system_get_time();
+        max6675_ptr->_read_attempted = true;
+        max6675_read_completed(max6675_ptr);
+        return;
+    }
     // configure SCK as output and set it LOW
+    // (before CS goes low, a SCK falling edge would shift out the first bit)
     PIN_FUNC_SELECT(gpio_MUX(max6675_ptr->_sck), gpio_FUNC(max6675_ptr->_sck));
     GPIO_OUTPUT_SET(gpio_NUM(max6675_ptr->_sck), ESPBOT_LOW);
     // configure SO as input
     PIN_FUNC_SELECT(gpio_MUX(max6675_ptr->_so), gpio_FUNC(max6675_ptr->_so));
     GPIO_DIS_OUTPUT(gpio_NUM(max6675_ptr->_so));
+    if (max6675_ptr->_read_mode == MAX6675_FAST)
+    {
+        max6675_read_fast(max6675_ptr);
+        max6675_read_completed(max6675_ptr);
+        return;
+    }
+    // configure CS as output and set it LOW
+    PIN_FUNC_SELECT(gpio_MUX(max6675_ptr->_cs), gpio_FUNC(max6675_ptr->_cs));
+    GPIO_OUTPUT_SET(gpio_NUM(max6675_ptr->_cs), ESPBOT_LOW);
     // clear current readings
     max6675_ptr->_data = 0;
     max6675_ptr->_bit_counter = 0;
@@ -155,99 +208,208 @@ static void max6675_read(Max6675 *max6675_ptr)
     os_timer_arm(&(max6675_ptr->_read_timer), 5, 0);
 }
 
+//
+// HSPI bus
+//
+
+static Max6675 *hspi_chips;
+static bool hspi_ready;
+static struct sensor_poll hspi_poll;
+static int hspi_poll_interval;
+
+static void max6675_hspi_poll(void *param)
+{
+    Max6675 *chip;
+    uint32 elapsed_ms;
+    // the chips due within half a bus period are read now
+    for (chip = hspi_chips; chip; chip = chip->_bus_next)
+    {
+        if ((chip->_poll_interval == 0) || chip->_reading_ongoing)
+            continue;
+        elapsed_ms = (system_get_time() - chip->_last_read_time) / 1000;
+        if (chip->_read_attempted &&
+            ((elapsed_ms < MAX6675_CONVERSION_MS) ||
+             ((elapsed_ms + (hspi_poll_interval / 2)) < (uint32)chip->_poll_interval)))
+            continue;
+        max6675_read(chip);
+    }
+}
+
+static void max6675_hspi_bus_update(void)
+{
+    Max6675 *chip;
+    hspi_poll_interval = 0;
+    for (chip = hspi_chips; chip; chip = chip->_bus_next)
+        if ((chip->_poll_interval > 0) &&
+            ((hspi_poll_interval == 0) || (chip->_poll_interval < hspi_poll_interval)))
+            hspi_poll_interval = chip->_poll_interval;
+    if (hspi_poll_interval > 0)
+        sensor_poll_start(&hspi_poll, hspi_poll_interval);
+    else
+        sensor_poll_stop(&hspi_poll);
+}
+
+static void max6675_hspi_leave(Max6675 *max6675_ptr)
+{
+    Max6675 **cur = &hspi_chips;
+    while (*cur)
+    {
+        if (*cur == max6675_ptr)
+        {
+            *cur = max6675_ptr->_bus_next;
+            break;
+        }
+        cur = &((*cur)->_bus_next);
+    }
+    max6675_hspi_bus_update();
+}
+
+// force readings on HSPI wait for the conversion end
+static void max6675_start_reading(Max6675 *max6675_ptr)
+{
+    uint32 elapsed_ms = (system_get_time() - max6675_ptr->_last_read_time) / 1000;
+    if ((max6675_ptr->_read_mode == MAX6675_HSPI) &&
+        max6675_ptr->_read_attempted &&
+        (elapsed_ms < MAX6675_CONVERSION_MS))
+    {
+        max6675_ptr->_reading_ongoing = true;
+        os_timer_disarm(&(max6675_ptr->_read_timer));
+        os_timer_setfn(&(max6675_ptr->_read_timer), (os_timer_func_t *)max6675_read, (void *)max6675_ptr);
+        os_timer_arm(&(max6675_ptr->_read_timer), (MAX6675_CONVERSION_MS - elapsed_ms), 0);
+        return;
+    }
+    max6675_read(max6675_ptr);
+}
+
 Max6675::Max6675(int cs_pin,
                  int sck_pin,
                  int so_pin,
                  int id,
                  int poll_interval,
-                 int buffer_length)
+                 int buffer_length,
+                 Max6675_read_mode read_mode)
 {
     // init variables
-    int idx;
     _cs = cs_pin;
     _sck = sck_pin;
     _so = so_pin;
     _id = id;
+    _read_mode = read_mode;
+    _cs_mask = BIT(gpio_NUM(_cs));
+    _sck_mask = BIT(gpio_NUM(_sck));
+    _so_mask = BIT(gpio_NUM(_so));
 
     _poll_interval = poll_interval;
-    _max_buffer_size = buffer_length;
+    sensor_poll_setfn(&_poll, (void (*)(void *))max6675_read, this);
 
-    _temperature_buffer = new int[_max_buffer_size];
-    if (_temperature_buffer == NULL)
+    if (!_samples.init(buffer_length, (_poll_interval / 1000)))
     {
-        dia_error_evnt(MAX6675_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(int)));
+        dia_error_evnt(MAX6675_HEAP_EXHAUSTED, (buffer_length * _samples.record_size()));
         ERROR("MAX6675 [CS-D%d] [SCK-D%d] [SO-D%d] heap exhausted %d",
               _cs,
               _sck,
               _so,
-              (_max_buffer_size * sizeof(int)));
+              (buffer_length * _samples.record_size()));
         return;
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _temperature_buffer[idx] = 0;
-    _timestamp_buffer = new uint32_t[_max_buffer_size];
-    if (_timestamp_buffer == NULL)
+
+    _force_reading = false;
+    _reading_ongoing = false;
+    _bus_next = NULL;
+    _last_read_time = 0;
+    _read_attempted = false;
+
+    // set CS high
+    PIN_FUNC_SELECT(gpio_MUX(_cs), gpio_FUNC(_cs));
+    GPIO_OUTPUT_SET(gpio_NUM(_cs), ESPBOT_HIGH);
+    // set SCK low
+    PIN_FUNC_SELECT(gpio_MUX(_sck), gpio_FUNC(_sck));
+    GPIO_OUTPUT_SET(gpio_NUM(_sck), ESPBOT_LOW);
+    // start polling
+    if (_poll_interval > 0)
+        sensor_poll_start(&_poll, _poll_interval);
+    if (!sensor_register(this))
     {
-        dia_error_evnt(MAX6675_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(uint32_t)));
-        ERROR("MAX6675 [CS-D%d] [SCK-D%d] [SO-D%d] heap exhausted %d",
-              _cs,
-              _sck,
-              _so,
-              (_max_buffer_size * sizeof(uint32_t)));
-        return;
+        dia_error_evnt(SENSOR_REGISTRY_FULL, _id);
+        ERROR("MAX6675 [CS-D%d] sensor registry full", _cs);
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _timestamp_buffer[idx] = 0;
-    _invalid_buffer = new bool[_max_buffer_size];
-    if (_invalid_buffer == NULL)
+}
+
+Max6675::Max6675(int cs_pin,
+                 int id,
+                 int poll_interval,
+                 int buffer_length)
+{
+    // init variables
+    _cs = cs_pin;
+    _sck = ESPBOT_D5;
+    _so = ESPBOT_D6;
+    _id = id;
+    _read_mode = MAX6675_HSPI;
+    _cs_mask = BIT(gpio_NUM(_cs));
+    _sck_mask = BIT(gpio_NUM(_sck));
+    _so_mask = BIT(gpio_NUM(_so));
+
+    _poll_interval = poll_interval;
+    if ((_poll_interval > 0) && (_poll_interval < MAX6675_MIN_POLL_MS))
+        _poll_interval = MAX6675_MIN_POLL_MS;
+    sensor_poll_setfn(&_poll, NULL, NULL); // polled by the bus
+
+    if (!_samples.init(buffer_length, (_poll_interval / 1000)))
     {
-        dia_error_evnt(MAX6675_HEAP_EXHAUSTED, (_max_buffer_size * sizeof(bool)));
+        dia_error_evnt(MAX6675_HEAP_EXHAUSTED, (buffer_length * _samples.record_size()));
         ERROR("MAX6675 [CS-D%d] [SCK-D%d] [SO-D%d] heap exhausted %d",
               _cs,
               _sck,
               _so,
-              (_max_buffer_size * sizeof(bool)));
+              (buffer_length * _samples.record_size()));
         return;
     }
-    for (idx = 0; idx < _max_buffer_size; idx++)
-        _invalid_buffer[idx] = true;
-    _buffer_idx = 0;
 
     _force_reading = false;
     _reading_ongoing = false;
+    _last_read_time = 0;
+    _read_attempted = false;
 
     // set CS high
     PIN_FUNC_SELECT(gpio_MUX(_cs), gpio_FUNC(_cs));
     GPIO_OUTPUT_SET(gpio_NUM(_cs), ESPBOT_HIGH);
-    // start polling
-    os_timer_disarm(&_poll_timer);
-    os_timer_setfn(&_poll_timer, (os_timer_func_t *)max6675_read, this);
-    if (_poll_interval > 0)
-        os_timer_arm(&_poll_timer, _poll_interval, 1);
+    if (!hspi_ready)
+    {
+        sensor_poll_setfn(&hspi_poll, max6675_hspi_poll, NULL);
+        hspi_master_init();
+        hspi_ready = true;
+    }
+    // join the bus polling
+    _bus_next = hspi_chips;
+    hspi_chips = this;
+    max6675_hspi_bus_update();
+    if (!sensor_register(this))
+    {
+        dia_error_evnt(SENSOR_REGISTRY_FULL, _id);
+        ERROR("MAX6675 [CS-D%d] sensor registry full", _cs);
+    }
 }
 
 Max6675::~Max6675()
 {
-    os_timer_disarm(&_poll_timer);
-    if (_temperature_buffer)
-        delete[] _temperature_buffer;
-    if (_timestamp_buffer)
-        delete[] _timestamp_buffer;
-    if (_invalid_buffer)
-        delete[] _invalid_buffer;
+    sensor_unregister(this);
+    sensor_poll_stop(&_poll);
+    // SW_TIMER readings clock the bits and HSPI ones wait for the conversion on it
+    os_timer_disarm(&_read_timer);
+    if (_read_mode == MAX6675_HSPI)
+        max6675_hspi_leave(this);
 }
 
 int Max6675::get_max_events_count(void)
 {
-    return _max_buffer_size;
+    return _samples.size();
 }
 
 void Max6675::force_reading(void (*callback)(void *), void *param)
 {
     // if the class was not properly allocated exit
-    if ((_timestamp_buffer == NULL) ||
-        (_invalid_buffer == NULL) ||
-        (_temperature_buffer == NULL))
+    if (!_samples.allocated())
         return;
     _force_reading_cb = callback;
     _force_reading_param = param;
@@ -257,31 +419,78 @@ void Max6675::force_reading(void (*callback)(void *), void *param)
     if (!_reading_ongoing)
     {
         // stop_polling
-        os_timer_disarm(&_poll_timer);
-        max6675_read(this);
+        sensor_poll_stop(&_poll);
+        max6675_start_reading(this);
     }
 }
 
+// sample == NULL => not stored yet
+static void max6675_fill_event(sensors_event_t *event, int id, uint16_t *sample, uint32 timestamp)
+{
+    event->sensor_id = id;
+    event->type = SENSOR_TYPE_TEMPERATURE;
+    if (sample == NULL)
+    {
+        event->timestamp = 0;
+        event->invalid = true;
+        event->temperature = 0;
+        return;
+    }
+    event->timestamp = timestamp;
+    event->invalid = ((*sample & MAX6675_SAMPLE_INVALID) != 0);
+    event->temperature = ((float)(*sample & ~MAX6675_SAMPLE_INVALID) * 0.25f);
+}
+
 void Max6675::getEvent(sensors_event_t *event, int idx)
 {
+    uint32 timestamp;
     os_memset(event, 0, sizeof(sensors_event_t));
-    event->sensor_id = _id;
-    event->type = SENSOR_TYPE_TEMPERATURE;
     // find the idx element
-    int index = _buffer_idx;
-    while (idx > 0)
+    uint16_t *sample = _samples.get(idx, &timestamp);
+    max6675_fill_event(event, _id, sample, timestamp);
+}
+
+int Max6675::getEvents(sensors_event_t *events, int count, int offset)
+{
+    int idx;
+    uint32 timestamp;
+    uint16_t *sample;
+    // if the class was not properly allocated exit
+    if (!_samples.allocated())
+        return 0;
+    if (offset < 0)
+        offset = 0;
+    if (count > (_samples.size() - offset))
+        count = _samples.size() - offset;
+    for (idx = 0; idx < count; idx++)
     {
-        index = index - 1;
-        if (index < 0)
-            index = _max_buffer_size - 1;
-        idx--;
+        if (idx == 0)
+            sample = _samples.get(offset, &timestamp);
+        else
+            sample = _samples.older(offset + idx, &timestamp);
+        max6675_fill_event(&events[idx], _id, sample, timestamp);
     }
-    // if the class was not properly allocated exit
-    if ((_timestamp_buffer == NULL) || (_invalid_buffer == NULL) || (_temperature_buffer == NULL))
-        return;
-    event->timestamp = _timestamp_buffer[index];
-    event->invalid = _invalid_buffer[index];
-    event->temperature = ((float)_temperature_buffer[index] / 4);
+    return (count > 0) ? count : 0;
+}
+
+int Max6675::getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp)
+{
+    int idx;
+    uint32 sample_timestamp;
+    uint16_t *sample = _samples.get(0, &sample_timestamp);
+    for (idx = 0; (idx < max_count) && sample; idx++)
+    {
+        if (sample_timestamp <= timestamp)
+            break;
+        max6675_fill_event(&events[idx], _id, sample, sample_timestamp);
+        sample = _samples.older(idx + 1, &sample_timestamp);
+    }
+    return idx;
+}
+
+uint32 Max6675::getSequence(void)
+{
+    return _samples.pushed();
 }
 
 void Max6675::getSensor(sensor_t *sensor)
@@ -294,4 +503,36 @@ void Max6675::getSensor(sensor_t *sensor)
     sensor->min_value = 0.0;
     sensor->resolution = 0.25;
     sensor->min_delay = 85000L;
-}
\ No newline at end of file
+}
+
+bool Max6675::getStats(struct sensor_stats *stats)
+{
+    _stats.get(stats);
+    return true;
+}
+
+void Max6675::resetStats(void)
+{
+    _stats.reset();
+}
+
+void Max6675::setStatsWindow(int samples)
+{
+    _stats.set_window(samples);
+}
+
+bool Max6675::enableRollup(int minutes, int hours)
+{
+    if (!_rollup.init(0.25, minutes, hours))
+    {
+        dia_error_evnt(MAX6675_HEAP_EXHAUSTED, ((minutes + hours) * (int)sizeof(struct sensor_rollup_record)));
+        ERROR("MAX6675 [CS-D%d] rollup heap exhausted %d", _cs, ((minutes + hours) * (int)sizeof(struct sensor_rollup_record)));
+        return false;
+    }
+    return true;
+}
+
+int Max6675::getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset)
+{
+    return _rollup.get_buckets(tier, buckets, count, offset);
+}
@@ -0,0 +1,288 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+}
+
+#include "espbot_diagnostic.hpp"
+#include "espbot_spiffs.hpp"
+#include "drivers_event_codes.h"
+#include "drivers_sensor_log.hpp"
+
+#define SENSOR_LOG_RECORD_SIZE ((int)sizeof(struct sensor_log_record))
+
+// name is at least SENSOR_LOG_NAME_LEN + 3 chars
+static void sensor_log_file_name(SensorLog *log, int file, char *name)
+{
+    int len = os_strlen(log->_name);
+    os_memcpy(name, log->_name, len);
+    name[len] = '.';
+    name[len + 1] = '0' + file;
+    name[len + 2] = '\0';
+}
+
+static void sensor_log_rotate(SensorLog *log)
+{
+    char name[32];
+    log->_current = (log->_current + 1) % SENSOR_LOG_FILES;
+    sensor_log_file_name(log, log->_current, name);
+    Espfile file(name);
+    file.clear();
+    log->_records[log->_current] = 0;
+    log->_stats.rotations++;
+}
+
+// checking the files left by the previous boot (once, at construction)
+static void sensor_log_open(SensorLog *log)
+{
+    char name[32];
+    struct sensor_log_record first;
+    uint32 first_timestamp[SENSOR_LOG_FILES];
+    bool misaligned[SENSOR_LOG_FILES];
+    int size;
+    int idx;
+    log->_current = 0;
+    for (idx = 0; idx < SENSOR_LOG_FILES; idx++)
+    {
+        sensor_log_file_name(log, idx, name);
+        size = 0;
+        if (Espfile::exists(name))
+            size = Espfile::size(name);
+        if (size < 0)
+            size = 0;
+        log->_records[idx] = size / SENSOR_LOG_RECORD_SIZE;
+        misaligned[idx] = ((size % SENSOR_LOG_RECORD_SIZE) != 0);
+        first_timestamp[idx] = 0;
+        if (log->_records[idx] > 0)
+        {
+            Espfile file(name);
+            if (file.n_read((char *)&first, 0, SENSOR_LOG_RECORD_SIZE) == SENSOR_LOG_RECORD_SIZE)
+                first_timestamp[idx] = first.timestamp;
+        }
+        // the current file is the one with the newest records
+        if ((idx > 0) &&
+            (log->_records[idx] > 0) &&
+            ((log->_records[log->_current] == 0) ||
+             ((sint32)(first_timestamp[idx] - first_timestamp[log->_current]) > 0)))
+            log->_current = idx;
+    }
+    // a partial record (e.g. power loss while writing) would misalign the next ones
+    if (misaligned[log->_current])
+        sensor_log_rotate(log);
+}
+
+static void sensor_log_flush(SensorLog *log)
+{
+    char name[32];
+    s32_t res;
+    int len;
+    os_timer_disarm(&log->_flush_timer);
+    if (log->_buffered == 0)
+        return;
+    if ((log->_records[log->_current] > 0) &&
+        ((log->_records[log->_current] + log->_buffered) > log->_file_records))
+        sensor_log_rotate(log);
+    sensor_log_file_name(log, log->_current, name);
+    len = log->_buffered * SENSOR_LOG_RECORD_SIZE;
+    Espfile file(name);
+    res = file.n_append((char *)log->_buffer, len);
+    log->_stats.flushes++;
+    if (res == len)
+    {
+        log->_records[log->_current] += log->_buffered;
+    }
+    else
+    {
+        log->_stats.write_errors++;
+        log->_stats.dropped += log->_buffered;
+        dia_error_evnt(SENSOR_LOG_WRITE_ERROR, res);
+        ERROR("sensor log %s write error %d", name, res);
+        // a partial write would misalign the next records
+        if (res > 0)
+            sensor_log_rotate(log);
+    }
+    log->_buffered = 0;
+}
+
+static void sensor_log_listener(void *param, sensors_event_t *event)
+{
+    SensorLog *log = (SensorLog *)param;
+    log->append(event);
+}
+
+SensorLog::SensorLog(char *name, float scale, int file_size)
+{
+    os_memset(_name, 0, sizeof(_name));
+    os_strncpy(_name, name, SENSOR_LOG_NAME_LEN);
+    _scale = scale;
+    _buffer_len = LOG_PAGE_SIZE / SENSOR_LOG_RECORD_SIZE;
+    // at least a buffer per file
+    _file_records = file_size / SENSOR_LOG_RECORD_SIZE;
+    if (_file_records < _buffer_len)
+        _file_records = _buffer_len;
+    _current = 0;
+    os_memset(_records, 0, sizeof(_records));
+    _sensor = NULL;
+    _sensor_id = 0;
+    _buffered = 0;
+    os_memset(&_stats, 0, sizeof(_stats));
+    os_timer_disarm(&_flush_timer);
+    os_timer_setfn(&_flush_timer, (os_timer_func_t *)sensor_log_flush, this);
+    _buffer = new struct sensor_log_record[_buffer_len];
+    if (_buffer == NULL)
+    {
+        dia_error_evnt(SENSOR_LOG_HEAP_EXHAUSTED, LOG_PAGE_SIZE);
+        ERROR("sensor log %s heap exhausted %d", _name, LOG_PAGE_SIZE);
+    }
+    // count and read just use the records counters
+    sensor_log_open(this);
+}
+
+SensorLog::~SensorLog()
+{
+    detach();
+    if (_buffer)
+    {
+        sensor_log_flush(this);
+        delete[] _buffer;
+    }
+    os_timer_disarm(&_flush_timer);
+}
+
+void SensorLog::attach(Esp8266_Sensor *sensor)
+{
+    sensor_t info;
+    detach();
+    sensor->getSensor(&info);
+    _sensor = sensor;
+    _sensor_id = info.sensor_id;
+    _sensor->setSampleListener(sensor_log_listener, this);
+}
+
+void SensorLog::detach(void)
+{
+    if (_sensor == NULL)
+        return;
+    _sensor->setSampleListener(NULL, NULL);
+    _sensor = NULL;
+}
+
+static sint16 sensor_log_to_units(float value, float scale)
+{
+    float units = value / scale;
+    if (units > 32767)
+        return 32767;
+    if (units < -32768)
+        return -32768;
+    return (sint16)((units < 0) ? (units - 0.5f) : (units + 0.5f));
+}
+
+void SensorLog::append(sensors_event_t *event)
+{
+    struct sensor_log_record *record;
+    _stats.appended++;
+    if ((_buffer == NULL) || (_buffered >= _buffer_len))
+    {
+        // the flush timer did not run yet
+        _stats.dropped++;
+        return;
+    }
+    record = &_buffer[_buffered];
+    record->timestamp = event->timestamp;
+    record->value = sensor_log_to_units(event->temperature, _scale);
+    record->type = event->type;
+    record->flags = event->invalid ? SENSOR_LOG_INVALID : 0;
+    _buffered++;
+    if (_buffered == _buffer_len)
+    {
+        os_timer_disarm(&_flush_timer);
+        os_timer_arm(&_flush_timer, SENSOR_LOG_FLUSH_DELAY_MS, 0);
+    }
+    else if (_buffered == 1)
+    {
+        // the first buffered record is written within SENSOR_LOG_MAX_AGE_MS
+        os_timer_arm(&_flush_timer, SENSOR_LOG_MAX_AGE_MS, 0);
+    }
+}
+
+void SensorLog::flush(void)
+{
+    sensor_log_flush(this);
+}
+
+int SensorLog::count(void)
+{
+    int total = _buffered;
+    int idx;
+    for (idx = 0; idx < SENSOR_LOG_FILES; idx++)
+        total += _records[idx];
+    return total;
+}
+
+int SensorLog::read(int idx, struct sensor_log_record *records, int count)
+{
+    char name[32];
+    int done = 0;
+    int file;
+    int step;
+    int len;
+    s32_t res;
+    if (idx < 0)
+        return 0;
+    // oldest file first, the current one last
+    for (step = 1; (step <= SENSOR_LOG_FILES) && (done < count); step++)
+    {
+        file = (_current + step) % SENSOR_LOG_FILES;
+        if (idx >= _records[file])
+        {
+            idx -= _records[file];
+            continue;
+        }
+        len = _records[file] - idx;
+        if (len > (count - done))
+            len = count - done;
+        sensor_log_file_name(this, file, name);
+        Espfile log_file(name);
+        res = log_file.n_read((char *)&records[done], (idx * SENSOR_LOG_RECORD_SIZE), (len * SENSOR_LOG_RECORD_SIZE));
+        if (res < 0)
+            return done;
+        done += res / SENSOR_LOG_RECORD_SIZE;
+        if (res < (len * SENSOR_LOG_RECORD_SIZE))
+            return done;
+        idx = 0;
+    }
+    // then the buffered records
+    if ((done < count) && (idx < _buffered))
+    {
+        len = _buffered - idx;
+        if (len > (count - done))
+            len = count - done;
+        os_memcpy(&records[done], &_buffer[idx], (len * SENSOR_LOG_RECORD_SIZE));
+        done += len;
+    }
+    return done;
+}
+
+void SensorLog::fill_event(struct sensor_log_record *record, sensors_event_t *event)
+{
+    os_memset(event, 0, sizeof(sensors_event_t));
+    event->sensor_id = _sensor_id;
+    event->type = (sensors_type_t)record->type;
+    event->timestamp = record->timestamp;
+    event->invalid = ((record->flags & SENSOR_LOG_INVALID) != 0);
+    event->temperature = record->value * _scale;
+}
+
+void SensorLog::get_stats(struct sensor_log_stats *stats)
+{
+    os_memcpy(stats, &_stats, sizeof(struct sensor_log_stats));
+}
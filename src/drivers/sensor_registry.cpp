@@ -0,0 +1,256 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+#include "user_interface.h"
+}
+
+#include "drivers_sensor_registry.hpp"
+
+//
+// registry
+//
+
+static Esp8266_Sensor *sensors[SENSOR_REGISTRY_LEN];
+static int sensors_count;
+
+bool sensor_register(Esp8266_Sensor *sensor)
+{
+    int idx;
+    for (idx = 0; idx < sensors_count; idx++)
+        if (sensors[idx] == sensor)
+            return true;
+    if (sensors_count >= SENSOR_REGISTRY_LEN)
+        return false;
+    sensors[sensors_count] = sensor;
+    sensors_count++;
+    return true;
+}
+
+void sensor_unregister(Esp8266_Sensor *sensor)
+{
+    int idx;
+    for (idx = 0; idx < sensors_count; idx++)
+        if (sensors[idx] == sensor)
+            break;
+    if (idx >= sensors_count)
+        return;
+    // keep the registration order
+    for (; idx < (sensors_count - 1); idx++)
+        sensors[idx] = sensors[idx + 1];
+    sensors_count--;
+    sensors[sensors_count] = NULL;
+}
+
+int get_sensors_count(void)
+{
+    return sensors_count;
+}
+
+Esp8266_Sensor *get_sensor(int idx)
+{
+    if ((idx < 0) || (idx >= sensors_count))
+        return NULL;
+    return sensors[idx];
+}
+
+Esp8266_Sensor *get_sensor_by_id(int id)
+{
+    int idx;
+    sensor_t sensor;
+    for (idx = 0; idx < sensors_count; idx++)
+    {
+        sensors[idx]->getSensor(&sensor);
+        if (sensor.sensor_id == id)
+            return sensors[idx];
+    }
+    return NULL;
+}
+
+//
+// polling scheduler
+//
+
+static struct sensor_poll *poll_queue;
+static os_timer_t sched_timer;
+static bool sched_timer_initialized;
+static uint32 sched_ms;      // scheduler clock
+static uint32 sched_last_us; // system_get_time() at the last sched_ms update
+static uint32 last_dispatch; // sched_ms at the last poll function call
+static bool dispatched;
+static struct sensor_sched_stats sched_stats;
+
+// due times wrap around with the scheduler clock (every 49 days)
+#define DUE_BEFORE(a, b) (((sint32)((a) - (b))) < 0)
+
+// the timer is never armed longer than this, so that sched_now is read
+// at least once per system_get_time wrap whatever the poll periods
+#define SCHED_MAX_ARM_MS 60000
+
+// millisecond clock that does not wrap with system_get_time (every 71 minutes)
+// as long as it is read at least once per wrap (see SCHED_MAX_ARM_MS)
+static uint32 sched_now(void)
+{
+    uint32 elapsed_ms = (system_get_time() - sched_last_us) / 1000;
+    sched_ms += elapsed_ms;
+    sched_last_us += elapsed_ms * 1000;
+    return sched_ms;
+}
+
+static void poll_enqueue(struct sensor_poll *poll)
+{
+    struct sensor_poll **cur = &poll_queue;
+    // polls with the same due time are served in starting order
+    while (*cur && !DUE_BEFORE(poll->due, (*cur)->due))
+        cur = &((*cur)->next);
+    poll->next = *cur;
+    *cur = poll;
+}
+
+static void poll_dequeue(struct sensor_poll *poll)
+{
+    struct sensor_poll **cur = &poll_queue;
+    while (*cur)
+    {
+        if (*cur == poll)
+        {
+            *cur = poll->next;
+            break;
+        }
+        cur = &((*cur)->next);
+    }
+    poll->next = NULL;
+}
+
+// is any queued poll due less than a slot away from due?
+static bool poll_slot_busy(uint32 due)
+{
+    struct sensor_poll *cur;
+    for (cur = poll_queue; cur; cur = cur->next)
+    {
+        if (DUE_BEFORE(due, cur->due + SENSOR_POLL_SLOT_MS) && DUE_BEFORE(cur->due, due + SENSOR_POLL_SLOT_MS))
+            return true;
+    }
+    return false;
+}
+
+// the time the queue head will be dispatched
+static uint32 sched_next_dispatch(void)
+{
+    uint32 at = poll_queue->due;
+    if (dispatched && DUE_BEFORE(at, last_dispatch + SENSOR_POLL_SLOT_MS))
+        at = last_dispatch + SENSOR_POLL_SLOT_MS;
+    return at;
+}
+
+static void sched_run(void *);
+
+static void sched_program(void)
+{
+    uint32 now;
+    uint32 at;
+    if (!sched_timer_initialized)
+    {
+        os_timer_setfn(&sched_timer, (os_timer_func_t *)sched_run, NULL);
+        sched_timer_initialized = true;
+    }
+    os_timer_disarm(&sched_timer);
+    if (poll_queue == NULL)
+        return;
+    now = sched_now();
+    at = sched_next_dispatch();
+    if (DUE_BEFORE(now, at))
+        os_timer_arm(&sched_timer, (((at - now) > SCHED_MAX_ARM_MS) ? SCHED_MAX_ARM_MS : (at - now)), 0);
+    else
+        os_timer_arm(&sched_timer, 1, 0);
+}
+
+static void sched_run(void *)
+{
+    struct sensor_poll *poll = poll_queue;
+    uint32 now = sched_now();
+    uint32 delay;
+    if (poll == NULL)
+        return;
+    if (DUE_BEFORE(now, sched_next_dispatch()))
+    {
+        // a capped arm delay (or timer jitter), not due yet
+        sched_program();
+        return;
+    }
+    delay = now - poll->due;
+    if (delay > sched_stats.max_delay_ms)
+        sched_stats.max_delay_ms = delay;
+    if (dispatched && DUE_BEFORE(poll->due, last_dispatch + SENSOR_POLL_SLOT_MS))
+        sched_stats.shifted++;
+    // next poll one period after this due time
+    // (unless the poll is late for more than a period)
+    poll_dequeue(poll);
+    poll->due += poll->period;
+    if (DUE_BEFORE(poll->due, now))
+        poll->due = now + poll->period;
+    poll_enqueue(poll);
+    last_dispatch = now;
+    dispatched = true;
+    sched_stats.dispatched++;
+    if (poll->func)
+        poll->func(poll->param);
+    sched_program();
+}
+
+void sensor_poll_setfn(struct sensor_poll *poll, void (*func)(void *), void *param)
+{
+    poll->next = NULL;
+    poll->func = func;
+    poll->param = param;
+    poll->period = 0;
+    poll->due = 0;
+    poll->active = false;
+}
+
+void sensor_poll_start(struct sensor_poll *poll, uint32 period_ms)
+{
+    uint32 due;
+    uint32 shifts;
+    sensor_poll_stop(poll);
+    if (period_ms == 0)
+        return;
+    due = sched_now() + period_ms;
+    // staggering, without moving the first poll by more than a period
+    for (shifts = 0; shifts < (period_ms / SENSOR_POLL_SLOT_MS); shifts++)
+    {
+        if (!poll_slot_busy(due))
+            break;
+        due += SENSOR_POLL_SLOT_MS;
+    }
+    poll->period = period_ms;
+    poll->due = due;
+    poll->active = true;
+    poll_enqueue(poll);
+    sched_stats.active++;
+    sched_program();
+}
+
+void sensor_poll_stop(struct sensor_poll *poll)
+{
+    if (!poll->active)
+        return;
+    poll_dequeue(poll);
+    poll->active = false;
+    sched_stats.active--;
+    sched_program();
+}
+
+void get_sensor_sched_stats(struct sensor_sched_stats *stats)
+{
+    os_memcpy(stats, &sched_stats, sizeof(struct sensor_sched_stats));
+}
@@ -21,6 +21,7 @@
 
 #include "drivers_dht.hpp"
 #include "drivers_max6675.hpp"
+#include "drivers_sensor_log.hpp"
 void app_init_before_wifi(void);
 void app_init_after_wifi(void);
 void app_deinit_on_wifi_disconnect(void);
@@ -31,5 +32,6 @@ char *app_info_json_stringify(char *dest = NULL, int len = 0);
 
 extern Dht *dht22;
 extern Max6675 *max6675;
+extern SensorLog *dht22_temperature_log;
 
 #endif
\ No newline at end of file
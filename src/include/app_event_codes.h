@@ -12,5 +12,7 @@
 
 #define APP_INFO_STRINGIFY_HEAP_EXHAUSTED 0x01A0
 #define APP_RUNTEST_HEAP_EXHAUSTED 0x01A1
+#define APP_SENSOR_EXPORT_HEAP_EXHAUSTED 0x01A2
+#define APP_SENSOR_EXPORT_QUEUE_FULL 0x01A3
 
 #endif
\ No newline at end of file
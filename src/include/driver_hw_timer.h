@@ -66,4 +66,7 @@ void hw_timer_init(FRC1_TIMER_SOURCE_TYPE source_type, u8 req);
 void hw_timer_arm(uint32 val);
 void hw_timer_disarm(void);
 
+// loading FRC1 with ticks computed in advance (US_TO_RTC_TIMER_TICKS), no conversion
+#define hw_timer_load(ticks) RTC_REG_WRITE(FRC1_LOAD_ADDRESS, (ticks))
+
 #endif
\ No newline at end of file
@@ -19,10 +19,13 @@ extern "C"
 {
 #include "c_types.h"
 #include "osapi.h"
+#include "drivers_hw_vtimer.h"
 }
 
 #include "drivers_sensor.hpp"
 #include "drivers_common_types.hpp"
+#include "drivers_sensor_history.hpp"
+#include "drivers_sensor_registry.hpp"
 
 typedef enum
 {
@@ -32,6 +35,68 @@ typedef enum
   AM2301 = 21
 } Dht_type;
 
+#define DHT_HIST_BINS 16
+
+//
+// the bit classifier learns from checksum valid readings:
+// high pulse lengths go into a histogram (about 6.4 us bins), the histogram
+// is split in two classes (0 and 1) and the decision threshold is moved
+// halfway between the class means
+//
+struct dht_classifier_stats
+{
+  uint32 learnt_frames;   // checksum valid readings
+  uint32 checksum_errors;
+  uint32 threshold_us;
+  uint32 zero_mean_us;    // 0 when not learnt yet
+  uint32 one_mean_us;     // 0 when not learnt yet
+  uint32 bin_width_ns;
+  uint16 histogram[DHT_HIST_BINS];
+};
+
+//
+// failed readings (timeout or checksum error) are retried up to 2 times
+// waiting min_delay, then 2 * min_delay, before storing an invalid sample
+// readings never start closer than min_delay (polling and force_reading included)
+//
+struct dht_reading_stats
+{
+  uint32 attempts;  // sensor readings started
+  uint32 successes; // valid samples stored
+  uint32 retries;
+  uint32 failures;  // invalid samples stored (retries exhausted)
+  uint32 deferred;  // readings delayed for respecting min_delay
+};
+
+//
+// all the Dht instances share a bus manager:
+// readings are queued and executed one at a time (5 ms apart)
+// (polls are staggered by the sensor polling scheduler, see drivers_sensor_registry.hpp)
+//
+struct dht_bus_stats
+{
+  uint32 sensors;
+  uint32 readings;    // completed on the bus (retries included)
+  uint32 busy_ms;     // bus occupied time, busy_ms / uptime is the bus load
+  uint32 queued;      // readings that waited for the bus
+  uint32 max_queue;
+  uint32 max_wait_ms;
+};
+
+void get_dht_bus_stats(struct dht_bus_stats *stats);
+
+// stored sample, 3 bytes (4 with its timestamp delta, see drivers_sensor_history.hpp)
+// readings out of the field ranges are stored as invalid
+#define DHT_SAMPLE_TEMPERATURE_MAX 2047
+#define DHT_SAMPLE_HUMIDITY_MAX 2047
+
+struct dht_sample
+{
+  int32_t temperature : 12; // DHT11 Celsius, DHT21/DHT22 0.1 Celsius
+  uint32_t humidity : 11;   // DHT11 %, DHT21/DHT22 0.1 %
+  uint32_t invalid : 1;
+} __attribute__((packed));
+
 class Dht
 {
 public:
@@ -53,7 +118,15 @@ public:
     void force_reading(void (*callback)(void *), void *param);
     void getEvent(sensors_event_t *, int idx = 0); // idx = 0 => latest sample
                                                    // idx = 1 => previous sample
+    int getEvents(sensors_event_t *events, int count, int offset = 0);
+    int getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp);
+    uint32 getSequence(void);
     void getSensor(sensor_t *);
+    bool getStats(struct sensor_stats *stats);
+    void resetStats(void);
+    void setStatsWindow(int samples);
+    bool enableRollup(int minutes, int hours);
+    int getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset = 0);
 
   private:
     Dht *_parent;
@@ -71,7 +144,15 @@ public:
     void force_reading(void (*callback)(void *), void *param);
     void getEvent(sensors_event_t *, int idx = 0); // idx = 0 => latest sample
                                                    // idx = 1 => previous sample
+    int getEvents(sensors_event_t *events, int count, int offset = 0);
+    int getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp);
+    uint32 getSequence(void);
     void getSensor(sensor_t *);
+    bool getStats(struct sensor_stats *stats);
+    void resetStats(void);
+    void setStatsWindow(int samples);
+    bool enableRollup(int minutes, int hours);
+    int getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset = 0);
 
   private:
     Dht *_parent;
@@ -80,25 +161,59 @@ public:
 
   Humidity humidity;
 
+  void get_classifier_stats(struct dht_classifier_stats *);
+  void get_reading_stats(struct dht_reading_stats *);
+
   // this is private but into public section
   // for making variables accessible to timer callback functions
   uint8_t _data[5];
   int _pin;
   Dht_type _type;
   int _poll_interval;
-  os_timer_t _poll_timer;
+  struct sensor_poll _poll;
   struct do_seq *_dht_out_sequence;
-  struct di_seq *_dht_in_sequence;
-  int *_temperature_buffer;
-  int *_humidity_buffer;
-  bool *_invalid_buffer;
-  uint32_t *_timestamp_buffer;
-  int _max_buffer_size;
-  int _buffer_idx;
+  // reading state, bits are decoded by the edge isr as they arrive
+  struct hw_vtimer _timeout_timer;
+  uint32 _ccount_mhz;
+  uint32 _bit_threshold; // CCOUNT ticks, longer high pulses are 1
+  uint32 _hist_shift;    // CCOUNT ticks to histogram bin
+  uint8 _frame_hist[DHT_HIST_BINS];
+  // bit classifier
+  uint16 _hist[DHT_HIST_BINS];
+  uint32 _threshold_us;
+  uint32 _zero_mean_us;
+  uint32 _one_mean_us;
+  uint32 _learnt_frames;
+  uint32 _checksum_errors;
+  uint32 _last_edge;     // CCOUNT
+  uint32 _ready_pulse;   // CCOUNT ticks
+  int _edge_count;
+  int _bit_count;
+  bool _ready_seen;
+  bool _ended_by_timeout;
+  SensorHistory<struct dht_sample> _samples;
+  SensorStats _temperature_stats;
+  SensorStats _humidity_stats;
+  SensorRollup _temperature_rollup;
+  SensorRollup _humidity_rollup;
   bool _force_reading;
   void (*_force_reading_cb)(void *param);
   void *_force_reading_param;
   bool _reading_ongoing;
+  // reading scheduler
+  os_timer_t _retry_timer;
+  uint32 _last_read_time; // system_get_time() at last reading start
+  bool _read_attempted;
+  int _retries;
+  uint32 _attempt_count;
+  uint32 _success_count;
+  uint32 _retry_count;
+  uint32 _failure_count;
+  uint32 _deferred_count;
+  // bus manager
+  Dht *_bus_next;
+  bool _bus_queued;
+  uint32 _bus_request_time;
 };
 
 #endif
\ No newline at end of file
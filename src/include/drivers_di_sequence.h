@@ -10,6 +10,9 @@
 #define __DI_SEQUENCE_H__
 
 #include "drivers_dio_task.h"
+#include "drivers_hw_vtimer.h"
+
+#define DI_SEQ_LONG_GAPS 4 // compact storage: pulses longer than 65534 us kept at full length
 
 typedef enum
 {
@@ -17,6 +20,12 @@ typedef enum
     TIMEOUT_US
 } Di_timeout_unit;
 
+typedef enum
+{
+    TIMESTAMP_SYSTEM = 0, // system_get_time, 1 us resolution
+    TIMESTAMP_CCOUNT      // CPU cycle counter, 12.5 ns resolution at 80 MHz
+} Di_timestamp;
+
 struct di_seq
 {
     // please initialize these using new_di_seq
@@ -36,13 +45,47 @@ struct di_seq
 
     int current_pulse;
     os_timer_t timeout_timer;
+    struct hw_vtimer timeout_vtimer;
     bool ended_by_timeout;
     bool callback_direct;
+    Di_timestamp timestamp;
+    uint32 ccount_mhz;
+
+    // compact storage private members
+    // levels strictly alternate so only the first one is kept,
+    // pulse durations are 16 bits deltas (0xFFFF escapes to the long gaps table)
+    bool compact;
+    char start_level;
+    uint16 *pulse_delta;
+    uint32 last_edge_time;
+    int long_gap_count;
+    int long_gap_idx[DI_SEQ_LONG_GAPS];
+    uint32 long_gap_val[DI_SEQ_LONG_GAPS];
+    bool long_gap_overflow; // a long gap did not fit the table
+
+    // streaming mode private members
+    // pulse_level/pulse_duration are split into two halves:
+    // the isr fills one half while the task drains the other one
+    bool stream;
+    int stream_batch_size;
+    int stream_fill_half;
+    int stream_fill_count;
+    int stream_ready_half; // -1 => no half waiting for the task
+    int stream_ready_count;
+    uint32 stream_last_time;
+    char stream_last_level;
+    bool stream_first_edge;
+    // pulses lost because the task was still draining the other half
+    uint32 stream_overruns;
+    bool stream_flush_pending; // partial batch waiting for the task to release the other half
+    bool stream_handed_over;   // a batch was handed over since the last flush
+    bool stream_stopped;
 };
 
 //
 // the input sequence reading is surveilled by a timeout timer
 // the timeout timer can be set in ms or us
+// (us timeouts use a virtual HW timer, see drivers_hw_vtimer.h, so more readings can run at a time)
 // differences from the stop timeout function are meaningful
 // for the execution of the sequence end callback
 //   90-110 us when timeout timer is expressed in ms
@@ -50,18 +93,69 @@ struct di_seq
 //
 
 struct di_seq *new_di_seq(int pin, int num_pulses, int timeout_val, Di_timeout_unit timeout_unit); // allocating heap memory
+//
+// compact storage: same as new_di_seq using 2 bytes per pulse instead of 5
+// (a DHT reading takes 166 bytes instead of 415)
+// get_di_seq_pulse_level and get_di_seq_pulse_duration decode it transparently
+// pulses longer than 65534 us are kept at full length up to DI_SEQ_LONG_GAPS times,
+// further ones are reported as -1 (0xFFFFFFFF, like an idx out of the sequence)
+// and set seq->long_gap_overflow
+//
+struct di_seq *new_di_seq_compact(int pin, int num_pulses, int timeout_val, Di_timeout_unit timeout_unit);
 void free_di_seq(struct di_seq *seq);                                                              // freeing allocated memory
 void set_di_seq_cb(struct di_seq *seq, void (*cb)(void *), void *cb_param, CB_call_type cb_call);
 
 void seq_di_clear(struct di_seq *seq); // will clear the pulse sequence only
 
+//
+// edges are timestamped by default with system_get_time
+// TIMESTAMP_CCOUNT reads the CPU cycle counter instead: shorter isr and sub-microsecond resolution,
+// cycles are converted when reading the durations
+// (CCOUNT wraps every 53 s at 80 MHz so pulses must be shorter than that;
+//  compact sequences keep 16 bits of cycles, that is up to 819 us at 80 MHz
+//  before falling back to the long gaps table)
+//
+void set_di_seq_timestamp(struct di_seq *seq, Di_timestamp timestamp);
+
 int get_di_seq_length(struct di_seq *seq);
 char get_di_seq_pulse_level(struct di_seq *seq, int idx);
-uint32 get_di_seq_pulse_duration(struct di_seq *seq, int idx);
+uint32 get_di_seq_pulse_duration(struct di_seq *seq, int idx);    // microseconds
+uint32 get_di_seq_pulse_duration_ns(struct di_seq *seq, int idx); // nanoseconds (up to 4.29 s)
 
 void read_di_sequence(struct di_seq *seq);
 void stop_di_sequence_timeout(struct di_seq *seq);
 
+//
+// streaming mode
+//
+// open-ended capture: pulses are stored into a double buffer of 2 * batch_size
+// every time the isr fills a half it hands it over to the task and goes on with the other half
+// the sequence callback (set_di_seq_cb) is called for each batch, always from the task
+// (cb_call is ignored), use the get_di_seq_batch_* functions to read the batch
+// when flush_ms > 0 a partial batch is handed over if no batch was handed over
+// in the last flush_ms period (pulses wait at most about 2 * flush_ms),
+// while the task is still consuming the other half it is handed over at release
+// pulses arriving while both halves are full are counted into stream_overruns
+//
+// stop_di_seq_stream hands over the pending pulses calling the callback before
+// returning (from the batch callback: when the callback returns), no callback
+// follows then and the sequence can be freed (not from the batch callback)
+//
+// differently from the one-shot mode every element of a batch is a complete pulse
+// (level and duration), the first edge only marks the beginning of the first pulse
+//
+
+struct di_seq *new_di_seq_stream(int pin, int batch_size, int flush_ms); // allocating heap memory
+void read_di_seq_stream(struct di_seq *seq);
+void stop_di_seq_stream(struct di_seq *seq); // will hand over the pending pulses
+
+int get_di_seq_batch_length(struct di_seq *seq);
+char get_di_seq_batch_pulse_level(struct di_seq *seq, int idx);
+uint32 get_di_seq_batch_pulse_duration(struct di_seq *seq, int idx);
+uint32 get_di_seq_batch_pulse_duration_ns(struct di_seq *seq, int idx);
+
+void release_di_seq_batch(struct di_seq *seq); // used by dio_task once the batch was consumed
+
 //
 // ############################ EXAMPLE ##########################
 //
@@ -108,5 +202,27 @@ void stop_di_sequence_timeout(struct di_seq *seq);
 //     read_di_sequence(input_seq);
 //     ...
 // }
+//
+// ###################### STREAMING EXAMPLE ######################
+//
+// static void ICACHE_FLASH_ATTR input_batch_ready(void *param)
+// {
+//     struct di_seq *seq = (struct di_seq *)param;
+//     int idx;
+//     for (idx = 0; idx < get_di_seq_batch_length(seq); idx++)
+//         os_printf("pulse: level %d - duration %d\n",
+//                   get_di_seq_batch_pulse_level(seq, idx),
+//                   get_di_seq_batch_pulse_duration(seq, idx));
+// }
+//
+// {
+//     ...
+//     struct di_seq *input_stream = new_di_seq_stream(ESPBOT_D5_NUM, 32, 100);
+//     set_di_seq_cb(input_stream, input_batch_ready, (void *)input_stream, task);
+//     read_di_seq_stream(input_stream);
+//     ...
+//     stop_di_seq_stream(input_stream);
+//     ...
+// }
 
 #endif
\ No newline at end of file
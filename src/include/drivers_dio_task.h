@@ -9,9 +9,19 @@
 #ifndef __DIO_TASK_H__
 #define __DIO_TASK_H__
 
-#define DIO_TASK_QUEUE_LEN 4
+#include "c_types.h"
+
+#define DIO_TASK_QUEUE_LEN 2 // SDK task queue, just wakes up the task
+#define DIO_EVENT_RING_LEN 32
+#define DIO_SIGNALS 16
+
 #define SIG_DO_SEQ_COMPLETED 1
 #define SIG_DI_SEQ_COMPLETED 2
+#define SIG_DI_SEQ_BATCH 3
+#define SIG_DO_PSEQ_COMPLETED 4
+#define SIG_DHT_READ_COMPLETED 5
+#define SIG_DIO_USER 8 // first signal free for other drivers
+#define DIO_SIG_CANCELLED (-1) // events removed by dio_cancel
 
 typedef enum
 {
@@ -19,6 +29,30 @@ typedef enum
   task
 } CB_call_type;
 
+//
+// deferring work from isr (and timer functions) to the task
+//
+// dio_post queues a (signal, param) event into a preallocated ring,
+// the task calls the handler registered for the signal with param
+// events are handled in posting order
+// dio_post returns false when the ring is full (the event is lost and counted)
+//
+
+struct dio_task_stats
+{
+  uint32 posted;
+  uint32 handled;
+  uint32 overflows;  // events lost because the ring was full
+  uint32 unhandled;  // events with no handler registered
+  uint32 high_water; // max events waiting for the task
+  uint32 wake_up_failures; // task wake ups lost (SDK queue full), retried by the next dio_post
+};
+
 void init_dio_task(void);
+bool dio_set_handler(int sig, void (*handler)(void *)); // false when sig is out of range
+bool dio_post(int sig, void *param);                    // can be called from isr
+int dio_cancel(int sig, void *param);                   // removes the queued events of sig with param
+                                                        // (e.g. before freeing param), returns how many
+void get_dio_task_stats(struct dio_task_stats *stats);
 
-#endif
\ No newline at end of file
+#endif
@@ -10,6 +10,22 @@
 #define __DO_SEQUENCE_H__
 
 #include "drivers_dio_task.h"
+#include "drivers_hw_vtimer.h"
+
+#define DO_SEQ_REPEAT_FOREVER -1 // repeating until stop_do_seq
+#define DO_SEQ_SPIN_US 15 // compiled sequences: shorter pulses are busy waited inside the isr
+#define DO_SEQ_LEAD_US 5  // compiled sequences: the timer is loaded for this earlier than the edge
+#define DO_SEQ_SPIN_MAX_US 100 // compiled sequences: longest busy wait for consecutive short pulses
+
+// a compiled sequence step: GPIO register masks and precomputed pulse length
+struct do_seq_step
+{
+    uint32 w1ts;       // GPIO_OUT_W1TS mask
+    uint32 w1tc;       // GPIO_OUT_W1TC mask
+    uint32 duration;   // us
+    uint32 ticks;      // CCOUNT cycles (0 => longer than HW_VTIMER_MAX_US)
+    uint32 frc1_ticks; // FRC1 load for duration - DO_SEQ_LEAD_US (0 => busy waited or too long)
+};
 
 struct do_seq
 {
@@ -30,6 +46,22 @@ struct do_seq
     int current_pulse;
     int dig_output_initial_value;
     bool callback_direct;
+    struct hw_vtimer pulse_vtimer;
+    uint32 pulse_deadline;
+    // compiled waveform (see compile_do_seq)
+    struct do_seq_step *wave;
+    int wave_len;
+    uint32 wave_mhz;
+    uint32 wave_ccount;
+    bool wave_resync;
+    // repeating sequence (see set_do_seq_repeat)
+    int repeat_cycles;
+    int cycles_left;
+    bool stop_requested;
+    uint32 *pulse_duration_next;
+    struct do_seq_step *wave_next;
+    bool update_pending;
+    bool update_applied;
 };
 
 struct do_seq *new_do_seq(int pin, int num_pulses); // allocating heap memory
@@ -43,19 +75,125 @@ int get_do_seq_length(struct do_seq *seq);
 char get_do_seq_pulse_level(struct do_seq *seq, int idx);
 uint32 get_do_seq_pulse_duration(struct do_seq *seq, int idx);
 
+//
+// repeating sequences (software PWM, burst trains)
+//  - set_do_seq_repeat sets how many times the pulses are executed before
+//    restoring the output and calling the end sequence callback
+//    (0 and 1 mean once, DO_SEQ_REPEAT_FOREVER repeats until stop_do_seq)
+//  - cycles follow each other without gaps
+//  - stop_do_seq ends the sequence when the current cycle is completed
+//  - out_seq_update stages a new pulse duration, commit_do_seq_update swaps all the
+//    staged durations in at the next cycle boundary (e.g. changing PWM duty cycle)
+//    out_seq_update returns false when the previous commit is still pending
+//    or heap memory is exhausted
+//  - commit_do_seq_update compiles the staged durations of a compiled sequence
+//    (the isr only swaps buffers at the cycle boundary)
+//  - compiled repeating sequences need at least one pulse not shorter than DO_SEQ_SPIN_US
+//    (short pulses are busy waited inside the isr): set_do_seq_repeat, compile_do_seq
+//    and commit_do_seq_update return false (changing nothing) for a compiled sequence
+//    repeating more than once with all the pulses shorter than that
+//    or with the short pulses around the cycle boundary exceeding DO_SEQ_SPIN_MAX_US
+//    (commit_do_seq_update also returns false when nothing was staged
+//    or heap memory is exhausted)
+//
+
+bool set_do_seq_repeat(struct do_seq *seq, int cycles);
+void stop_do_seq(struct do_seq *seq);
+bool out_seq_update(struct do_seq *seq, int idx, uint32 duration);
+bool commit_do_seq_update(struct do_seq *seq);
+
 //
 // when using sequence with pulse duration in milliseconds please consider that
 //  - you are using an SW timers so you can run more than one sequence at a time
 //  - pulse duration range is from 5 ms to 6.870.947 ms
 //
 // when using sequence with pulse duration in microseconds please consider that
-//  - you are using an HW timer so you can run one sequence at a time
-//  - pulse duration range is from 10 us to 199.999 us
+//  - you are using a virtual HW timer (see drivers_hw_vtimer.h) so you can run
+//    more than one sequence at a time, the more sequences the more jitter
+//  - pulse duration range is from 10 us to 2.147.483.647 us
 //
 
 void exe_do_seq_ms(struct do_seq *seq);
 void exe_do_seq_us(struct do_seq *seq);
 
+//
+// compiling a sequence for the us execution
+//  - turns the pulses into GPIO register masks, CCOUNT ticks and FRC1 loads
+//    so that the isr only writes registers and reloads the timer
+//  - edges are timed on CCOUNT: less jitter
+//  - pulses shorter than DO_SEQ_SPIN_US are busy waited inside the isr
+//    so the minimum pulse duration is 1 us
+//  - per edge isr cost: the CCOUNT wait for the edge (the timer is loaded
+//    DO_SEQ_LEAD_US early, less the isr latency), two register writes, the virtual
+//    timer queue insertion and the FRC1 load (no us to ticks conversion);
+//    short pulses add their whole duration (up to DO_SEQ_SPIN_US) to the isr
+//  - consecutive short pulses are busy waited in the same isr run
+//    and cannot exceed DO_SEQ_SPIN_MAX_US altogether
+//  - pulses longer than HW_VTIMER_MAX_US are left to the virtual timer
+//    and only their last us is timed on CCOUNT (that wraps in 26 s at 160 MHz)
+//    so the whole us duration range is available
+//  - exe_do_seq_us runs the compiled waveform when available
+//  - out_seq_clear and out_seq_add drop the compiled waveform, compile again after changes
+//
+// return false when heap memory is exhausted, consecutive short pulses exceed
+// DO_SEQ_SPIN_MAX_US or the sequence repeats with all the pulses shorter than
+// DO_SEQ_SPIN_US (see set_do_seq_repeat)
+//
+
+bool compile_do_seq(struct do_seq *seq);
+
+//
+// parallel output sequences
+//
+// each step sets all the pins of pin_mask at once (one W1TS and one W1TC write)
+// so that the pins switch together: strobe + data lines, H-bridge pairs, ...
+// value_mask bits select the level of each pin (pins outside pin_mask are ignored)
+//
+// the ms execution uses an SW timer, the us execution uses a virtual HW timer
+// with the same timing as compiled sequences (see compile_do_seq),
+// keep consecutive steps shorter than DO_SEQ_SPIN_US within DO_SEQ_SPIN_MAX_US
+// at sequence end the pins are restored to their initial levels
+// and the callback is called (directly or through the task)
+//
+
+struct do_pseq
+{
+    // please initialize these using new_do_pseq
+    uint32 pin_mask;
+    int step_max_count;
+    // please initialize these using set_do_pseq_cb
+    void (*end_sequence_callack)(void *);
+    void *end_sequence_callack_param;
+
+    // initialize the sequence steps using out_pseq_add
+    struct do_seq_step *steps;
+
+    // do not initialize these are private members
+    int step_count;
+    os_timer_t step_timer;
+    struct hw_vtimer step_vtimer;
+    int current_step;
+    uint32 initial_value;
+    bool callback_direct;
+    uint32 step_deadline;
+    uint32 step_ccount;
+    bool step_resync;
+    uint32 steps_mhz;
+};
+
+struct do_pseq *new_do_pseq(uint32 pin_mask, int num_steps); // allocating heap memory
+void free_do_pseq(struct do_pseq *seq);                      // freeing allocated memory
+void set_do_pseq_cb(struct do_pseq *seq, void (*cb)(void *), void *cb_param, CB_call_type cb_call);
+
+void out_pseq_clear(struct do_pseq *seq);
+void out_pseq_add(struct do_pseq *seq, uint32 value_mask, uint32 duration);
+int get_do_pseq_length(struct do_pseq *seq);
+uint32 get_do_pseq_step_value(struct do_pseq *seq, int idx);
+uint32 get_do_pseq_step_duration(struct do_pseq *seq, int idx);
+
+void exe_do_pseq_ms(struct do_pseq *seq);
+void exe_do_pseq_us(struct do_pseq *seq);
+
 //
 // ############################ EXAMPLE ##########################
 //
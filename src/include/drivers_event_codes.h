@@ -17,4 +17,9 @@
 #define MAX6675_THERMOCOUPLE_DISCONNECTED 0x5004
 #define MAX6675_HEAP_EXHAUSTED 0x5005
 
+#define SENSOR_LOG_HEAP_EXHAUSTED 0x5006
+#define SENSOR_LOG_WRITE_ERROR 0x5007
+
+#define SENSOR_REGISTRY_FULL 0x5008
+
 #endif
\ No newline at end of file
@@ -0,0 +1,31 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __GPIO_ISR_H__
+#define __GPIO_ISR_H__
+
+#define GPIO_ISR_PINS 16 // GPIO0 .. GPIO15
+
+//
+// the GPIO interrupt is shared by all the pins
+// a single isr reads and clears GPIO_STATUS and calls the handler
+// attached to each pin that raised the interrupt
+// (handlers don't have to clear the interrupt status)
+//
+// gpio is the gpio number (e.g. ESPBOT_D5_NUM)
+// attaching a handler to a pin replaces the previous one
+// the pin interrupt type is still set with gpio_pin_intr_state_set
+// the first attach unmasks the GPIO interrupt, later ones don't touch the mask
+// (ETS_GPIO_INTR_DISABLE critical sections are preserved)
+// detaching disables the pin interrupt type and clears its pending status
+//
+
+void gpio_isr_attach(int gpio, void (*handler)(void *), void *param);
+void gpio_isr_detach(int gpio);
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __HW_VTIMER_H__
+#define __HW_VTIMER_H__
+
+//
+// virtual hw timers
+//
+// the FRC1 hw timer is a single resource, virtual timers share it:
+// armed timers are kept into a deadline sorted queue and FRC1 is re-armed
+// for the nearest deadline (deadlines are system_get_time() values)
+//
+// the timer functions are called from the FRC1 isr
+// a timer function can re-arm its own timer or arm/disarm other timers
+//
+// once a virtual timer is used the drivers own FRC1:
+// don't call hw_timer_set_func/hw_timer_init directly
+//
+
+#define HW_VTIMER_SLACK_US 2     // deadlines this close are served at once
+#define HW_VTIMER_MIN_US 10      // shortest FRC1 arming, closer deadlines are waited by the isr
+#define HW_VTIMER_MAX_US 1000000 // longest FRC1 arming, longer deadlines will take more isr runs
+
+struct hw_vtimer
+{
+    // do not initialize these are private members
+    struct hw_vtimer *next;
+    uint32 deadline;
+    void (*func)(void *);
+    void *param;
+    bool armed;
+    uint32 frc1_us;    // hw_vtimer_arm_at_ticks
+    uint32 frc1_ticks; // 0 => FRC1 load computed from the deadline
+};
+
+void hw_vtimer_setfn(struct hw_vtimer *timer, void (*func)(void *), void *param);
+void hw_vtimer_arm(struct hw_vtimer *timer, uint32 us);          // us from now
+void hw_vtimer_arm_at(struct hw_vtimer *timer, uint32 deadline); // system_get_time() value
+void hw_vtimer_disarm(struct hw_vtimer *timer);
+
+//
+// arming with a FRC1 load precomputed by the caller: frc1_ticks = US_TO_RTC_TIMER_TICKS(us)
+// (e.g. compiled output sequences, see compile_do_seq)
+// FRC1 is loaded with frc1_ticks as is (no us to ticks conversion) when it is
+// programmed at least us before the deadline, so the isr can come up to
+// the programming delay early and waits for the deadline (us >= HW_VTIMER_MIN_US)
+// otherwise the FRC1 load is computed from the deadline as usual
+//
+void hw_vtimer_arm_at_ticks(struct hw_vtimer *timer, uint32 deadline, uint32 us, uint32 frc1_ticks);
+
+#endif
@@ -17,6 +17,39 @@ extern "C"
 }
 
 #include "drivers_sensor.hpp"
+#include "drivers_sensor_history.hpp"
+#include "drivers_sensor_registry.hpp"
+
+//
+// reading modes
+//  MAX6675_FAST     => the 16 bits are clocked in a busy loop
+//                      (SCK about 3 MHz, a reading takes less than 15 us)
+//  MAX6675_SW_TIMER => every SCK half period is a 5 ms SW timer
+//                      (a reading takes 160 ms, for long wires)
+//  MAX6675_HSPI     => HSPI peripheral, see the HSPI constructor
+//
+typedef enum
+{
+  MAX6675_FAST = 0,
+  MAX6675_SW_TIMER,
+  MAX6675_HSPI
+} Max6675_read_mode;
+
+#define MAX6675_HALF_CLOCK_NS 150 // fast reading SCK high and low time (datasheet min 100 ns)
+#define MAX6675_CONVERSION_MS 220 // a reading (CS low) restarts the conversion
+#define MAX6675_MIN_POLL_MS 250   // HSPI poll interval lower bound (conversion plus timer jitter)
+
+//
+// HSPI chips share SCK (D5) and SO (D6) and have their own CS
+// the bus polls all the chips back to back from a single scheduler poll
+// (period is the shortest chip poll interval) and never reads a chip
+// closer than MAX6675_CONVERSION_MS: poll intervals are at least MAX6675_MIN_POLL_MS
+// and force readings wait for the conversion end
+//
+
+// stored sample: temperature in 0.25 Celsius and invalid flag
+// (3 bytes with its timestamp delta, see drivers_sensor_history.hpp)
+#define MAX6675_SAMPLE_INVALID 0x8000
 
 class Max6675 : public Esp8266_Sensor
 {
@@ -27,14 +60,27 @@ public:
   // id               => sensor indentifier
   // poll_interval    => in milliseconds (0 -> no polling)
   // buffer_length    => max number of stored readings  
-  Max6675(int cs_pin, int sck_pin, int so_pin, int id, int poll_interval, int buffer_length);
+  // read_mode        => MAX6675_FAST or MAX6675_SW_TIMER
+  Max6675(int cs_pin, int sck_pin, int so_pin, int id, int poll_interval, int buffer_length,
+          Max6675_read_mode read_mode = MAX6675_FAST);
+  // HSPI: SCK => D5, SO => D6
+  // cs_pin           => the gpio pin for CS (D5 and D6 excluded)
+  Max6675(int cs_pin, int id, int poll_interval, int buffer_length);
   ~Max6675();
 
   int get_max_events_count(void);
   void force_reading(void (*callback)(void *), void *param);
   void getEvent(sensors_event_t *, int idx = 0); // idx = 0 => latest sample
                                                  // idx = 1 => previous sample
+  int getEvents(sensors_event_t *events, int count, int offset = 0);
+  int getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp);
+  uint32 getSequence(void);
   void getSensor(sensor_t *);
+  bool getStats(struct sensor_stats *stats);
+  void resetStats(void);
+  void setStatsWindow(int samples);
+  bool enableRollup(int minutes, int hours);
+  int getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset = 0);
 
   // this is private but into public section
   // for easy access from timer callback functions
@@ -44,18 +90,24 @@ public:
   int _sck;
   int _so;
   int _bit_counter;
+  Max6675_read_mode _read_mode;
+  uint32 _cs_mask;
+  uint32 _sck_mask;
+  uint32 _so_mask;
   os_timer_t _read_timer;
   int _poll_interval;
-  os_timer_t _poll_timer;
-  int *_temperature_buffer;
-  uint32_t *_timestamp_buffer;
-  bool *_invalid_buffer;
-  int _max_buffer_size;
-  int _buffer_idx;
+  struct sensor_poll _poll;
+  SensorHistory<uint16_t> _samples;
+  SensorStats _stats;
+  SensorRollup _rollup;
   bool _force_reading;
   void (*_force_reading_cb)(void *param);
   void *_force_reading_param;
   bool _reading_ongoing;
+  // HSPI bus
+  Max6675 *_bus_next;
+  uint32 _last_read_time; // system_get_time() at last reading
+  bool _read_attempted;
 };
 
 #endif
\ No newline at end of file
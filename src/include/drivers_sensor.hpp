@@ -13,6 +13,10 @@ extern "C"
 {
 #include "c_types.h"
 }
+
+#include "drivers_sensor_stats.hpp"
+#include "drivers_sensor_rollup.hpp"
+
 // Sensor types
 typedef enum
 {
@@ -49,7 +53,7 @@ typedef struct
 class Esp8266_Sensor
 {
   public:
-    Esp8266_Sensor() {}
+    Esp8266_Sensor() : _sample_listener(NULL), _sample_listener_param(NULL) {}
     virtual ~Esp8266_Sensor() {}
 
     virtual void getSensor(sensor_t *) = 0;
@@ -58,6 +62,75 @@ class Esp8266_Sensor
                                                                // idx = 1 => previous event
                                                                // ...
     virtual void force_reading(void (*callback)(void *), void *param) = 0;
+
+    // bulk history reading
+    // getEvents fills events with count events starting from offset
+    //   (events[0] <= getEvent(offset), events[1] <= getEvent(offset + 1), ...)
+    // getEventsSince fills events with the events newer than timestamp (latest first)
+    //   up to max_count
+    // both return the number of events filled
+    // sensors can override them reading their history in a single pass
+    virtual int getEvents(sensors_event_t *events, int count, int offset = 0)
+    {
+        int idx;
+        int max_count = get_max_events_count();
+        if (offset < 0)
+            offset = 0;
+        if (count > (max_count - offset))
+            count = max_count - offset;
+        for (idx = 0; idx < count; idx++)
+            getEvent(&events[idx], offset + idx);
+        return (count > 0) ? count : 0;
+    }
+
+    virtual int getEventsSince(sensors_event_t *events, int max_count, uint32_t timestamp)
+    {
+        int idx;
+        int events_count = get_max_events_count();
+        if (max_count > events_count)
+            max_count = events_count;
+        for (idx = 0; idx < max_count; idx++)
+        {
+            getEvent(&events[idx], idx);
+            if (events[idx].timestamp <= timestamp)
+                break;
+        }
+        return idx;
+    }
+
+    // samples stored since the sensor creation (wraps at 2^32):
+    // a new sample moves the stored ones one idx ahead even when its timestamp
+    // is the same as the previous one (e.g. for resuming a history reading)
+    // 0 when the sensor does not count them
+    virtual uint32 getSequence(void) { return 0; }
+
+    // streaming statistics of the sensor samples (see drivers_sensor_stats.hpp)
+    // getStats returns false when the sensor does not keep them
+    virtual bool getStats(struct sensor_stats *stats) { return false; }
+    virtual void resetStats(void) {}
+    virtual void setStatsWindow(int samples) {} // EWMA window
+
+    // minute and hour buckets history (see drivers_sensor_rollup.hpp)
+    // enableRollup allocates minutes + hours buckets,
+    //   returns false when heap is exhausted or the sensor does not keep them
+    // getRollup fills buckets with count buckets of tier starting from offset
+    //   (offset = 0 => open bucket) and returns the number of buckets filled
+    virtual bool enableRollup(int minutes, int hours) { return false; }
+    virtual int getRollup(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset = 0) { return 0; }
+
+    // new samples listener (e.g. SensorLog)
+    // the driver calls it from its completion path with every stored sample,
+    // it must be short (no flash access)
+    void setSampleListener(void (*listener)(void *param, sensors_event_t *event), void *param)
+    {
+        _sample_listener = listener;
+        _sample_listener_param = param;
+    }
+
+    // this is private but into public section
+    // for easy access from the drivers completion path
+    void (*_sample_listener)(void *param, sensors_event_t *event);
+    void *_sample_listener_param;
 };
 
 #endif
\ No newline at end of file
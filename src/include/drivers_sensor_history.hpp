@@ -0,0 +1,187 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_HISTORY_HPP__
+#define __SENSOR_HISTORY_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+#include "drivers_sensor_ring.hpp"
+
+//
+// compact sensor samples history
+//
+// every sample is stored as a packed value V (e.g. int16 fixed point, invalid flag
+// in a spare bit) plus one byte: the seconds elapsed since the previous sample,
+// minus a base derived from the poll period (base = period - 127, or 0 for
+// periods up to 127 s), so polled samples fit whatever the period
+// a delta out of the byte range (force readings, gaps, clock changes) is stored
+// as SENSOR_HISTORY_ESCAPE and the full timestamp of the sample before it is
+// kept as an anchor
+// an anchor is kept for every SENSOR_HISTORY_GROUP samples too, so that
+//   - get(idx) finds the nearest following anchor (binary search) and rebuilds
+//     the timestamp with at most SENSOR_HISTORY_GROUP - 1 subtractions
+//   - older(idx) walks the history backwards with one subtraction per sample
+//
+// anchors are stored in a ring of size / (SENSOR_HISTORY_GROUP / 2) + 2 records
+// (room for as many escapes as periodic anchors), when an anchor is overwritten
+// the samples before it are dropped from the history (count() < size())
+//
+
+#define SENSOR_HISTORY_GROUP 32
+#define SENSOR_HISTORY_ESCAPE 0xFF
+
+struct sensor_history_anchor
+{
+  uint32 sample; // sample sequence number
+  uint32 timestamp;
+};
+
+template <typename V>
+class SensorHistory
+{
+public:
+  SensorHistory() : _base(0), _pushed(0), _floor(0), _latest_timestamp(0) {}
+  ~SensorHistory() {}
+
+  // allocating heap memory
+  // period => the poll period in seconds (0 -> no polling)
+  // return false when heap memory is exhausted
+  bool init(int size, uint32 period = 0)
+  {
+    struct sensor_history_anchor empty = {0, 0};
+    _base = (period > 127) ? (period - 127) : 0;
+    _pushed = 0;
+    _floor = 0;
+    _latest_timestamp = 0;
+    if (!_values.init(size, V()))
+      return false;
+    if (!_deltas.init(size, SENSOR_HISTORY_ESCAPE))
+      return false;
+    return _anchors.init(((_values.size() / (SENSOR_HISTORY_GROUP / 2)) + 2), empty);
+  }
+
+  bool allocated(void) { return (_values.allocated() && _deltas.allocated() && _anchors.allocated()); }
+  int size(void) { return _values.size(); }
+  // stored samples (up to size)
+  int count(void)
+  {
+    if ((uint32)_values.count() > (_pushed - _floor))
+      return (_pushed - _floor);
+    return _values.count();
+  }
+  uint32 pushed(void) { return _pushed; } // samples pushed since init
+  // bytes per sample (anchors excluded)
+  int record_size(void) { return (sizeof(V) + sizeof(uint8)); }
+
+  void push(const V &value, uint32 timestamp)
+  {
+    uint8 delta = SENSOR_HISTORY_ESCAPE;
+    if (!allocated())
+      return;
+    if (_pushed > 0)
+    {
+      uint32 elapsed = timestamp - _latest_timestamp;
+      if ((elapsed >= _base) && ((elapsed - _base) < SENSOR_HISTORY_ESCAPE))
+        delta = elapsed - _base;
+      else if ((_anchors.count() == 0) || (_anchors.get(0)->sample != (_pushed - 1)))
+        add_anchor(_pushed - 1, _latest_timestamp);
+    }
+    *(_values.next()) = value;
+    _values.push();
+    *(_deltas.next()) = delta;
+    _deltas.push();
+    if ((_pushed % SENSOR_HISTORY_GROUP) == (SENSOR_HISTORY_GROUP - 1))
+      add_anchor(_pushed, timestamp);
+    _latest_timestamp = timestamp;
+    _pushed++;
+  }
+
+  // idx = 0 => latest sample
+  // idx = 1 => previous sample
+  // ...
+  // return NULL (and timestamp 0) when idx is not a stored sample
+  V *get(int idx, uint32 *timestamp)
+  {
+    uint32 sample;
+    uint32 ref;
+    if (!allocated() || (idx < 0) || (idx >= count()))
+    {
+      *timestamp = 0;
+      return NULL;
+    }
+    sample = _pushed - 1 - idx;
+    find_anchor(sample, &ref, timestamp);
+    // no escape between the anchor and the sample (the escape would have left a closer anchor)
+    for (; ref > sample; ref--)
+      *timestamp -= _base + *(_deltas.get(_pushed - 1 - ref));
+    return _values.get(idx);
+  }
+
+  // walking the history backwards
+  // timestamp must be the timestamp of sample idx - 1 (as returned by get or older)
+  V *older(int idx, uint32 *timestamp)
+  {
+    uint8 delta;
+    if (!allocated() || (idx < 1) || (idx >= count()))
+      return NULL;
+    delta = *(_deltas.get(idx - 1));
+    if (delta == SENSOR_HISTORY_ESCAPE)
+      return get(idx, timestamp);
+    *timestamp -= _base + delta;
+    return _values.get(idx);
+  }
+
+private:
+  SensorRing<V> _values;
+  SensorRing<uint8> _deltas;
+  SensorRing<struct sensor_history_anchor> _anchors;
+  uint32 _base;   // seconds added to every delta
+  uint32 _pushed; // samples pushed since init
+  uint32 _floor;  // oldest sample still reachable from an anchor
+  uint32 _latest_timestamp;
+
+  void add_anchor(uint32 sample, uint32 timestamp)
+  {
+    struct sensor_history_anchor *anchor = _anchors.next();
+    if (_anchors.count() == _anchors.size())
+      _floor = anchor->sample + 1;
+    anchor->sample = sample;
+    anchor->timestamp = timestamp;
+    _anchors.push();
+  }
+
+  // the oldest anchor at or after sample (or the latest sample)
+  void find_anchor(uint32 sample, uint32 *ref, uint32 *timestamp)
+  {
+    int lo = 0;
+    int hi = _anchors.count() - 1;
+    if ((hi < 0) || (_anchors.get(0)->sample < sample))
+    {
+      *ref = _pushed - 1;
+      *timestamp = _latest_timestamp;
+      return;
+    }
+    // anchors get older (lower sample) with the ring idx
+    while (lo < hi)
+    {
+      int mid = (lo + hi + 1) / 2;
+      if (_anchors.get(mid)->sample >= sample)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+    *ref = _anchors.get(lo)->sample;
+    *timestamp = _anchors.get(lo)->timestamp;
+  }
+};
+
+#endif
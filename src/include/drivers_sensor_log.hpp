@@ -0,0 +1,102 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_LOG_HPP__
+#define __SENSOR_LOG_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+}
+
+#include "drivers_sensor.hpp"
+
+//
+// sensor log on SPIFFS
+//
+// samples of an Esp8266_Sensor are appended to the log as fixed size
+// binary records, record idx is at offset idx * sizeof(struct sensor_log_record)
+// - new samples are buffered in RAM (no flash access from the driver
+//   completion path) and written with a single n_append from a SW timer
+//   when the buffer is full (LOG_PAGE_SIZE bytes, 32 records) or
+//   SENSOR_LOG_MAX_AGE_MS after the first buffered record, whichever first
+// - the log rotates between files <name>.0 and <name>.1:
+//   when the current file reaches file_size the older one is cleared and
+//   becomes the current one (the log keeps between file_size and
+//   2 * file_size bytes of records)
+// - buffered records (up to SENSOR_LOG_MAX_AGE_MS of samples) are lost on
+//   reboot: call flush before a planned restart (e.g. OTA) if they matter
+//
+
+#define SENSOR_LOG_FILES 2
+#define SENSOR_LOG_NAME_LEN 29 // SPIFFS names are up to 31 chars, plus ".0"
+#define SENSOR_LOG_FLUSH_DELAY_MS 10
+#define SENSOR_LOG_MAX_AGE_MS 60000
+
+#define SENSOR_LOG_INVALID 0x01
+
+struct sensor_log_record
+{
+  uint32 timestamp;
+  sint16 value; // sensor scale units
+  uint8 type;   // sensors_type_t
+  uint8 flags;  // SENSOR_LOG_INVALID
+};
+
+struct sensor_log_stats
+{
+  uint32 appended;     // samples received
+  uint32 dropped;      // samples lost (buffer full or write errors)
+  uint32 flushes;      // n_append calls
+  uint32 write_errors;
+  uint32 rotations;
+};
+
+class SensorLog
+{
+public:
+  // the files left by the previous boot are checked here (SPIFFS must be mounted)
+  // name      => log file names prefix (up to SENSOR_LOG_NAME_LEN chars)
+  // scale     => values are stored as multiples of scale (e.g. 0.1 Celsius)
+  // file_size => rotating files size in bytes
+  SensorLog(char *name, float scale, int file_size);
+  ~SensorLog(); // flushing the buffered records
+
+  // logging the sensor samples
+  // (sets the sensor sample listener)
+  void attach(Esp8266_Sensor *sensor);
+  void detach(void);
+
+  void append(sensors_event_t *event); // O(1), no flash access
+  void flush(void);                    // writes the buffered records now
+
+  int count(void); // stored records, buffered ones included
+  // idx = 0 => oldest record
+  // return the number of records read
+  int read(int idx, struct sensor_log_record *records, int count);
+  void fill_event(struct sensor_log_record *record, sensors_event_t *event);
+  void get_stats(struct sensor_log_stats *stats);
+
+  // this is private but into public section
+  // for easy access from timer callback functions
+  char _name[SENSOR_LOG_NAME_LEN + 1];
+  float _scale;
+  int _file_records;                    // records per file
+  int _current;                         // file being appended
+  int _records[SENSOR_LOG_FILES];       // records into each file
+  Esp8266_Sensor *_sensor;
+  int _sensor_id;
+  struct sensor_log_record *_buffer;
+  int _buffered;
+  int _buffer_len;
+  os_timer_t _flush_timer;
+  struct sensor_log_stats _stats;
+};
+
+#endif
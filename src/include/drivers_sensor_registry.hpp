@@ -0,0 +1,79 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_REGISTRY_HPP__
+#define __SENSOR_REGISTRY_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+#include "drivers_sensor.hpp"
+
+//
+// sensor registry
+//
+// the drivers register their Esp8266_Sensor instances when created
+// and unregister them when destroyed, so that the application
+// can list the sensors or find them by sensor_id
+//
+
+#define SENSOR_REGISTRY_LEN 16
+
+bool sensor_register(Esp8266_Sensor *sensor); // false when the registry is full
+void sensor_unregister(Esp8266_Sensor *sensor);
+int get_sensors_count(void);
+Esp8266_Sensor *get_sensor(int idx);       // idx = 0 .. get_sensors_count() - 1
+Esp8266_Sensor *get_sensor_by_id(int id);  // NULL when not found
+
+//
+// sensor polling scheduler
+//
+// a single SW timer drives the polling of all the sensors:
+// polls are kept into a due time sorted queue and the timer is armed
+// for the nearest one
+// - a new poll starts one period from now, moved ahead by SENSOR_POLL_SLOT_MS
+//   steps while other polls are due too close (sensors created together
+//   don't poll in phase)
+// - polls are dispatched at least SENSOR_POLL_SLOT_MS apart, polls due
+//   in the same slot are shifted to the following slots
+//
+// the poll functions are called from the timer callback
+// a poll function can stop/start its own poll or other polls
+//
+
+#define SENSOR_POLL_SLOT_MS 20
+
+struct sensor_poll
+{
+    // do not initialize these are private members
+    struct sensor_poll *next;
+    void (*func)(void *);
+    void *param;
+    uint32 period; // ms
+    uint32 due;    // scheduler ms
+    bool active;
+};
+
+struct sensor_sched_stats
+{
+    uint32 active;       // started polls
+    uint32 dispatched;   // poll function calls
+    uint32 shifted;      // polls moved to a following slot
+    uint32 max_delay_ms; // longest delay of a poll from its due time
+};
+
+// setfn initializes the poll too: call it before any other function
+// (and never on a started poll)
+void sensor_poll_setfn(struct sensor_poll *poll, void (*func)(void *), void *param);
+void sensor_poll_start(struct sensor_poll *poll, uint32 period_ms); // first poll about period_ms from now
+void sensor_poll_stop(struct sensor_poll *poll);
+void get_sensor_sched_stats(struct sensor_sched_stats *stats);
+
+#endif
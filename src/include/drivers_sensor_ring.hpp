@@ -0,0 +1,114 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_RING_HPP__
+#define __SENSOR_RING_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+//
+// sensor samples history
+//
+// a ring of records (one record per sample: value, timestamp, invalid flag, ...)
+// allocated with a single heap allocation
+// records are accessed by age: idx = 0 => latest, idx = 1 => previous, ...
+// in constant time
+//
+// writing a sample:
+//   T *sample = ring.next(); // the oldest record, about to be overwritten
+//   ... fill the sample ...
+//   ring.push();             // now sample is the latest one
+// the latest record does not change until push, so readers are safe
+//
+template <typename T>
+class SensorRing
+{
+public:
+  SensorRing() : _records(NULL), _size(0), _latest(0), _count(0) {}
+  ~SensorRing()
+  {
+    if (_records)
+      delete[] _records;
+  }
+
+  // allocating heap memory, every record is initialized to empty
+  // return false when heap memory is exhausted
+  bool init(int size, const T &empty)
+  {
+    int idx;
+    if (_records)
+      delete[] _records;
+    _size = 0;
+    _latest = 0;
+    _count = 0;
+    if (size < 1)
+      size = 1;
+    _records = new T[size];
+    if (_records == NULL)
+      return false;
+    _size = size;
+    for (idx = 0; idx < _size; idx++)
+      _records[idx] = empty;
+    return true;
+  }
+
+  bool allocated(void) { return (_records != NULL); }
+  int size(void) { return _size; }
+  int count(void) { return _count; } // pushed records (up to size)
+
+  T *next(void)
+  {
+    if (_records == NULL)
+      return NULL;
+    if (_latest == (_size - 1))
+      return &_records[0];
+    return &_records[_latest + 1];
+  }
+
+  void push(void)
+  {
+    if (_records == NULL)
+      return;
+    if (_latest == (_size - 1))
+      _latest = 0;
+    else
+      _latest++;
+    if (_count < _size)
+      _count++;
+  }
+
+  // idx = 0 => latest record
+  // idx = 1 => previous record
+  // ...
+  // (idx wraps around the ring size)
+  T *get(int idx)
+  {
+    int pos;
+    if (_records == NULL)
+      return NULL;
+    if (idx < 0)
+      idx = 0;
+    if (idx >= _size)
+      idx = idx % _size;
+    pos = _latest - idx;
+    if (pos < 0)
+      pos += _size;
+    return &_records[pos];
+  }
+
+private:
+  T *_records;
+  int _size;
+  int _latest; // position of the latest record
+  int _count;
+};
+
+#endif
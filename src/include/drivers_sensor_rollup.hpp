@@ -0,0 +1,257 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_ROLLUP_HPP__
+#define __SENSOR_ROLLUP_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+#include "drivers_sensor_ring.hpp"
+
+//
+// multi resolution sensor history
+//
+// next to the raw samples history the sensor keeps a ring of minute buckets
+// and a ring of hour buckets, each one with min, max and avg of its samples
+// - every tier accumulates the samples of its open bucket in O(1)
+//   (same result as rolling the minute buckets into the hour ones)
+// - a bucket is stored when a sample of a following bucket arrives,
+//   buckets without samples (sensor not polled, failures) are stored empty
+// - values are sint16 multiples of the sensor scale (e.g. 0.1 Celsius),
+//   a bucket takes 8 bytes: 48 hours of trend fit in 384 bytes
+// - bucket timestamps are not stored, buckets are contiguous in time
+//
+// queries read the buckets only, raw samples are never re-scanned
+//
+
+#define SENSOR_ROLLUP_MINUTE_S 60
+#define SENSOR_ROLLUP_HOUR_S 3600
+
+typedef enum
+{
+  SENSOR_ROLLUP_MINUTES = 0,
+  SENSOR_ROLLUP_HOURS,
+  SENSOR_ROLLUP_TIERS
+} sensor_rollup_tier;
+
+struct sensor_rollup_record
+{
+  sint16 min; // sensor scale units
+  sint16 max;
+  sint16 avg;
+  uint16 count; // 0 => no samples (saturated at 65535)
+};
+
+struct sensor_rollup_bucket
+{
+  uint32 timestamp; // bucket start
+  uint32 count;     // 0 => no samples, min/max/avg are meaningless
+  float min;
+  float max;
+  float avg;
+};
+
+class SensorRollup
+{
+public:
+  // nothing allocated, nothing stored until init
+  SensorRollup() : _scale(1.0f)
+  {
+    int idx;
+    for (idx = 0; idx < SENSOR_ROLLUP_TIERS; idx++)
+    {
+      _tiers[idx].length = 0;
+      _tiers[idx].latest_start = 0;
+      _tiers[idx].open = false;
+      _tiers[idx].start = 0;
+      _tiers[idx].count = 0;
+      _tiers[idx].min = 0;
+      _tiers[idx].max = 0;
+      _tiers[idx].sum = 0;
+    }
+  }
+
+  // allocating heap memory
+  // return false when heap memory is exhausted
+  bool init(float scale, int minutes, int hours)
+  {
+    struct sensor_rollup_record empty = {0, 0, 0, 0};
+    int idx;
+    _scale = scale;
+    for (idx = 0; idx < SENSOR_ROLLUP_TIERS; idx++)
+    {
+      _tiers[idx].open = false;
+      _tiers[idx].latest_start = 0;
+    }
+    _tiers[SENSOR_ROLLUP_MINUTES].length = SENSOR_ROLLUP_MINUTE_S;
+    _tiers[SENSOR_ROLLUP_HOURS].length = SENSOR_ROLLUP_HOUR_S;
+    if (!_tiers[SENSOR_ROLLUP_MINUTES].records.init(minutes, empty))
+      return false;
+    if (!_tiers[SENSOR_ROLLUP_HOURS].records.init(hours, empty))
+      return false;
+    return true;
+  }
+
+  bool allocated(void)
+  {
+    return (_tiers[SENSOR_ROLLUP_MINUTES].records.allocated() && _tiers[SENSOR_ROLLUP_HOURS].records.allocated());
+  }
+
+  int size(sensor_rollup_tier tier) { return _tiers[tier].records.size() + 1; } // open bucket included
+
+  int count(sensor_rollup_tier tier)
+  {
+    struct tier *ptr = &_tiers[tier];
+    return ptr->records.count() + (ptr->open ? 1 : 0);
+  }
+
+  void update(float value, uint32 timestamp)
+  {
+    int idx;
+    if (!allocated())
+      return;
+    for (idx = 0; idx < SENSOR_ROLLUP_TIERS; idx++)
+      tier_update(&_tiers[idx], value, timestamp);
+  }
+
+  // idx = 0 => open bucket
+  // idx = 1 => previous bucket
+  // ...
+  // return false when idx is not a stored bucket
+  bool get(sensor_rollup_tier tier, int idx, struct sensor_rollup_bucket *bucket)
+  {
+    struct tier *ptr = &_tiers[tier];
+    struct sensor_rollup_record *record;
+    if (!allocated() || (idx < 0) || (idx >= count(tier)))
+      return false;
+    if (ptr->open)
+    {
+      if (idx == 0)
+      {
+        bucket->timestamp = ptr->start;
+        bucket->count = ptr->count;
+        bucket->min = ptr->min;
+        bucket->max = ptr->max;
+        bucket->avg = ptr->sum / ptr->count;
+        return true;
+      }
+      idx--;
+    }
+    record = ptr->records.get(idx);
+    bucket->timestamp = ptr->latest_start - (idx * ptr->length);
+    bucket->count = record->count;
+    bucket->min = record->min * _scale;
+    bucket->max = record->max * _scale;
+    bucket->avg = record->avg * _scale;
+    return true;
+  }
+
+  // fills buckets with count buckets starting from offset
+  // return the number of buckets filled
+  int get_buckets(sensor_rollup_tier tier, struct sensor_rollup_bucket *buckets, int count, int offset)
+  {
+    int idx;
+    if (offset < 0)
+      offset = 0;
+    for (idx = 0; idx < count; idx++)
+      if (!get(tier, (offset + idx), &buckets[idx]))
+        break;
+    return idx;
+  }
+
+private:
+  struct tier
+  {
+    SensorRing<struct sensor_rollup_record> records;
+    uint32 length;       // bucket length (seconds)
+    uint32 latest_start; // start of the latest stored bucket
+    // open bucket
+    bool open;
+    uint32 start;
+    uint32 count;
+    float min;
+    float max;
+    float sum;
+  };
+
+  struct tier _tiers[SENSOR_ROLLUP_TIERS];
+  float _scale;
+
+  sint16 to_units(float value)
+  {
+    float units = value / _scale;
+    if (units > 32767)
+      return 32767;
+    if (units < -32768)
+      return -32768;
+    return (sint16)((units < 0) ? (units - 0.5f) : (units + 0.5f));
+  }
+
+  void tier_push(struct tier *ptr, struct sensor_rollup_record *value, uint32 start)
+  {
+    struct sensor_rollup_record *record = ptr->records.next();
+    *record = *value;
+    ptr->records.push();
+    ptr->latest_start = start;
+  }
+
+  void tier_close(struct tier *ptr, uint32 next_start)
+  {
+    struct sensor_rollup_record record;
+    uint32 gaps;
+    uint32 start;
+    record.min = to_units(ptr->min);
+    record.max = to_units(ptr->max);
+    record.avg = to_units(ptr->sum / ptr->count);
+    record.count = (ptr->count > 0xFFFF) ? 0xFFFF : ptr->count;
+    tier_push(ptr, &record, ptr->start);
+    ptr->open = false;
+    // time going backwards (e.g. timedate updated) => no empty buckets
+    // (older buckets timestamps will be shifted)
+    if (((sint32)(next_start - ptr->start)) <= 0)
+      return;
+    gaps = ((next_start - ptr->start) / ptr->length) - 1;
+    if (gaps > (uint32)ptr->records.size())
+      gaps = ptr->records.size();
+    record.min = 0;
+    record.max = 0;
+    record.avg = 0;
+    record.count = 0;
+    start = next_start - (gaps * ptr->length);
+    for (; gaps > 0; gaps--, start += ptr->length)
+      tier_push(ptr, &record, start);
+  }
+
+  void tier_update(struct tier *ptr, float value, uint32 timestamp)
+  {
+    uint32 start = timestamp - (timestamp % ptr->length);
+    if (ptr->open && (start != ptr->start))
+      tier_close(ptr, start);
+    if (!ptr->open)
+    {
+      ptr->open = true;
+      ptr->start = start;
+      ptr->count = 1;
+      ptr->min = value;
+      ptr->max = value;
+      ptr->sum = value;
+      return;
+    }
+    ptr->count++;
+    if (value < ptr->min)
+      ptr->min = value;
+    if (value > ptr->max)
+      ptr->max = value;
+    ptr->sum += value;
+  }
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_STATS_HPP__
+#define __SENSOR_STATS_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+}
+
+//
+// streaming sensor statistics
+//
+// updated by the drivers in O(1) for every new sample
+// - min, max, mean and standard deviation since the last reset (Welford)
+// - exponentially weighted moving average and standard deviation
+//   alpha = 2 / (window + 1), the latest window samples weight about 86%
+//
+// no libm: the standard deviation uses its own square root
+//
+
+#define SENSOR_STATS_WINDOW 19 // default EWMA window (alpha = 0.1)
+
+struct sensor_stats
+{
+  uint32 count;         // valid samples since reset
+  uint32 invalid;       // invalid samples since reset
+  uint32 since;         // timestamp of the first sample since reset
+  float last;
+  float min;
+  uint32 min_timestamp;
+  float max;
+  uint32 max_timestamp;
+  float mean;
+  float stddev;         // sample standard deviation
+  int window;           // EWMA window (samples)
+  float ewma;
+  float ewm_stddev;
+};
+
+class SensorStats
+{
+public:
+  SensorStats() : _window(SENSOR_STATS_WINDOW), _alpha(2.0f / (SENSOR_STATS_WINDOW + 1)) { reset(); }
+
+  void reset(void)
+  {
+    _count = 0;
+    _invalid = 0;
+    _since = 0;
+    _last = 0;
+    _min = 0;
+    _min_timestamp = 0;
+    _max = 0;
+    _max_timestamp = 0;
+    _mean = 0;
+    _m2 = 0;
+    _ewma = 0;
+    _ewm_var = 0;
+  }
+
+  // the EWMA restarts from the next sample
+  void set_window(int samples)
+  {
+    if (samples < 1)
+      samples = 1;
+    _window = samples;
+    _alpha = 2.0f / (samples + 1);
+    _ewma = _last;
+    _ewm_var = 0;
+  }
+
+  void update(float value, uint32 timestamp)
+  {
+    float delta;
+    float incr;
+    if ((_count + _invalid) == 0)
+      _since = timestamp;
+    _last = value;
+    if (_count == 0)
+    {
+      _count = 1;
+      _min = value;
+      _min_timestamp = timestamp;
+      _max = value;
+      _max_timestamp = timestamp;
+      _mean = value;
+      _m2 = 0;
+      _ewma = value;
+      _ewm_var = 0;
+      return;
+    }
+    _count++;
+    if (value < _min)
+    {
+      _min = value;
+      _min_timestamp = timestamp;
+    }
+    if (value > _max)
+    {
+      _max = value;
+      _max_timestamp = timestamp;
+    }
+    // Welford
+    delta = value - _mean;
+    _mean += delta / _count;
+    _m2 += delta * (value - _mean);
+    // exponentially weighted
+    delta = value - _ewma;
+    incr = _alpha * delta;
+    _ewma += incr;
+    _ewm_var = (1 - _alpha) * (_ewm_var + delta * incr);
+  }
+
+  void update_invalid(uint32 timestamp)
+  {
+    if ((_count + _invalid) == 0)
+      _since = timestamp;
+    _invalid++;
+  }
+
+  void get(struct sensor_stats *stats)
+  {
+    stats->count = _count;
+    stats->invalid = _invalid;
+    stats->since = _since;
+    stats->last = _last;
+    stats->min = _min;
+    stats->min_timestamp = _min_timestamp;
+    stats->max = _max;
+    stats->max_timestamp = _max_timestamp;
+    stats->mean = _mean;
+    stats->stddev = (_count > 1) ? square_root(_m2 / (_count - 1)) : 0;
+    stats->window = _window;
+    stats->ewma = _ewma;
+    stats->ewm_stddev = square_root(_ewm_var);
+  }
+
+private:
+  uint32 _count;
+  uint32 _invalid;
+  uint32 _since;
+  float _last;
+  float _min;
+  uint32 _min_timestamp;
+  float _max;
+  uint32 _max_timestamp;
+  float _mean;
+  float _m2; // sum of squared differences from the mean
+  float _ewma;
+  float _ewm_var;
+  int _window;
+  float _alpha;
+
+  // exponent halving guess and three Newton steps
+  static float square_root(float value)
+  {
+    union {
+      float f;
+      uint32 i;
+    } guess;
+    int idx;
+    if (value <= 0)
+      return 0;
+    guess.f = value;
+    guess.i = 0x1FBD1DF5 + (guess.i >> 1);
+    for (idx = 0; idx < 3; idx++)
+      guess.f = 0.5f * (guess.f + value / guess.f);
+    return guess.f;
+  }
+};
+
+#endif
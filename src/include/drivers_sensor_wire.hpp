@@ -0,0 +1,131 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __SENSOR_WIRE_HPP__
+#define __SENSOR_WIRE_HPP__
+
+extern "C"
+{
+#include "c_types.h"
+#include "osapi.h"
+}
+
+#include "drivers_sensor.hpp"
+
+//
+// compact binary encoding of sensor_t and sensors_event_t
+// fixed layout, little endian, floats are IEEE 754 single precision
+//
+// header (SENSOR_WIRE_HEADER_LEN bytes)
+//    0  char[4]  magic "SEVT"
+//    4  uint8    version (SENSOR_WIRE_VERSION)
+//    5  uint8    type (sensors_type_t)
+//    6  uint16   event length (SENSOR_WIRE_EVENT_LEN)
+//    8  int32    sensor_id
+//   12  char[12] name (zero padded)
+//   24  float    max_value
+//   28  float    min_value
+//   32  float    resolution
+//   36  uint32   min_delay (us)
+//   40  uint32   events count
+// event (SENSOR_WIRE_EVENT_LEN bytes)
+//    0  uint32   timestamp
+//    4  float    value (quiet NaN => invalid event)
+//
+// 8 bytes per event instead of about 54 as JSON, and no float formatting
+//
+
+#define SENSOR_WIRE_VERSION 1
+#define SENSOR_WIRE_HEADER_LEN 44
+#define SENSOR_WIRE_EVENT_LEN 8
+#define SENSOR_WIRE_INVALID 0x7FC00000
+
+static inline void sensor_wire_put16(char *buf, uint16 value)
+{
+  buf[0] = (char)(value & 0xFF);
+  buf[1] = (char)((value >> 8) & 0xFF);
+}
+
+static inline void sensor_wire_put32(char *buf, uint32 value)
+{
+  buf[0] = (char)(value & 0xFF);
+  buf[1] = (char)((value >> 8) & 0xFF);
+  buf[2] = (char)((value >> 16) & 0xFF);
+  buf[3] = (char)((value >> 24) & 0xFF);
+}
+
+static inline uint32 sensor_wire_float(float value)
+{
+  uint32 bits;
+  os_memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// buf must be SENSOR_WIRE_HEADER_LEN bytes
+static inline void sensor_wire_header(char *buf, sensor_t *sensor, uint32 count)
+{
+  os_memset(buf, 0, SENSOR_WIRE_HEADER_LEN);
+  os_memcpy(buf, "SEVT", 4);
+  buf[4] = SENSOR_WIRE_VERSION;
+  buf[5] = (char)sensor->type;
+  sensor_wire_put16((buf + 6), SENSOR_WIRE_EVENT_LEN);
+  sensor_wire_put32((buf + 8), (uint32)sensor->sensor_id);
+  os_strncpy((buf + 12), sensor->name, 12);
+  sensor_wire_put32((buf + 24), sensor_wire_float(sensor->max_value));
+  sensor_wire_put32((buf + 28), sensor_wire_float(sensor->min_value));
+  sensor_wire_put32((buf + 32), sensor_wire_float(sensor->resolution));
+  sensor_wire_put32((buf + 36), sensor->min_delay);
+  sensor_wire_put32((buf + 40), count);
+}
+
+// buf must be SENSOR_WIRE_EVENT_LEN bytes
+static inline void sensor_wire_event(char *buf, sensors_event_t *event)
+{
+  sensor_wire_put32(buf, event->timestamp);
+  if (event->invalid)
+    sensor_wire_put32((buf + 4), SENSOR_WIRE_INVALID);
+  else
+    sensor_wire_put32((buf + 4), sensor_wire_float(event->temperature));
+}
+
+// header plus count events
+static inline int sensor_wire_content_len(int count)
+{
+  return SENSOR_WIRE_HEADER_LEN + (count * SENSOR_WIRE_EVENT_LEN);
+}
+
+// count events from position first (latest first) of an export that started
+// when the sensor getSequence() was sequence
+// events stored after the export start moved the exported ones ahead
+// (counted by sequence, timestamps of close samples can be the same)
+// events overwritten meanwhile (or sensor NULL) are returned as invalid,
+// so every position is filled and the bytes sent match the content length
+static inline void sensor_wire_export_events(Esp8266_Sensor *sensor,
+                                             uint32 sequence,
+                                             sensors_event_t *events,
+                                             int count,
+                                             int first)
+{
+  int shift = 0;
+  int read = 0;
+  int idx;
+  if (sensor)
+  {
+    shift = (int)(sensor->getSequence() - sequence);
+    if (shift < 0)
+      shift = 0;
+    read = sensor->getEvents(events, count, (shift + first));
+  }
+  for (idx = read; idx < count; idx++)
+  {
+    os_memset(&events[idx], 0, sizeof(sensors_event_t));
+    events[idx].invalid = true;
+  }
+}
+
+#endif
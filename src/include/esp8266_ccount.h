@@ -0,0 +1,28 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __ESP8266_CCOUNT_H__
+#define __ESP8266_CCOUNT_H__
+
+#include "c_types.h"
+
+//
+// Xtensa CCOUNT register: CPU cycles counter
+// increments at the CPU frequency (system_get_cpu_freq() MHz), wraps around every
+// 53 s at 80 MHz (26 s at 160 MHz)
+//
+
+static inline uint32 get_ccount(void)
+{
+    uint32 ccount;
+    __asm__ __volatile__("rsr %0, ccount"
+                         : "=a"(ccount));
+    return ccount;
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __ESP8266_HSPI_H__
+#define __ESP8266_HSPI_H__
+
+#include "c_types.h"
+#include "eagle_soc.h"
+#include "esp8266_io.h"
+
+//
+// HSPI master, read only transfers (MISO), SPI mode 0, MSB first, 2 MHz
+//
+// pins: SCK  => D5 (GPIO14)
+//       MISO => D6 (GPIO12)
+//       CS   => any free GPIO driven by the caller (the HW CS is disabled
+//               so that many chips can share SCK and MISO)
+// D7 (GPIO13, MOSI) is left as a GPIO
+//
+
+#define HSPI_BASE 0x60000100
+#define HSPI_CMD (HSPI_BASE + 0x00)
+#define HSPI_CTRL (HSPI_BASE + 0x08)
+#define HSPI_CLOCK (HSPI_BASE + 0x18)
+#define HSPI_USER (HSPI_BASE + 0x1C)
+#define HSPI_USER1 (HSPI_BASE + 0x20)
+#define HSPI_PIN (HSPI_BASE + 0x2C)
+#define HSPI_W0 (HSPI_BASE + 0x40)
+
+#define HSPI_USR BIT18                   // HSPI_CMD: start a transfer, cleared when done
+#define HSPI_BIT_ORDER (BIT26 | BIT25)   // HSPI_CTRL: set => LSB first
+#define HSPI_USR_MISO BIT28              // HSPI_USER: read phase
+#define HSPI_MISO_BITLEN_S 8             // HSPI_USER1: read bits - 1
+#define HSPI_CS_DIS (BIT2 | BIT1 | BIT0) // HSPI_PIN: HW CS disabled
+#define HSPI_FUNC 2                      // MTMS_U => HSPICLK, MTDI_U => HSPIQ (MISO)
+
+// 80 MHz / (3 + 1) / (9 + 1) = 2 MHz
+#define HSPI_CLOCK_2MHZ ((3 << 18) | (9 << 12) | (4 << 6) | 9)
+
+static inline void hspi_master_init(void)
+{
+    // HSPI clock from the divider, not the system clock
+    CLEAR_PERI_REG_MASK(PERIPHS_IO_MUX, BIT9);
+    PIN_FUNC_SELECT(ESPBOT_D5_MUX, HSPI_FUNC);
+    PIN_FUNC_SELECT(ESPBOT_D6_MUX, HSPI_FUNC);
+    WRITE_PERI_REG(HSPI_CLOCK, HSPI_CLOCK_2MHZ);
+    CLEAR_PERI_REG_MASK(HSPI_CTRL, HSPI_BIT_ORDER);
+    WRITE_PERI_REG(HSPI_USER, HSPI_USR_MISO);
+    WRITE_PERI_REG(HSPI_PIN, HSPI_CS_DIS);
+}
+
+// blocking 16 bits read (8 us)
+static inline uint16 hspi_read16(void)
+{
+    uint32 w0;
+    WRITE_PERI_REG(HSPI_USER1, (15 << HSPI_MISO_BITLEN_S));
+    SET_PERI_REG_MASK(HSPI_CMD, HSPI_USR);
+    while (READ_PERI_REG(HSPI_CMD) & HSPI_USR)
+        ;
+    // the first received byte is the lowest byte of W0
+    w0 = READ_PERI_REG(HSPI_W0);
+    return (uint16)(((w0 & 0xFF) << 8) | ((w0 >> 8) & 0xFF));
+}
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <quackmore-ff@yahoo.com> wrote this file.  As long as you retain this notice
+ * you can do whatever you want with this stuff. If we meet some day, and you 
+ * think this stuff is worth it, you can buy me a beer in return. Quackmore
+ * ----------------------------------------------------------------------------
+ */
+#ifndef __ESP8266_INTR_H__
+#define __ESP8266_INTR_H__
+
+#include "c_types.h"
+
+//
+// short critical sections shared by isr and task code
+// intr_lock raises the interrupt level masking GPIO and FRC1 interrupts and returns
+// the previous processor status, intr_unlock restores it
+// differently from ets_intr_lock/ets_intr_unlock they nest and can be used inside an isr
+//
+
+static inline uint32 intr_lock(void)
+{
+    uint32 ps;
+    __asm__ __volatile__("rsil %0, 3"
+                         : "=a"(ps)
+                         :
+                         : "memory");
+    return ps;
+}
+
+static inline void intr_unlock(uint32 ps)
+{
+    __asm__ __volatile__("wsr %0, ps; rsync"
+                         :
+                         : "a"(ps)
+                         : "memory");
+}
+
+#endif